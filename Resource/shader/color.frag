@@ -1,8 +1,7 @@
 #version 120
 #extension GL_EXT_gpu_shader4 : enable
+#{tileExtensions}
 varying vec2 textureCoordOut;
-uniform sampler2D texture;
-uniform float fade;
 uniform int grassBlockId;
 uniform int foliageBlockId;
 uniform int netherrackBlockId;
@@ -14,15 +13,9 @@ uniform bool enableBiome;
 uniform float width;
 uniform float height;
 uniform int dimension;
+uniform float tileSize; // 512 at full detail, smaller for reduced textures
 
-uniform sampler2D north;
-uniform sampler2D northEast;
-uniform sampler2D east;
-uniform sampler2D southEast;
-uniform sampler2D south;
-uniform sampler2D southWest;
-uniform sampler2D west;
-uniform sampler2D northWest;
+#{tileSampler}
 
 uniform sampler2D palette;
 uniform int paletteSize;
@@ -37,14 +30,15 @@ struct BlockInfo {
     int biomeRadius;
 };
 
-float altitudeFromColor(vec4 color) {
-    int a = int(color.a * 255.0);
-    int r = int(color.r * 255.0);
+// color: bytes of the texel as returned by pixelAt, (r, g, b, a) in 0..255
+float altitudeFromColor(ivec4 color) {
+    int a = color.a;
+    int r = color.r;
     int h = (a << 1) + (0x1 & (r >> 7));
     return float(h) - 64.0;
 }
 
-BlockInfo pixelInfo(vec4 color) {
+BlockInfo pixelInfo(ivec4 color) {
     // [v4 pixel info]
     // h:                      9bit
     // block/waterDepth flag:  1bit => 1: block, 0: waterDepth
@@ -57,10 +51,9 @@ BlockInfo pixelInfo(vec4 color) {
      hhhhhhhhhfwwwwwwwwwwwwwwwwbbbrrr : v4
      */
 
-    int a = int(color.a * 255.0);
-    int r = int(color.r * 255.0);
-    int g = int(color.g * 255.0);
-    int b = int(color.b * 255.0);
+    int r = color.r;
+    int g = color.g;
+    int b = color.b;
 
     float h = altitudeFromColor(color);
 
@@ -187,38 +180,20 @@ vec4 colorFromBlockId(int blockId) {
 
 vec4 waterColor() {
     vec2 center = textureCoordOut;
+    if (hasShade()) {
+        vec2 t = floor(center * tileSize);
+        float b = float(biomeBlend);
+        if (t.x >= b && t.y >= b && t.x < tileSize - b && t.y < tileSize - b) {
+            return vec4(shadeAt(center).rgb, 1.0);
+        }
+    }
     vec4 sumColor = vec4(0.0, 0.0, 0.0, 0.0);
     int count = 0;
     for (int dx = -biomeBlend; dx <= biomeBlend; dx++) {
         for (int dz = -biomeBlend; dz <= biomeBlend; dz++) {
-            float x = center.x + float(dx) / 512.0;
-            float y = center.y + float(dz) / 512.0;
-            vec4 c;
-            if (x < 0.0) {
-                if (y < 0.0) {
-                    c = texture2D(northWest, vec2(x + 1.0, y + 1.0));
-                } else if (y < 1.0) {
-                    c = texture2D(west, vec2(x + 1.0, y));
-                } else {
-                    c = texture2D(southWest, vec2(x + 1.0, y - 1.0));
-                }
-            } else if (x < 1.0) {
-                if (y < 0.0) {
-                    c = texture2D(north, vec2(x, y + 1.0));
-                } else if (y < 1.0) {
-                    c = texture2D(texture, vec2(x, y));
-                } else {
-                    c = texture2D(south, vec2(x, y - 1.0));
-                }
-            } else {
-                if (y < 0.0) {
-                    c = texture2D(northEast, vec2(x - 1.0, y + 1.0));
-                } else if (y < 1.0) {
-                    c = texture2D(east, vec2(x - 1.0, y));
-                } else {
-                    c = texture2D(southEast, vec2(x - 1.0, y - 1.0));
-                }
-            }
+            float x = center.x + float(dx) / tileSize;
+            float y = center.y + float(dz) / tileSize;
+            ivec4 c = pixelAt(vec2(x, y));
             BlockInfo info = pixelInfo(c);
             sumColor += waterColorFromBiome(info.biomeId);
             count++;
@@ -227,10 +202,23 @@ vec4 waterColor() {
     return sumColor / float(count);
 }
 
+// 0: none, 1: neighbour is higher, 2: lower, 3: same. See RegionToTexture::Shade
+int neighbourState(float neighbourHeight, float height) {
+    if (neighbourHeight <= 0.0) {
+        return 0;
+    } else if (neighbourHeight > height) {
+        return 1;
+    } else if (neighbourHeight < height) {
+        return 2;
+    } else {
+        return 3;
+    }
+}
+
 void main() {
     float alpha = fade;
 
-    vec4 color = texture2D(texture, textureCoordOut);
+    ivec4 color = pixelAt(textureCoordOut);
     BlockInfo info = pixelInfo(color);
 
     float height = info.height;
@@ -288,50 +276,31 @@ void main() {
     }
 
     if (!isVoid && (waterDepth == 0.0 || (waterDepth > 0.0 && waterTranslucent))) {
-        if (lightingType == 2) {
-            float d = 1.0 / 512.0;
+        int northState;
+        int westState;
+        vec2 t = floor(textureCoordOut * tileSize);
+        if (hasShade() && t.x >= 1.0 && t.y >= 1.0) {
+            int s = int(shadeAt(textureCoordOut).a * 255.0 + 0.5);
+            northState = s / 4;
+            westState = s - northState * 4;
+        } else {
+            float d = 1.0 / tileSize;
             float tx = textureCoordOut.x;
             float ty = textureCoordOut.y;
-            vec4 northC;
-            if (ty - d < 0.0) {
-                northC = texture2D(north, vec2(tx, ty - d + 1.0));
-            } else {
-                northC = texture2D(texture, vec2(tx, ty - d));
-            }
-            float northH = altitudeFromColor(northC);
+            northState = neighbourState(altitudeFromColor(pixelAt(vec2(tx, ty - d))), height);
+            westState = neighbourState(altitudeFromColor(pixelAt(vec2(tx - d, ty))), height);
+        }
+        if (lightingType == 2) {
             float coeff = 220.0 / 255.0;
-            if (northH > 0.0) {
-                if (northH > height) coeff = 180.0 / 255.0;
-                if (northH < height) coeff = 1;
-            }
+            if (northState == 1) coeff = 180.0 / 255.0;
+            if (northState == 2) coeff = 1;
             c = vec4(c.rgb * coeff, c.a);
         } else {
             float heightScore = 0.0; // +: bright, -: dark
-            float d = 1.0 / 512.0;
-            float tx = textureCoordOut.x;
-            float ty = textureCoordOut.y;
-            vec4 northC;
-            if (ty - d < 0.0) {
-                northC = texture2D(north, vec2(tx, ty - d + 1.0));
-            } else {
-                northC = texture2D(texture, vec2(tx, ty - d));
-            }
-            vec4 westC;
-            if (tx - d < 0.0) {
-                westC = texture2D(west, vec2(tx - d + 1.0, ty));
-            } else {
-                westC = texture2D(texture, vec2(tx - d, ty));
-            }
-            float northH = altitudeFromColor(northC);
-            float westH = altitudeFromColor(westC);
-            if (northH > 0.0) {
-                if (northH > height) heightScore--;
-                if (northH < height) heightScore++;
-            }
-            if (westH > 0.0) {
-                if (westH > height) heightScore--;
-                if (westH < height) heightScore++;
-            }
+            if (northState == 1) heightScore--;
+            if (northState == 2) heightScore++;
+            if (westState == 1) heightScore--;
+            if (westState == 2) heightScore++;
 
             if (heightScore > 0.0) {
                 float coeff = 1.2;
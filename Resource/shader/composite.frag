@@ -0,0 +1,6 @@
+#version 120
+uniform sampler2D texture;
+varying vec2 textureCoordOut;
+void main() {
+    gl_FragColor = texture2D(texture, textureCoordOut);
+}
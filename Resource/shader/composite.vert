@@ -0,0 +1,7 @@
+attribute vec2 textureCoordIn;
+attribute vec4 position;
+varying vec2 textureCoordOut;
+void main() {
+    textureCoordOut = textureCoordIn;
+    gl_Position = vec4(position.x * 2.0 - 1.0, position.y * 2.0 - 1.0, 0.0, 1.0);
+}
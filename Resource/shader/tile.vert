@@ -3,6 +3,7 @@ attribute vec4 position;
 uniform float blocksPerPixel;
 uniform float Xr;
 uniform float Zr;
+uniform float tileExtent; // Blocks covered by the tile
 uniform float width;
 uniform float height;
 uniform float Cx;
@@ -13,8 +14,8 @@ void main() {
 
     float Xp = position.x;
     float Yp = position.y;
-    float Xm = Xr + Xp * 512.0;
-    float Zm = Zr + Yp * 512.0;
+    float Xm = Xr + Xp * tileExtent;
+    float Zm = Zr + Yp * tileExtent;
     float Xw = (Xm - Cx) / blocksPerPixel + width / 2.0;
     float Yw = (Zm - Cz) / blocksPerPixel + height / 2.0;
     float Xg = 2.0 * Xw / width - 1.0;
@@ -0,0 +1,37 @@
+#version 120
+attribute vec2 textureCoordIn;
+attribute vec4 position;
+attribute vec4 tileIn; // Xr, Zr, fade, shaded
+attribute vec4 layers0In;
+attribute vec4 layers1In;
+attribute float layers2In;
+uniform float blocksPerPixel;
+uniform float width;
+uniform float height;
+uniform float Cx;
+uniform float Cz;
+varying vec2 textureCoordOut;
+varying float fade;
+varying float shaded;
+varying vec4 layers0;
+varying vec4 layers1;
+varying float layers2;
+void main() {
+    textureCoordOut = textureCoordIn;
+    fade = tileIn.z;
+    shaded = tileIn.w;
+    layers0 = layers0In;
+    layers1 = layers1In;
+    layers2 = layers2In;
+
+    float Xp = position.x;
+    float Yp = position.y;
+    float Xm = tileIn.x + Xp * 512.0;
+    float Zm = tileIn.y + Yp * 512.0;
+    float Xw = (Xm - Cx) / blocksPerPixel + width / 2.0;
+    float Yw = (Zm - Cz) / blocksPerPixel + height / 2.0;
+    float Xg = 2.0 * Xw / width - 1.0;
+    float Yg = 1.0 - 2.0 * Yw / height;
+
+    gl_Position = vec4(Xg, Yg, position.z, position.w);
+}
@@ -0,0 +1,63 @@
+// Tiles as GL_RGBA8UI, so that the packed bit fields are read without float conversion
+uniform usampler2DArray tiles;
+// Precomputed by RegionToTexture::Shade, in the same layer as the tile
+uniform sampler2DArray shades;
+varying float fade;
+varying float shaded;
+
+// Layer of this tile and its neighbours, -1 when not resident.
+// layers0: center, north, northEast, east
+// layers1: southEast, south, southWest, west
+// layers2: northWest
+varying vec4 layers0;
+varying vec4 layers1;
+varying float layers2;
+
+float layerAt(int dx, int dz) {
+    if (dz < 0) {
+        if (dx < 0) {
+            return layers2;
+        } else if (dx == 0) {
+            return layers0.y;
+        } else {
+            return layers0.z;
+        }
+    } else if (dz == 0) {
+        if (dx < 0) {
+            return layers1.w;
+        } else if (dx == 0) {
+            return layers0.x;
+        } else {
+            return layers0.w;
+        }
+    } else {
+        if (dx < 0) {
+            return layers1.z;
+        } else if (dx == 0) {
+            return layers1.y;
+        } else {
+            return layers1.x;
+        }
+    }
+}
+
+bool hasShade() {
+    return shaded > 0.5;
+}
+
+vec4 shadeAt(vec2 p) {
+    return texture2DArray(shades, vec3(p.x, p.y, floor(layers0.x + 0.5)));
+}
+
+// Bytes of the texel at p, (r, g, b, a) in 0..255. p: texture coordinate relative to this tile, may point into the 8 neighbours.
+ivec4 pixelAt(vec2 p) {
+    int dx = p.x < 0.0 ? -1 : (p.x < 1.0 ? 0 : 1);
+    int dz = p.y < 0.0 ? -1 : (p.y < 1.0 ? 0 : 1);
+    float layer = floor(layerAt(dx, dz) + 0.5);
+    if (layer < 0.0) {
+        return ivec4(0, 0, 0, 0);
+    }
+    int size = int(tileSize);
+    ivec2 t = clamp(ivec2(floor((p - vec2(float(dx), float(dz))) * tileSize)), ivec2(0, 0), ivec2(size - 1, size - 1));
+    return ivec4(texelFetch2DArray(tiles, ivec3(t, int(layer)), 0));
+}
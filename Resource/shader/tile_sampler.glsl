@@ -0,0 +1,59 @@
+uniform sampler2D texture;
+uniform float fade;
+
+uniform sampler2D north;
+uniform sampler2D northEast;
+uniform sampler2D east;
+uniform sampler2D southEast;
+uniform sampler2D south;
+uniform sampler2D southWest;
+uniform sampler2D west;
+uniform sampler2D northWest;
+
+// Precomputed by RegionToTexture::Shade
+uniform sampler2D shade;
+uniform bool shaded;
+
+bool hasShade() {
+    return shaded;
+}
+
+vec4 shadeAt(vec2 p) {
+    return texture2D(shade, p);
+}
+
+// p: texture coordinate relative to this tile, may point into the 8 neighbours.
+vec4 texelAt(vec2 p) {
+    float x = p.x;
+    float y = p.y;
+    if (x < 0.0) {
+        if (y < 0.0) {
+            return texture2D(northWest, vec2(x + 1.0, y + 1.0));
+        } else if (y < 1.0) {
+            return texture2D(west, vec2(x + 1.0, y));
+        } else {
+            return texture2D(southWest, vec2(x + 1.0, y - 1.0));
+        }
+    } else if (x < 1.0) {
+        if (y < 0.0) {
+            return texture2D(north, vec2(x, y + 1.0));
+        } else if (y < 1.0) {
+            return texture2D(texture, vec2(x, y));
+        } else {
+            return texture2D(south, vec2(x, y - 1.0));
+        }
+    } else {
+        if (y < 0.0) {
+            return texture2D(northEast, vec2(x - 1.0, y + 1.0));
+        } else if (y < 1.0) {
+            return texture2D(east, vec2(x - 1.0, y));
+        } else {
+            return texture2D(southEast, vec2(x - 1.0, y - 1.0));
+        }
+    }
+}
+
+// Bytes of the texel at p, (r, g, b, a) in 0..255
+ivec4 pixelAt(vec2 p) {
+    return ivec4(texelAt(p) * 255.0 + 0.5);
+}
@@ -31,13 +31,20 @@
 #include "LookAt.hpp"
 #include "Dimension.hpp"
 #include "Region.hpp"
+#include "RegionGrid.hpp"
+#include "Fingerprint.hpp"
 #include "PNGWriter.hpp"
 #include "Pin.hpp"
 #include "WorldData.hpp"
+#include "TileTextureArray.hpp"
+#include "TextureUploader.hpp"
 #include "RegionTextureCache.hpp"
+#include "TextureResidency.hpp"
 #include "OverScroller.hpp"
 #include "TimerInstance.hpp"
+#include "Trace.hpp"
 #include "ThreadPool.hpp"
+#include "MPSCQueue.hpp"
 #include "VisibleRegions.hpp"
 
 #include "ImageButton.hpp"
@@ -51,20 +58,30 @@
 #include "LeftPanelHeader.hpp"
 #include "LeftPanel.hpp"
 #include "TextInputDialog.hpp"
+#include "ExportDialog.hpp"
 #include "PinComponent.hpp"
 #include "SavePNGProgressWindow.hpp"
 #include "Palette.hpp"
 #include "RegionToTexture.hpp"
+#include "TileCacheWriter.hpp"
 #include "TexturePackJob.hpp"
 #include "JavaTexturePackJob.hpp"
 #include "BedrockTexturePackJob.hpp"
+#include "OverviewJob.hpp"
 #include "TexturePackThreadPool.hpp"
 #include "JavaTexturePackThreadPool.hpp"
 #include "BedrockTexturePackThreadPool.hpp"
+#include "ParallelFor.hpp"
+#include "SoftwareRenderer.hpp"
+#include "ExportJob.hpp"
 #include "GLUniforms.hpp"
 #include "GLVertex.hpp"
 #include "GLAttributes.hpp"
 #include "GLBuffer.hpp"
+#include "GLStateCache.hpp"
+#include "GLVertexArray.hpp"
+#include "GLTimer.hpp"
+#include "MapComposite.hpp"
 #include "PinEdit.hpp"
 #include "WorldScanThread.hpp"
 #include "JavaWorldScanThread.hpp"
@@ -112,6 +129,12 @@ public:
     // 9. Copy stdout to CreateBedrockTable at Palette.cpp
 #endif
 
+    // Spans of the tile pipeline are saved to the file on exit. The map's context menu with shift held toggles tracing too
+    if (String trace = SystemStats::getEnvironmentVariable("MCVIEW_TRACE", {}); trace.isNotEmpty()) {
+      fTraceFile = File::getCurrentWorkingDirectory().getChildFile(trace);
+      Trace::SetEnabled(true);
+    }
+
     fCleanup.reset(new DirectoryCleanupThread);
     fCleanup->startThread();
     LocalisedStrings::setCurrentMappings(LocalizationHelper::CurrentLocalisedStrings());
@@ -127,6 +150,9 @@ public:
     if (fCleanup) {
       fCleanup->stopThread(-1);
     }
+    if (fTraceFile != juce::File() && Trace::Enabled()) {
+      Trace::Save(fTraceFile);
+    }
   }
 
   void systemRequestedQuit() override {
@@ -140,6 +166,7 @@ private:
   std::unique_ptr<MainWindow> mainWindow;
   std::unique_ptr<mcview::LookAndFeel> fLookAndFeel;
   std::unique_ptr<DirectoryCleanupThread> fCleanup;
+  juce::File fTraceFile;
 };
 
 } // namespace mcview
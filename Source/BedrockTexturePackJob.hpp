@@ -10,8 +10,9 @@ public:
                         Dimension dim,
                         std::optional<int64_t> lastPlayed,
                         bool useCache,
+                        TileCacheWriter *cacheWriter,
                         Delegate *delegate)
-      : TexturePackJob("", region, delegate),
+      : TexturePackJob("", region, cacheWriter, delegate),
         fDb(db),
         fWorldDirectory(worldDirectory),
         fDimension(dim),
@@ -20,27 +21,41 @@ public:
   }
 
   ThreadPoolJob::JobStatus runJob() override {
+    Trace::Span span("TexturePackJob::runJob", fRegion);
     auto result = std::make_shared<Result>(fWorldDirectory, fDimension, fRegion);
+    int64_t timestamp = 0;
+    std::optional<uint64_t> fingerprint;
+    bool store = false;
     defer {
+      result->buildLods();
       fDelegate->texturePackJobDidFinish(result);
+      if (store && fingerprint) {
+        fCacheWriter->enqueue(result->fPixels, timestamp, CacheFile(*fingerprint));
+      }
+      if (fingerprint && result->fPixels) {
+        storeCacheIndex(fWorldDirectory, fDimension, *fingerprint);
+      }
     };
     try {
-      juce::File cache = CacheFile(fWorldDirectory, fDimension, fRegion);
-      if (fUseCache && cache.existsAsFile()) {
-        if (LoadCache(result->fPixels, fLastPlayed, cache)) {
+      {
+        Trace::Span fp("TexturePackJob::ContentFingerprint", fRegion);
+        fingerprint = ContentFingerprint(*fDb, fDimension, fRegion);
+      }
+      if (fUseCache && fingerprint) {
+        if (loadCache(result->fPixels, std::nullopt, CacheFile(*fingerprint))) {
           return ThreadPoolJob::jobHasFinished;
         }
       }
 
-      result->fPixels.reset(RegionToTexture::LoadBedrock(*fDb, fRegion.first, fRegion.second, fDimension, *this));
+      result->fPixels.reset(RegionToTexture::LoadBedrock(*fDb, fRegion.first, fRegion.second, fDimension, *this, provisionalDelivery(fWorldDirectory, fDimension)));
       if (shouldExit()) {
         return ThreadPoolJob::jobHasFinished;
       }
-      int64_t timestamp = (int64_t)floor(juce::Time::getCurrentTime().currentTimeMillis() / 1000.0);
+      timestamp = (int64_t)floor(juce::Time::getCurrentTime().currentTimeMillis() / 1000.0);
       if (fLastPlayed) {
         timestamp = *fLastPlayed;
       }
-      StoreCache(result->fPixels.get(), timestamp, cache);
+      store = result->fPixels != nullptr;
       return ThreadPoolJob::jobHasFinished;
     } catch (std::exception &e) {
       juce::Logger::writeToLog(e.what());
@@ -53,6 +68,99 @@ public:
     }
   }
 
+  // Layout of the records the map is drawn from, of every chunk in the region: their keys and sizes, and the values of the small records that change when a chunk is saved.
+  // Values of the terrain records are not read, so that a cache hit costs a walk over the keys rather than decoding the region.
+  // Keys are hashed, so that worlds with the same chunk layout get fingerprints of their own. Entities and ticks are left out, they change without changing the map
+  static std::optional<uint64_t> ContentFingerprint(leveldb::DB &db, Dimension dim, Region region) {
+    Fingerprint fp;
+    fp.update(std::string("bedrock"));
+    fp.update(dim);
+    fp.update(region);
+    int32_t const dimension = dim == Dimension::TheNether ? 1 : (dim == Dimension::TheEnd ? 2 : 0);
+    leveldb::ReadOptions options;
+    // A walk over the whole region would push the blocks the map view reads out of the cache
+    options.fill_cache = false;
+    std::unique_ptr<leveldb::Iterator> itr(db.NewIterator(options));
+    bool found = false;
+    for (int cz = region.second * 32; cz < region.second * 32 + 32; cz++) {
+      for (int cx = region.first * 32; cx < region.first * 32 + 32; cx++) {
+        std::string const prefix = ChunkKeyPrefix(cx, cz, dimension);
+        for (itr->Seek(prefix); itr->Valid(); itr->Next()) {
+          leveldb::Slice const key = itr->key();
+          if (!key.starts_with(prefix)) {
+            break;
+          }
+          // Keys of the other dimensions start with the overworld's prefix too
+          if (key.size() != prefix.size() + 1 && key.size() != prefix.size() + 2) {
+            continue;
+          }
+          uint8_t const tag = (uint8_t)key[prefix.size()];
+          bool const terrain = IsTerrainTag(tag);
+          bool const hashed = IsHashedTag(tag);
+          if (!terrain && !hashed) {
+            continue;
+          }
+          leveldb::Slice const value = itr->value();
+          fp.update(key.data(), key.size());
+          fp.update(value.size());
+          if (hashed) {
+            fp.update(value.data(), value.size());
+          }
+          found |= terrain;
+        }
+      }
+    }
+    if (!found) {
+      return std::nullopt;
+    }
+    return fp.value();
+  }
+
+private:
+  // Chunk keys are x and z, then the dimension unless it is the overworld, all 32bit little endian
+  static std::string ChunkKeyPrefix(int32_t cx, int32_t cz, int32_t dimension) {
+    std::string prefix;
+    auto append = [&prefix](int32_t v) {
+      for (int i = 0; i < 4; i++) {
+        prefix.push_back((char)(((uint32_t)v >> (8 * i)) & 0xff));
+      }
+    };
+    append(cx);
+    append(cz);
+    if (dimension != 0) {
+      append(dimension);
+    }
+    return prefix;
+  }
+
+  // Records of a few bytes whose values are part of the fingerprint
+  static bool IsHashedTag(uint8_t tag) {
+    switch (tag) {
+    case 0x2c: // Version
+    case 0x36: // FinalizedState
+    case 0x3b: // Checksums, written by versions before 1.18 with a hash of each sub chunk
+    case 0x76: // LegacyVersion
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  static bool IsTerrainTag(uint8_t tag) {
+    switch (tag) {
+    case 0x2b: // Data3D
+    case 0x2c: // Version
+    case 0x2d: // Data2D
+    case 0x2e: // Data2DLegacy
+    case 0x2f: // SubChunkPrefix
+    case 0x30: // LegacyTerrain
+    case 0x76: // LegacyVersion
+      return true;
+    default:
+      return false;
+    }
+  }
+
 private:
   leveldb::DB *const fDb;
   juce::File const fWorldDirectory;
@@ -9,8 +9,9 @@ public:
                                std::optional<int64_t> lastPlayed,
                                std::shared_ptr<leveldb::DB> db,
                                std::shared_ptr<je2be::ReadonlyDb::Closer> dbAttachment,
+                               std::shared_ptr<TileCacheWriter> cacheWriter,
                                Delegate *delegate)
-      : TexturePackThreadPool(delegate),
+      : TexturePackThreadPool(cacheWriter, delegate),
         fDb(db),
         fDbAttachment(dbAttachment),
         fWorldDirectory(dir),
@@ -27,7 +28,50 @@ public:
     if (!fDb || !fDbAttachment) {
       return;
     }
-    addJob(new BedrockTexturePackJob(fDb.get(), fWorldDirectory, region, fDimension, fLastPlayed, useCache, this), true);
+    addJob(new BedrockTexturePackJob(fDb.get(), fWorldDirectory, region, fDimension, fLastPlayed, useCache, fCacheWriter.get(), this), true);
+  }
+
+  static bool OpenDb(juce::File directory, std::shared_ptr<leveldb::DB> &db, std::shared_ptr<je2be::ReadonlyDb::Closer> &dbAttachment) {
+    juce::String workDirName = juce::String("proxy-") + juce::Uuid().toDashedString();
+    juce::File work = WorkingDirectory().getChildFile(workDirName);
+    if (!work.deleteRecursively() || !work.createDirectory()) {
+      return false;
+    }
+    leveldb::DB *ptr = nullptr;
+    std::unique_ptr<je2be::ReadonlyDb::Closer> closer;
+    if (auto st = je2be::ReadonlyDb::Open(PathFromFile(directory) / "db", &ptr, PathFromFile(work), closer); st.ok() && closer && ptr) {
+      dbAttachment.reset(closer.release());
+      db.reset(ptr);
+      return true;
+    }
+    return false;
+  }
+
+  static std::optional<int64_t> ReadLastPlayedTimestamp(std::filesystem::path const &dat) {
+    auto fs = std::make_shared<mcfile::stream::FileInputStream>(dat);
+    if (!fs->valid()) {
+      return std::nullopt;
+    }
+    mcfile::stream::InputStreamReader reader(fs, mcfile::Encoding::LittleEndian);
+    uint32_t version;
+    if (!reader.read(&version)) {
+      return std::nullopt;
+    }
+    uint32_t size;
+    if (!reader.read(&size)) {
+      return std::nullopt;
+    }
+    std::string buffer;
+    buffer.resize(size);
+    if (!fs->read(buffer.data(), buffer.size())) {
+      return std::nullopt;
+    }
+    fs.reset();
+    auto comp = mcfile::nbt::CompoundTag::Read(buffer, mcfile::Encoding::LittleEndian);
+    if (!comp) {
+      return std::nullopt;
+    }
+    return comp->int64(u8"LastPlayed");
   }
 
 public:
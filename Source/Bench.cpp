@@ -0,0 +1,747 @@
+#include <colormap/colormap.h>
+#include <juce_core/juce_core.h>
+#include <juce_graphics/juce_graphics.h>
+#include <leveldb/env.h>
+#include <minecraft-file.hpp>
+#include <nlohmann/json.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#if JUCE_WINDOWS
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "db/_readonly-db.hpp"
+
+// clang-format off
+#include "defer.hpp"
+
+#include "PaletteType.hpp"
+#include "LightingType.hpp"
+#include "Edition.hpp"
+#include "File.hpp"
+#include "LookAt.hpp"
+#include "Dimension.hpp"
+#include "Region.hpp"
+#include "RegionGrid.hpp"
+#include "Fingerprint.hpp"
+#include "PNGWriter.hpp"
+#include "PixelConversion.hpp"
+#include "Trace.hpp"
+#include "ThreadPool.hpp"
+#include "VisibleRegions.hpp"
+#include "Palette.hpp"
+#include "RegionToTexture.hpp"
+#include "TileCacheWriter.hpp"
+#include "TexturePackJob.hpp"
+#include "JavaTexturePackJob.hpp"
+#include "BedrockTexturePackJob.hpp"
+#include "OverviewJob.hpp"
+#include "TexturePackThreadPool.hpp"
+#include "JavaTexturePackThreadPool.hpp"
+#include "BedrockTexturePackThreadPool.hpp"
+// clang-format on
+
+namespace mcview {
+
+// Allocations made through operator new. Those made by leveldb and zlib with malloc are not counted
+static std::atomic<int64_t> sAllocationCount = 0;
+static std::atomic<int64_t> sAllocatedBytes = 0;
+
+} // namespace mcview
+
+void *operator new(std::size_t size) {
+  mcview::sAllocationCount.fetch_add(1, std::memory_order_relaxed);
+  mcview::sAllocatedBytes.fetch_add((int64_t)size, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size); p) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+namespace mcview {
+
+// Measures the decoding pipeline of mcview on a fixed corpus of worlds, one stage at a time on a single thread:
+// java.load and bedrock.load (RegionToTexture::LoadJava and LoadBedrock, including Pack), pack (Pack alone),
+// cache.store and cache.load (the gzip codec of the tile cache), grid.lookup.* (RegionGrid, on synthetic grids of 1k to 100k regions),
+// png.convert (PixelConversion), png.filter.* (one per PNGFilterHeuristic), and png.encode (PNGWriter).
+// png.encode.parallel (ParallelPNGWriter) is the only stage using every core, to compare against png.encode.
+// The png stages also report MB/s of their input pixels per thread.
+// png.encode.8k.t* encode one 8192x8192 image with 1, 2, 4, ... threads up to every core, with the speedup relative to 1 thread.
+class Bench {
+  struct Stage {
+    juce::String fName;
+    int fRegions = 0;
+    // Block columns with a surface, so that sparse and dense regions compare
+    int64_t fColumns = 0;
+    int64_t fBytes = 0;
+    // Input bytes of one run, for the stages measured in MB/s
+    int64_t fProcessedBytes = 0;
+    // Threads a run uses. MB/s is reported per thread
+    int fThreads = 1;
+    // Stage the speedup is relative to, if any
+    juce::String fBaseline;
+    int64_t fAllocations = 0;
+    int64_t fAllocatedBytes = 0;
+    int64_t fPeakRSS = 0;
+    std::vector<double> fSeconds;
+  };
+
+  // Times one call into the given run of a stage, and counts the allocations made in it
+  class Measure {
+  public:
+    Measure(Stage &stage, int run) : fStage(stage), fRun(run), fAllocations(sAllocationCount.load()), fBytes(sAllocatedBytes.load()), fStart(juce::Time::getMillisecondCounterHiRes()) {}
+
+    ~Measure() {
+      fStage.fSeconds[fRun] += (juce::Time::getMillisecondCounterHiRes() - fStart) / 1000.0;
+      fStage.fAllocations += sAllocationCount.load() - fAllocations;
+      fStage.fAllocatedBytes += sAllocatedBytes.load() - fBytes;
+    }
+
+  private:
+    Stage &fStage;
+    int const fRun;
+    int64_t const fAllocations;
+    int64_t const fBytes;
+    double const fStart;
+  };
+
+  class Job : public ThreadPoolJob {
+  public:
+    Job() : ThreadPoolJob("mcview::Bench::Job") {}
+
+    JobStatus runJob() override {
+      return jobHasFinished;
+    }
+  };
+
+  struct Texture {
+    std::shared_ptr<juce::PixelARGB[]> fPixels;
+    int64_t fColumns;
+  };
+
+public:
+  Bench(std::vector<juce::File> worlds, int repeat, int maxRegions) : fWorlds(worlds), fRepeat(repeat), fMaxRegions(maxRegions) {}
+
+  bool run() {
+    fTemporary = juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("mcview-bench-" + juce::Uuid().toDashedString());
+    if (fTemporary.createDirectory().failed()) {
+      std::cerr << "Error: cannot create " << fTemporary.getFullPathName() << std::endl;
+      return false;
+    }
+    defer {
+      fTemporary.deleteRecursively();
+    };
+
+    std::vector<Texture> textures;
+    for (juce::File const &world : fWorlds) {
+      bool const bedrock = world.getChildFile("db").exists();
+      if (!bedrock && !world.getChildFile("level.dat").existsAsFile()) {
+        std::cerr << "Error: " << world.getFullPathName() << " is not a world directory" << std::endl;
+        return false;
+      }
+      bool const ok = bedrock ? loadBedrock(world, textures) : loadJava(world, textures);
+      if (!ok) {
+        return false;
+      }
+    }
+    if (textures.empty()) {
+      std::cerr << "Error: no regions in the corpus" << std::endl;
+      return false;
+    }
+    pack(textures);
+    cache(textures);
+    grid();
+    png(textures);
+    return true;
+  }
+
+  void print() const {
+    std::cout << juce::String("stage").paddedRight(' ', 20) << juce::String("regions/s").paddedLeft(' ', 12) << juce::String("columns/s").paddedLeft(' ', 14)
+              << juce::String("allocs/region").paddedLeft(' ', 15) << juce::String("MB/region").paddedLeft(' ', 11) << juce::String("peak RSS MB").paddedLeft(' ', 13)
+              << juce::String("MB/s/thread").paddedLeft(' ', 13) << juce::String("speedup").paddedLeft(' ', 9) << std::endl;
+    for (Stage const &stage : fStages) {
+      double const seconds = Best(stage);
+      double const regions = (std::max)(stage.fRegions, 1);
+      std::cout << stage.fName.paddedRight(' ', 20)
+                << juce::String(stage.fRegions / seconds, 1).paddedLeft(' ', 12)
+                << juce::String(stage.fColumns / seconds, 0).paddedLeft(' ', 14)
+                << juce::String(stage.fAllocations / (double)fRepeat / regions, 1).paddedLeft(' ', 15)
+                << juce::String(stage.fAllocatedBytes / (double)fRepeat / regions / (1024.0 * 1024.0), 2).paddedLeft(' ', 11)
+                << juce::String(stage.fPeakRSS / (1024.0 * 1024.0), 1).paddedLeft(' ', 13)
+                << (stage.fProcessedBytes > 0 ? juce::String(MegabytesPerSecond(stage) / stage.fThreads, 1) : juce::String("-")).paddedLeft(' ', 13);
+      if (auto speedup = Speedup(stage); speedup) {
+        std::cout << juce::String(*speedup, 2).paddedLeft(' ', 9);
+      } else {
+        std::cout << juce::String("-").paddedLeft(' ', 9);
+      }
+      std::cout << std::endl;
+    }
+  }
+
+  nlohmann::json toJSON() const {
+    using nlohmann::json;
+    json obj;
+    obj["version"] = MCVIEW_VERSION_STRING;
+    obj["os"] = juce::SystemStats::getOperatingSystemName().toStdString();
+    obj["cpu"] = juce::SystemStats::getCpuModel().toStdString();
+    obj["num_cpus"] = juce::SystemStats::getNumCpus();
+    obj["repeat"] = fRepeat;
+    obj["peak_rss_per_stage"] = PeakRSSPerStage();
+    json corpus = json::array();
+    for (juce::File const &world : fWorlds) {
+      corpus.push_back(world.getFullPathName().toStdString());
+    }
+    obj["corpus"] = corpus;
+    json stages = json::array();
+    for (Stage const &stage : fStages) {
+      double const seconds = Best(stage);
+      json s;
+      s["name"] = stage.fName.toStdString();
+      s["regions"] = stage.fRegions;
+      s["columns"] = stage.fColumns;
+      s["seconds"] = stage.fSeconds;
+      s["regions_per_second"] = stage.fRegions / seconds;
+      s["columns_per_second"] = stage.fColumns / seconds;
+      s["allocations"] = stage.fAllocations / fRepeat;
+      s["allocated_bytes"] = stage.fAllocatedBytes / fRepeat;
+      s["peak_rss_bytes"] = stage.fPeakRSS;
+      if (stage.fBytes > 0) {
+        s["bytes"] = stage.fBytes;
+      }
+      if (stage.fProcessedBytes > 0) {
+        s["processed_bytes"] = stage.fProcessedBytes;
+        s["threads"] = stage.fThreads;
+        s["mb_per_second"] = MegabytesPerSecond(stage);
+        s["mb_per_second_per_thread"] = MegabytesPerSecond(stage) / stage.fThreads;
+      }
+      if (auto speedup = Speedup(stage); speedup) {
+        s["baseline"] = stage.fBaseline.toStdString();
+        s["speedup"] = *speedup;
+      }
+      stages.push_back(s);
+    }
+    obj["stages"] = stages;
+    return obj;
+  }
+
+private:
+  bool loadJava(juce::File world, std::vector<Texture> &textures) {
+    Stage &stage = beginStage("java.load");
+    for (Dimension dim : {Dimension::Overworld, Dimension::TheNether, Dimension::TheEnd}) {
+      std::vector<juce::File> files;
+      juce::File dir = DimensionDirectory(world, dim);
+      if (dir.isDirectory()) {
+        for (juce::DirectoryEntry entry : juce::RangedDirectoryIterator(dir, false, "*.mca")) {
+          files.push_back(entry.getFile());
+        }
+      }
+      std::sort(files.begin(), files.end());
+      truncate(files);
+      for (juce::File const &file : files) {
+        Texture texture{nullptr, 0};
+        for (int i = 0; i < fRepeat; i++) {
+          Job job;
+          Measure m(stage, i);
+          if (auto region = mcfile::je::Region::MakeRegion(PathFromFile(file)); region) {
+            texture.fPixels.reset(RegionToTexture::LoadJava(*region, dim, job));
+          }
+        }
+        add(stage, texture, textures);
+      }
+    }
+    endStage(stage);
+    return true;
+  }
+
+  bool loadBedrock(juce::File world, std::vector<Texture> &textures) {
+    std::shared_ptr<leveldb::DB> db;
+    std::shared_ptr<je2be::ReadonlyDb::Closer> dbAttachment;
+    if (!BedrockTexturePackThreadPool::OpenDb(world, db, dbAttachment)) {
+      std::cerr << "Error: cannot open " << world.getFullPathName() << std::endl;
+      return false;
+    }
+    Stage &stage = beginStage("bedrock.load");
+    for (Dimension dim : {Dimension::Overworld, Dimension::TheNether, Dimension::TheEnd}) {
+      std::set<Region> found;
+      mcfile::be::Chunk::ForAll(db.get(), DimensionFromDimension(dim), [&found](int cx, int cz) -> bool {
+        found.insert(MakeRegion(mcfile::Coordinate::RegionFromChunk(cx), mcfile::Coordinate::RegionFromChunk(cz)));
+        return true;
+      });
+      std::vector<Region> regions(found.begin(), found.end());
+      truncate(regions);
+      for (Region region : regions) {
+        Texture texture{nullptr, 0};
+        for (int i = 0; i < fRepeat; i++) {
+          Job job;
+          Measure m(stage, i);
+          texture.fPixels.reset(RegionToTexture::LoadBedrock(*db, region.first, region.second, dim, job));
+        }
+        add(stage, texture, textures);
+      }
+    }
+    endStage(stage);
+    return true;
+  }
+
+  // Pack of the columns decoded back from the loaded textures
+  void pack(std::vector<Texture> const &textures) {
+    using namespace mcfile::blocks::minecraft;
+    int const size = 512 * 512;
+    Stage &stage = beginStage("pack");
+    std::vector<RegionToTexture::PixelInfo> pixelInfo(size);
+    std::vector<Biome> biomes(size);
+    for (Texture const &texture : textures) {
+      for (int i = 0; i < size; i++) {
+        juce::uint32 const packed = texture.fPixels[i].getInARGBMaskOrder();
+        bool const isBlock = ((packed >> 22) & 0x1) == 0x1;
+        int const blockOrDepth = (int)((packed >> 6) & 0xffff);
+        pixelInfo[i].height = packed == 0 ? -1 : (int)(packed >> 23);
+        pixelInfo[i].waterDepth = isBlock ? 0 : blockOrDepth * 0xff / 0x7f;
+        pixelInfo[i].blockId = isBlock ? (mcfile::blocks::BlockId)blockOrDepth : water;
+        biomes[i] = (Biome)((packed >> 3) & 0x7);
+      }
+      for (int i = 0; i < fRepeat; i++) {
+        Measure m(stage, i);
+        std::unique_ptr<juce::PixelARGB[]> pixels(RegionToTexture::Pack(pixelInfo, biomes, 512, 512));
+      }
+      stage.fRegions++;
+      stage.fColumns += texture.fColumns;
+    }
+    endStage(stage);
+  }
+
+  void cache(std::vector<Texture> const &textures) {
+    Stage &store = beginStage("cache.store");
+    for (size_t i = 0; i < textures.size(); i++) {
+      juce::File file = cacheFile(i);
+      for (int r = 0; r < fRepeat; r++) {
+        Measure m(store, r);
+        TexturePackJob::StoreCache(textures[i].fPixels.get(), 0, file);
+      }
+      store.fRegions++;
+      store.fColumns += textures[i].fColumns;
+      store.fBytes += file.getSize();
+    }
+    endStage(store);
+
+    Stage &load = beginStage("cache.load");
+    for (size_t i = 0; i < textures.size(); i++) {
+      juce::File file = cacheFile(i);
+      for (int r = 0; r < fRepeat; r++) {
+        std::shared_ptr<juce::PixelARGB[]> pixels;
+        Measure m(load, r);
+        TexturePackJob::LoadCache(pixels, std::nullopt, file);
+      }
+      load.fRegions++;
+      load.fColumns += textures[i].fColumns;
+      load.fBytes += file.getSize();
+    }
+    endStage(load);
+  }
+
+  // Work of the map view per frame on grids of growing size: a visit of the regions in a viewport, and lookups of the eight neighbours of each, as shading does.
+  // grid.lookup.* of every size process the same regions per frame, so their regions/s stay the same when the cost does not depend on the size of the world
+  void grid() {
+    int const viewportWidth = 8;
+    int const viewportHeight = 6;
+    int const frames = 10000;
+    for (int count : {1000, 10000, 100000}) {
+      int const side = (int)std::ceil(std::sqrt((double)count));
+      RegionGrid<int> grid;
+      for (int i = 0; i < count; i++) {
+        grid[MakeRegion(i % side, i / side)] = std::make_unique<int>(i);
+      }
+      Stage &stage = beginStage("grid.lookup." + juce::String(count / 1000) + "k");
+      for (int r = 0; r < fRepeat; r++) {
+        size_t found = 0;
+        {
+          Measure m(stage, r);
+          for (int frame = 0; frame < frames; frame++) {
+            // The viewport wanders over the world, as scrolling does
+            int const minRx = (frame * 7) % (side - viewportWidth);
+            int const minRz = (frame * 3) % (side - viewportHeight);
+            grid.forEachIn(minRx, minRz, minRx + viewportWidth - 1, minRz + viewportHeight - 1, [&grid, &found](Region region, int &) {
+              for (int dz = -1; dz <= 1; dz++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                  if (grid.contains(MakeRegion(region.first + dx, region.second + dz))) {
+                    found++;
+                  }
+                }
+              }
+            });
+          }
+        }
+        fSink = fSink + found;
+      }
+      stage.fRegions = viewportWidth * viewportHeight * frames;
+      endStage(stage);
+    }
+  }
+
+  void png(std::vector<Texture> const &textures) {
+    int const size = 512;
+    size_t const rowBytes = size * 4;
+    std::vector<juce::uint8> raw(size * rowBytes);
+
+    Stage &convert = beginStage("png.convert");
+    for (Texture const &texture : textures) {
+      std::vector<juce::PixelARGB> colors = Colors(texture);
+      for (int r = 0; r < fRepeat; r++) {
+        Measure m(convert, r);
+        for (int y = 0; y < size; y++) {
+          PixelConversion::UnpremultiplyRow(colors.data() + y * size, size, raw.data() + y * rowBytes);
+        }
+      }
+      convert.fRegions++;
+      convert.fColumns += texture.fColumns;
+      convert.fProcessedBytes += (int64_t)size * size * sizeof(juce::PixelARGB);
+    }
+    endStage(convert);
+
+    std::pair<char const *, PNGFilterHeuristic> const filters[] = {
+        {"adaptive", PNGFilterHeuristic::adaptive},
+        {"fast", PNGFilterHeuristic::fast},
+        {"none", PNGFilterHeuristic::none},
+        {"up", PNGFilterHeuristic::up},
+        {"paeth", PNGFilterHeuristic::paeth},
+    };
+    std::vector<juce::uint8> const zero(rowBytes, 0);
+    std::vector<juce::uint8> filtered(rowBytes + 1);
+    for (auto const &[name, heuristic] : filters) {
+      Stage &stage = beginStage(juce::String("png.filter.") + name);
+      for (Texture const &texture : textures) {
+        std::vector<juce::PixelARGB> colors = Colors(texture);
+        for (int y = 0; y < size; y++) {
+          PixelConversion::UnpremultiplyRow(colors.data() + y * size, size, raw.data() + y * rowBytes);
+        }
+        for (int r = 0; r < fRepeat; r++) {
+          Measure m(stage, r);
+          for (int y = 0; y < size; y++) {
+            juce::uint8 const *prev = y == 0 ? zero.data() : raw.data() + (y - 1) * rowBytes;
+            ParallelPNGWriter::FilterRow(prev, raw.data() + y * rowBytes, rowBytes, heuristic, filtered.data());
+          }
+        }
+        stage.fRegions++;
+        stage.fColumns += texture.fColumns;
+        stage.fProcessedBytes += (int64_t)size * rowBytes;
+      }
+      endStage(stage);
+    }
+
+    Stage &encode = beginStage("png.encode");
+    for (Texture const &texture : textures) {
+      std::vector<juce::PixelARGB> colors = Colors(texture);
+      for (int r = 0; r < fRepeat; r++) {
+        juce::MemoryOutputStream stream;
+        {
+          Measure m(encode, r);
+          PNGWriter writer(size, size, stream, PNGFilterHeuristic::adaptive);
+          for (int y = 0; y < size; y++) {
+            writer.writeRow(colors.data() + y * size);
+          }
+        }
+        if (r == 0) {
+          encode.fBytes += (int64_t)stream.getDataSize();
+        }
+      }
+      encode.fRegions++;
+      encode.fColumns += texture.fColumns;
+      encode.fProcessedBytes += (int64_t)size * size * sizeof(juce::PixelARGB);
+    }
+    endStage(encode);
+
+    Stage &parallel = beginStage("png.encode.parallel");
+    int const numThreads = juce::SystemStats::getNumCpus();
+    parallel.fThreads = numThreads;
+    for (Texture const &texture : textures) {
+      std::vector<juce::PixelARGB> colors = Colors(texture);
+      for (int r = 0; r < fRepeat; r++) {
+        juce::MemoryOutputStream stream;
+        {
+          Measure m(parallel, r);
+          ParallelPNGWriter writer(size, size, stream, PNGEncodeOptions::kDefaultCompressionLevel, PNGFilterHeuristic::adaptive, numThreads);
+          writer.writeRows(colors.data(), size);
+        }
+        if (r == 0) {
+          parallel.fBytes += (int64_t)stream.getDataSize();
+        }
+      }
+      parallel.fRegions++;
+      parallel.fColumns += texture.fColumns;
+      parallel.fProcessedBytes += (int64_t)size * size * sizeof(juce::PixelARGB);
+    }
+    endStage(parallel);
+
+    encodeLarge(textures);
+  }
+
+  // One 8192x8192 image tiled with the corpus, as a large export would be, encoded with 1, 2, 4, ... threads up to every core
+  void encodeLarge(std::vector<Texture> const &textures) {
+    int const size = 512;
+    int const tiles = 16;
+    int const width = size * tiles;
+    std::vector<juce::PixelARGB> image((size_t)width * width);
+    int64_t columns = 0;
+    for (int i = 0; i < tiles * tiles; i++) {
+      Texture const &texture = textures[i % textures.size()];
+      std::vector<juce::PixelARGB> colors = Colors(texture);
+      int const x0 = (i % tiles) * size;
+      int const y0 = (i / tiles) * size;
+      for (int y = 0; y < size; y++) {
+        std::copy_n(colors.data() + y * size, size, image.data() + (size_t)(y0 + y) * width + x0);
+      }
+      columns += texture.fColumns;
+    }
+
+    std::vector<int> threads;
+    int const numCpus = juce::SystemStats::getNumCpus();
+    for (int t = 1; t < numCpus; t *= 2) {
+      threads.push_back(t);
+    }
+    threads.push_back(numCpus);
+
+    juce::String const baseline = "png.encode.8k.t1";
+    for (int numThreads : threads) {
+      Stage &stage = beginStage("png.encode.8k.t" + juce::String(numThreads));
+      stage.fThreads = numThreads;
+      stage.fBaseline = baseline;
+      for (int r = 0; r < fRepeat; r++) {
+        juce::MemoryOutputStream stream;
+        {
+          Measure m(stage, r);
+          ParallelPNGWriter writer(width, width, stream, PNGEncodeOptions::kDefaultCompressionLevel, PNGFilterHeuristic::adaptive, numThreads);
+          // In strips of one region, as the export writes them
+          for (int y = 0; y < width; y += size) {
+            writer.writeRows(image.data() + (size_t)y * width, size);
+          }
+        }
+        if (r == 0) {
+          stage.fBytes = (int64_t)stream.getDataSize();
+        }
+      }
+      stage.fRegions = tiles * tiles;
+      stage.fColumns = columns;
+      stage.fProcessedBytes = (int64_t)width * width * sizeof(juce::PixelARGB);
+      endStage(stage);
+    }
+  }
+
+  // The map as PNG encoders see it: opaque where the region has a surface, transparent elsewhere.
+  // Packed pixels stand in for the colors, so that the rows are as irregular as a rendered map
+  static std::vector<juce::PixelARGB> Colors(Texture const &texture) {
+    std::vector<juce::PixelARGB> colors(512 * 512);
+    for (int i = 0; i < 512 * 512; i++) {
+      juce::uint32 const packed = texture.fPixels[i].getInARGBMaskOrder();
+      if (packed == 0) {
+        colors[i] = juce::PixelARGB(0, 0, 0, 0);
+      } else {
+        colors[i] = juce::PixelARGB(0xff, (juce::uint8)(packed >> 16), (juce::uint8)(packed >> 8), (juce::uint8)packed);
+      }
+    }
+    return colors;
+  }
+
+  juce::File cacheFile(size_t index) const {
+    return fTemporary.getChildFile(juce::String((juce::int64)index) + ".gz");
+  }
+
+  // Empty regions are not part of the corpus
+  void add(Stage &stage, Texture texture, std::vector<Texture> &textures) const {
+    if (!texture.fPixels) {
+      return;
+    }
+    for (int i = 0; i < 512 * 512; i++) {
+      if (texture.fPixels[i].getInARGBMaskOrder() != 0) {
+        texture.fColumns++;
+      }
+    }
+    stage.fRegions++;
+    stage.fColumns += texture.fColumns;
+    textures.push_back(texture);
+  }
+
+  template <class T>
+  void truncate(std::vector<T> &items) const {
+    if (fMaxRegions > 0 && (int)items.size() > fMaxRegions) {
+      items.resize(fMaxRegions);
+    }
+  }
+
+  Stage &beginStage(juce::String name) {
+    for (Stage &stage : fStages) {
+      if (stage.fName == name) {
+        ResetPeakRSS();
+        return stage;
+      }
+    }
+    Stage stage;
+    stage.fName = name;
+    stage.fSeconds.assign(fRepeat, 0.0);
+    fStages.push_back(stage);
+    ResetPeakRSS();
+    return fStages.back();
+  }
+
+  void endStage(Stage &stage) {
+    stage.fPeakRSS = (std::max)(stage.fPeakRSS, PeakRSS());
+    std::cout << stage.fName << ": " << stage.fRegions << " regions" << std::endl;
+  }
+
+  static double MegabytesPerSecond(Stage const &stage) {
+    return stage.fProcessedBytes / Best(stage) / (1024.0 * 1024.0);
+  }
+
+  // How many times faster than its baseline a stage ran
+  std::optional<double> Speedup(Stage const &stage) const {
+    if (stage.fBaseline.isEmpty()) {
+      return std::nullopt;
+    }
+    for (Stage const &baseline : fStages) {
+      if (baseline.fName == stage.fBaseline) {
+        return Best(baseline) / Best(stage);
+      }
+    }
+    return std::nullopt;
+  }
+
+  // Fastest of the repeated runs of a stage
+  static double Best(Stage const &stage) {
+    double best = std::numeric_limits<double>::max();
+    for (double s : stage.fSeconds) {
+      best = (std::min)(best, s);
+    }
+    return (std::max)(best, 1e-9);
+  }
+
+  // Linux can reset the peak, so that it is per stage. Elsewhere it is the peak of the process so far
+  static bool PeakRSSPerStage() {
+#if JUCE_LINUX
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  static void ResetPeakRSS() {
+#if JUCE_LINUX
+    juce::File("/proc/self/clear_refs").replaceWithText("5");
+#endif
+  }
+
+  static int64_t PeakRSS() {
+#if JUCE_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+      return (int64_t)counters.PeakWorkingSetSize;
+    }
+    return 0;
+#elif JUCE_LINUX
+    juce::StringArray lines;
+    juce::File("/proc/self/status").readLines(lines);
+    for (auto const &line : lines) {
+      if (line.startsWith("VmHWM:")) {
+        return line.fromFirstOccurrenceOf(":", false, false).trim().getLargeIntValue() * 1024;
+      }
+    }
+    return 0;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+      return 0;
+    }
+    // Bytes on macOS
+    return (int64_t)usage.ru_maxrss;
+#endif
+  }
+
+private:
+  std::vector<juce::File> const fWorlds;
+  int const fRepeat;
+  int const fMaxRegions;
+  juce::File fTemporary;
+  std::deque<Stage> fStages;
+  // Results of stages that have no output, so that the optimizer keeps the work measured
+  size_t volatile fSink = 0;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Bench)
+};
+
+} // namespace mcview
+
+int main(int argc, char *argv[]) {
+  juce::ArgumentList args(argc, argv);
+  std::optional<juce::File> json;
+  if (args.containsOption("--json")) {
+    juce::String const file = args.removeValueForOption("--json");
+    if (file.isEmpty()) {
+      std::cerr << "Error: --json requires a file" << std::endl;
+      return 1;
+    }
+    json = juce::File::getCurrentWorkingDirectory().getChildFile(file);
+  }
+  int repeat = 1;
+  if (args.containsOption("--repeat")) {
+    repeat = args.removeValueForOption("--repeat").getIntValue();
+  }
+  int maxRegions = 0;
+  if (args.containsOption("--max-regions")) {
+    maxRegions = args.removeValueForOption("--max-regions").getIntValue();
+  }
+  if (args.size() == 0 || repeat < 1 || maxRegions < 0) {
+    std::cerr << "Usage: " << args.executableName << " [--json <file>] [--repeat <n>] [--max-regions <n>] <world directory>..." << std::endl;
+    std::cerr << "  --json         Also write the results to <file> as JSON" << std::endl;
+    std::cerr << "  --repeat       Run every stage n times and report the fastest run. Default 1" << std::endl;
+    std::cerr << "  --max-regions  Use only the first n regions of each dimension, sorted by name. Default all" << std::endl;
+    return 1;
+  }
+  std::vector<juce::File> worlds;
+  for (int i = 0; i < args.size(); i++) {
+    juce::File world = args[i].resolveAsFile();
+    if (!world.isDirectory()) {
+      std::cerr << "Error: " << world.getFullPathName() << " does not exist" << std::endl;
+      return 1;
+    }
+    worlds.push_back(world);
+  }
+
+  mcview::Bench bench(worlds, repeat, maxRegions);
+  if (!bench.run()) {
+    return 1;
+  }
+  bench.print();
+  if (json) {
+    if (!json->replaceWithText(juce::String(bench.toJSON().dump(2)))) {
+      std::cerr << "Error: cannot write " << json->getFullPathName() << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
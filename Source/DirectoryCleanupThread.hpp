@@ -2,8 +2,15 @@
 
 namespace mcview {
 
+// Removes cache directories of older versions and the runtime directory left by earlier runs, then evicts tiles from the content store.
+// Indices not touched for kIndexExpiryDays are dropped, and tiles no index refers to are deleted once they are kTileGraceDays old,
+// so that the store is bounded by the regions of worlds recently opened rather than growing with every change.
 class DirectoryCleanupThread : public juce::Thread {
 public:
+  static int constexpr kIndexExpiryDays = 60;
+  // Tiles are written before their index, keep fresh ones for the index to catch up
+  static int constexpr kTileGraceDays = 1;
+
   DirectoryCleanupThread() : juce::Thread("Directory cleanup thread") {
     auto dir = CacheDirectory();
     auto prefix = TexturePackJob::CacheDirPrefix();
@@ -28,6 +35,47 @@ public:
       }
       dir.deleteRecursively(false);
     }
+    evictContent();
+  }
+
+private:
+  void evictContent() {
+    using namespace juce;
+    File content = TexturePackJob::CacheContentDirectory();
+    if (!content.isDirectory()) {
+      return;
+    }
+    Time const now = Time::getCurrentTime();
+    std::set<uint64_t> referenced;
+    for (auto const &it : RangedDirectoryIterator(CacheDirectory(), true, "*.idx", File::findFiles, File::FollowSymlinks::no)) {
+      if (threadShouldExit()) {
+        return;
+      }
+      File index = it.getFile();
+      if (!index.getParentDirectory().getFileName().startsWith(TexturePackJob::CacheDirPrefix())) {
+        continue;
+      }
+      if (now - it.getModificationTime() > RelativeTime::days(kIndexExpiryDays)) {
+        index.deleteFile();
+        continue;
+      }
+      if (auto fingerprint = Fingerprint::FromString(index.loadFileAsString().trim()); fingerprint) {
+        referenced.insert(*fingerprint);
+      }
+    }
+    for (auto const &it : RangedDirectoryIterator(content, false, "*.gz", File::findFiles, File::FollowSymlinks::no)) {
+      if (threadShouldExit()) {
+        return;
+      }
+      File tile = it.getFile();
+      auto fingerprint = Fingerprint::FromString(tile.getFileNameWithoutExtension());
+      if (fingerprint && referenced.count(*fingerprint) > 0) {
+        continue;
+      }
+      if (now - it.getModificationTime() > RelativeTime::days(kTileGraceDays)) {
+        tile.deleteFile();
+      }
+    }
   }
 
 private:
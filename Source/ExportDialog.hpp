@@ -0,0 +1,258 @@
+#pragma once
+
+namespace mcview {
+
+struct ExportOptions {
+  enum class Area {
+    // Regions in the viewport
+    visible,
+    // Every region of the dimension
+    dimension,
+  };
+
+  static int constexpr kMaxScale = 64;
+
+  PNGEncodeOptions fPNG;
+  Area fArea = Area::visible;
+  // Blocks per pixel, a power of two up to kMaxScale
+  int fScale = 1;
+  // Render with ExportJob on the CPU while the map stays usable, instead of on the GL thread of the map view
+  bool fBackground = true;
+};
+
+class ExportDialog : public juce::Component {
+  enum {
+    kOk = 1,
+    kCancel = -1,
+  };
+
+  enum {
+    kEncoderParallel = 1,
+    kEncoderStandard = 2,
+  };
+
+  enum {
+    kAreaVisible = 1,
+    kAreaDimension = 2,
+  };
+
+  enum {
+    kRendererBackground = 1,
+    kRendererGPU = 2,
+  };
+
+public:
+  struct Delegate {
+    virtual ~Delegate() = default;
+    virtual void exportDialogDidClickOkButton(ExportOptions options) = 0;
+  };
+
+  ExportDialog(ExportOptions exportOptions, Delegate *delegate) : fDelegate(delegate) {
+    using namespace juce;
+    PNGEncodeOptions const &options = exportOptions.fPNG;
+
+    fAreaLabel.reset(new Label());
+    fAreaLabel->setText(TRANS("Area"), dontSendNotification);
+    addAndMakeVisible(*fAreaLabel);
+
+    fArea.reset(new ComboBox());
+    fArea->addItem(TRANS("Visible area"), kAreaVisible);
+    fArea->addItem(TRANS("Entire dimension"), kAreaDimension);
+    fArea->setSelectedId(exportOptions.fArea == ExportOptions::Area::dimension ? kAreaDimension : kAreaVisible, dontSendNotification);
+    fArea->onChange = [this]() {
+      updateRenderer();
+    };
+    addAndMakeVisible(*fArea);
+
+    fScaleLabel.reset(new Label());
+    fScaleLabel->setText(TRANS("Scale"), dontSendNotification);
+    addAndMakeVisible(*fScaleLabel);
+
+    fScale.reset(new ComboBox());
+    for (int scale = 1; scale <= ExportOptions::kMaxScale; scale *= 2) {
+      fScale->addItem(String::formatted("1:%d", scale), scale);
+    }
+    fScale->setSelectedId(exportOptions.fScale, dontSendNotification);
+    fScale->onChange = [this]() {
+      updateRenderer();
+    };
+    addAndMakeVisible(*fScale);
+
+    fRendererLabel.reset(new Label());
+    fRendererLabel->setText(TRANS("Renderer"), dontSendNotification);
+    addAndMakeVisible(*fRendererLabel);
+
+    fRenderer.reset(new ComboBox());
+    fRenderer->addItem(TRANS("CPU, in the background"), kRendererBackground);
+    fRenderer->addItem(TRANS("GPU, pauses the map"), kRendererGPU);
+    fRenderer->setSelectedId(exportOptions.fBackground ? kRendererBackground : kRendererGPU, dontSendNotification);
+    addAndMakeVisible(*fRenderer);
+    updateRenderer();
+
+    fEncoderLabel.reset(new Label());
+    fEncoderLabel->setText(TRANS("PNG encoder"), dontSendNotification);
+    addAndMakeVisible(*fEncoderLabel);
+
+    fEncoder.reset(new ComboBox());
+    fEncoder->addItem(TRANS("Parallel (all cores)"), kEncoderParallel);
+    fEncoder->addItem(TRANS("Standard (libpng)"), kEncoderStandard);
+    fEncoder->setSelectedId(options.fParallel ? kEncoderParallel : kEncoderStandard, dontSendNotification);
+    fEncoder->onChange = [this]() {
+      fCompressionLevel->setEnabled(fEncoder->getSelectedId() == kEncoderParallel);
+    };
+    addAndMakeVisible(*fEncoder);
+
+    fCompressionLevelLabel.reset(new Label());
+    fCompressionLevelLabel->setText(TRANS("Compression level"), dontSendNotification);
+    addAndMakeVisible(*fCompressionLevelLabel);
+
+    fCompressionLevel.reset(new Slider(Slider::LinearHorizontal, Slider::TextBoxRight));
+    fCompressionLevel->setRange(PNGEncodeOptions::kMinCompressionLevel, PNGEncodeOptions::kMaxCompressionLevel, 1);
+    fCompressionLevel->setValue(options.fCompressionLevel, dontSendNotification);
+    fCompressionLevel->setEnabled(options.fParallel);
+    addAndMakeVisible(*fCompressionLevel);
+
+    fFilterLabel.reset(new Label());
+    fFilterLabel->setText(TRANS("Row filter"), dontSendNotification);
+    addAndMakeVisible(*fFilterLabel);
+
+    fFilter.reset(new ComboBox());
+    fFilterItems = {
+        {PNGFilterHeuristic::adaptive, TRANS("Adaptive (smallest file)")},
+        {PNGFilterHeuristic::fast, TRANS("Fast (None, Sub, Up)")},
+        {PNGFilterHeuristic::none, "None"},
+        {PNGFilterHeuristic::up, "Up"},
+        {PNGFilterHeuristic::paeth, "Paeth"},
+    };
+    for (auto const &it : fFilterItems) {
+      fFilter->addItem(it.second, static_cast<int>(it.first) + 1);
+    }
+    fFilter->setSelectedId(static_cast<int>(options.fFilter) + 1, dontSendNotification);
+    addAndMakeVisible(*fFilter);
+
+    fOkButton.reset(new TextButton());
+    fOkButton->setButtonText("OK");
+    fOkButton->onClick = [this]() {
+      close(kOk);
+    };
+    addAndMakeVisible(*fOkButton);
+    fCancelButton.reset(new TextButton());
+    fCancelButton->setButtonText(TRANS("Cancel"));
+    fCancelButton->onClick = [this]() {
+      close(kCancel);
+    };
+    addAndMakeVisible(*fCancelButton);
+    setSize(340, 490);
+  }
+
+  void resized() override {
+    int const pad = 20;
+    int const width = getWidth();
+    int const height = getHeight();
+    int const buttonWidth = 100;
+    int const buttonHeight = 40;
+    int const labelHeight = 20;
+    int const rowHeight = 30;
+
+    int y = pad;
+    fAreaLabel->setBounds(pad, y, width - 2 * pad, labelHeight);
+    y += labelHeight;
+    fArea->setBounds(pad, y, width - 2 * pad, rowHeight);
+    y += rowHeight + pad / 2;
+    fScaleLabel->setBounds(pad, y, width - 2 * pad, labelHeight);
+    y += labelHeight;
+    fScale->setBounds(pad, y, width - 2 * pad, rowHeight);
+    y += rowHeight + pad / 2;
+    fRendererLabel->setBounds(pad, y, width - 2 * pad, labelHeight);
+    y += labelHeight;
+    fRenderer->setBounds(pad, y, width - 2 * pad, rowHeight);
+    y += rowHeight + pad / 2;
+    fEncoderLabel->setBounds(pad, y, width - 2 * pad, labelHeight);
+    y += labelHeight;
+    fEncoder->setBounds(pad, y, width - 2 * pad, rowHeight);
+    y += rowHeight + pad / 2;
+    fCompressionLevelLabel->setBounds(pad, y, width - 2 * pad, labelHeight);
+    y += labelHeight;
+    fCompressionLevel->setBounds(pad, y, width - 2 * pad, rowHeight);
+    y += rowHeight + pad / 2;
+    fFilterLabel->setBounds(pad, y, width - 2 * pad, labelHeight);
+    y += labelHeight;
+    fFilter->setBounds(pad, y, width - 2 * pad, rowHeight);
+
+    fOkButton->setBounds(width - pad - buttonWidth - pad - buttonWidth, height - pad - buttonHeight, buttonWidth, buttonHeight);
+    fCancelButton->setBounds(width - pad - buttonWidth, height - pad - buttonHeight, buttonWidth, buttonHeight);
+  }
+
+  static void showAsync(juce::Component *target, ExportOptions options, Delegate *delegate) {
+    using namespace juce;
+    ExportDialog *dialog = new ExportDialog(options, delegate);
+    DialogWindow::LaunchOptions o;
+    o.dialogTitle = TRANS("Export image");
+    o.content.setOwned(dialog);
+    o.componentToCentreAround = target;
+    o.dialogBackgroundColour = target->getLookAndFeel().findColour(ResizableWindow::ColourIds::backgroundColourId);
+    o.escapeKeyTriggersCloseButton = true;
+    o.useNativeTitleBar = true;
+    o.resizable = false;
+    o.useBottomRightCornerResizer = false;
+    o.launchAsync();
+  }
+
+private:
+  // The GPU renders what the map view has loaded, which is the visible area at full detail only
+  void updateRenderer() {
+    bool const gpu = fArea->getSelectedId() == kAreaVisible && fScale->getSelectedId() == 1;
+    fRenderer->setItemEnabled(kRendererGPU, gpu);
+    if (!gpu) {
+      fRenderer->setSelectedId(kRendererBackground, juce::dontSendNotification);
+    }
+  }
+
+  void close(int result) {
+    if (result == kOk) {
+      ExportOptions options;
+      options.fArea = fArea->getSelectedId() == kAreaDimension ? ExportOptions::Area::dimension : ExportOptions::Area::visible;
+      options.fScale = (std::max)(fScale->getSelectedId(), 1);
+      options.fBackground = fRenderer->getSelectedId() != kRendererGPU;
+      options.fPNG.fParallel = fEncoder->getSelectedId() == kEncoderParallel;
+      options.fPNG.fCompressionLevel = (int)fCompressionLevel->getValue();
+      if (auto found = fFilterItems.find(static_cast<PNGFilterHeuristic>(fFilter->getSelectedId() - 1)); found != fFilterItems.end()) {
+        options.fPNG.fFilter = found->first;
+      }
+      fDelegate->exportDialogDidClickOkButton(options);
+    }
+
+    juce::Component *pivot = this;
+    while (pivot) {
+      auto *dlg = dynamic_cast<juce::DialogWindow *>(pivot);
+      if (dlg) {
+        dlg->closeButtonPressed();
+        break;
+      }
+      pivot = pivot->getParentComponent();
+    }
+  }
+
+private:
+  Delegate *const fDelegate;
+
+  std::unique_ptr<juce::Label> fAreaLabel;
+  std::unique_ptr<juce::ComboBox> fArea;
+  std::unique_ptr<juce::Label> fScaleLabel;
+  std::unique_ptr<juce::ComboBox> fScale;
+  std::unique_ptr<juce::Label> fRendererLabel;
+  std::unique_ptr<juce::ComboBox> fRenderer;
+  std::unique_ptr<juce::Label> fEncoderLabel;
+  std::unique_ptr<juce::ComboBox> fEncoder;
+  std::unique_ptr<juce::Label> fCompressionLevelLabel;
+  std::unique_ptr<juce::Slider> fCompressionLevel;
+  std::unique_ptr<juce::Label> fFilterLabel;
+  std::unique_ptr<juce::ComboBox> fFilter;
+  std::map<PNGFilterHeuristic, juce::String> fFilterItems;
+  std::unique_ptr<juce::TextButton> fOkButton;
+  std::unique_ptr<juce::TextButton> fCancelButton;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ExportDialog)
+};
+
+} // namespace mcview
@@ -0,0 +1,251 @@
+#pragma once
+
+namespace mcview {
+
+// Exports an area of a dimension to a PNG file on a background thread, independent of what the map view shows.
+// Regions are read from the tile cache, or rendered from the world when their cache is stale, by a texture pack thread pool of the job's own, then drawn by SoftwareRenderer.
+// The image is produced one row of regions at a time. Memory is bounded by four rows of regions, the one being drawn, its neighbours and the next one being loaded,
+// plus a strip of the image one region high. Regions are kept only at the level of detail of the export, so both scale with the size of the image rather than the area.
+class ExportJob : public juce::Thread, private TexturePackThreadPool::Delegate {
+public:
+  struct Request {
+    juce::File fWorldDirectory;
+    Edition fEdition = Edition::Java;
+    Dimension fDimension = Dimension::Overworld;
+    // Blocks to export
+    juce::Rectangle<int> fArea;
+    // Blocks per pixel, a power of two up to 2^SoftwareRenderer::kMaxLod. Region textures are reduced the way the map view does when zoomed out
+    int fScale = 1;
+    juce::File fFile;
+    PNGEncodeOptions fEncode;
+    // fDimension of it is ignored
+    SoftwareRenderer::Options fRender;
+    // Bedrock only. Shared with the map view when it shows the same world
+    std::shared_ptr<leveldb::DB> fDb;
+    std::shared_ptr<je2be::ReadonlyDb::Closer> fDbAttachment;
+    std::optional<int64_t> fLastPlayed;
+  };
+
+  struct Delegate {
+    virtual ~Delegate() = default;
+    // Called on the export thread
+    virtual void exportJobDidProgress(ExportJob *job, double progress) = 0;
+    // Called on the export thread. completed is false when the job failed or was cancelled
+    virtual void exportJobDidFinish(ExportJob *job, bool completed) = 0;
+  };
+
+  ExportJob(Request request, std::shared_ptr<TileCacheWriter> cacheWriter, Delegate *delegate)
+      : juce::Thread("mcview::ExportJob"),
+        fRequest(request),
+        fCacheWriter(cacheWriter),
+        fDelegate(delegate),
+        fLod(juce::findHighestSetBit((juce::uint32)(std::max)(request.fScale, 1))) {
+  }
+
+  ~ExportJob() override {
+    stopThread(-1);
+  }
+
+  void run() override {
+    bool const completed = exportImage();
+    fDelegate->exportJobDidFinish(this, completed);
+  }
+
+  juce::File file() const {
+    return fRequest.fFile;
+  }
+
+  // Blocks for regions in rows [minRx, maxRx] x [minRz, maxRz]
+  static juce::Rectangle<int> AreaOfRegions(int minRx, int minRz, int maxRx, int maxRz) {
+    return juce::Rectangle<int>(minRx * 512, minRz * 512, (maxRx - minRx + 1) * 512, (maxRz - minRz + 1) * 512);
+  }
+
+  // Most memory an export is allowed, see MemoryUsage
+  static int64_t constexpr kMaxMemory = int64_t(2) * 1024 * 1024 * 1024;
+
+  // Bytes held at once to export area at scale: four rows of regions and their neighbours, the strip of the image, and its unpremultiplied and filtered copies in the encoder.
+  // It depends on the width of the area only, so a wide area needs a larger scale
+  static int64_t MemoryUsage(juce::Rectangle<int> area, int scale) {
+    if (area.isEmpty()) {
+      return 0;
+    }
+    int const lod = juce::findHighestSetBit((juce::uint32)(std::max)(scale, 1));
+    int64_t const size = RegionToTexture::TextureSize(lod);
+    int64_t const columns = (int64_t)((area.getRight() - 1) >> 9) - (area.getX() >> 9) + 1;
+    int64_t const tile = size * size * (int64_t)sizeof(juce::PixelARGB);
+    return 4 * (columns + 2) * tile + 3 * columns * tile;
+  }
+
+private:
+  bool exportImage() {
+    using namespace juce;
+    juce::Rectangle<int> const area = fRequest.fArea;
+    if (area.isEmpty() || !isPowerOfTwo(fRequest.fScale) || fRequest.fScale > (1 << SoftwareRenderer::kMaxLod)) {
+      return false;
+    }
+    if (MemoryUsage(area, fRequest.fScale) > kMaxMemory) {
+      return false;
+    }
+    int const lod = fLod;
+    int const size = RegionToTexture::TextureSize(lod);
+
+    std::unique_ptr<TexturePackThreadPool> pool;
+    if (fRequest.fEdition == Edition::Bedrock) {
+      if (!fRequest.fDb || !fRequest.fDbAttachment) {
+        return false;
+      }
+      pool.reset(new BedrockTexturePackThreadPool(fRequest.fWorldDirectory, fRequest.fDimension, fRequest.fLastPlayed, fRequest.fDb, fRequest.fDbAttachment, fCacheWriter, this));
+    } else {
+      pool.reset(new JavaTexturePackThreadPool(fRequest.fWorldDirectory, fRequest.fDimension, fCacheWriter, this));
+    }
+    defer {
+      pool->abandon(-1);
+    };
+
+    SoftwareRenderer::Options options = fRequest.fRender;
+    options.fDimension = fRequest.fDimension;
+    options.fLod = lod;
+    SoftwareRenderer renderer(options, [this](Region region) -> std::shared_ptr<PixelARGB[]> {
+      std::lock_guard<std::mutex> lock(fMut);
+      if (auto found = fTiles.find(region); found != fTiles.end()) {
+        return found->second;
+      }
+      return nullptr;
+    });
+
+    int const minRx = area.getX() >> 9;
+    int const maxRx = (area.getRight() - 1) >> 9;
+    int const minRz = area.getY() >> 9;
+    int const maxRz = (area.getBottom() - 1) >> 9;
+    // Texels of the area, partially covered ones included
+    int const minX = area.getX() >> lod;
+    int const minZ = area.getY() >> lod;
+    int const width = ((area.getRight() + fRequest.fScale - 1) >> lod) - minX;
+    int const height = ((area.getBottom() + fRequest.fScale - 1) >> lod) - minZ;
+    int const numThreads = SystemStats::getNumCpus();
+
+    TemporaryFile temp(fRequest.fFile);
+    {
+      FileOutputStream stream(temp.getFile());
+      if (!stream.openedOk()) {
+        return false;
+      }
+      std::unique_ptr<PNGWriter> writer;
+      std::unique_ptr<ParallelPNGWriter> parallelWriter;
+      if (fRequest.fEncode.fParallel) {
+        parallelWriter = std::make_unique<ParallelPNGWriter>(width, height, stream, fRequest.fEncode.fCompressionLevel, fRequest.fEncode.fFilter, numThreads);
+      } else {
+        writer = std::make_unique<PNGWriter>(width, height, stream, fRequest.fEncode.fFilter);
+      }
+
+      std::vector<PixelARGB> strip;
+      int y = 0;
+      for (int rz = minRz; rz <= maxRz; rz++) {
+        LookAt lookAt;
+        lookAt.fX = area.getCentreX();
+        lookAt.fZ = rz * 512 + 256;
+        pool->setLookAt(lookAt);
+        // The next row is loaded while this one is drawn
+        request(*pool, minRx - 1, maxRx + 1, rz - 1, rz + 2);
+        evict(rz - 1);
+        if (!waitForTiles(minRx - 1, maxRx + 1, rz - 1, rz + 1)) {
+          return false;
+        }
+
+        int const top = (std::max)(minZ, rz * size);
+        int const bottom = (std::min)(minZ + height, rz * size + size);
+        int const rows = bottom - top;
+        strip.resize((size_t)width * rows);
+        renderer.render(minX, top, width, rows, strip.data(), numThreads);
+        if (threadShouldExit()) {
+          return false;
+        }
+        if (parallelWriter) {
+          parallelWriter->writeRows(strip.data(), rows);
+        } else {
+          for (int row = 0; row < rows; row++) {
+            writer->writeRow(strip.data() + (size_t)row * width);
+          }
+        }
+        y += rows;
+        fDelegate->exportJobDidProgress(this, y / (double)height);
+      }
+    }
+    return temp.overwriteTargetFileWithTemporary();
+  }
+
+  void request(TexturePackThreadPool &pool, int minRx, int maxRx, int minRz, int maxRz) {
+    std::lock_guard<std::mutex> lock(fMut);
+    for (int rz = minRz; rz <= maxRz; rz++) {
+      for (int rx = minRx; rx <= maxRx; rx++) {
+        Region region = MakeRegion(rx, rz);
+        if (fRequested.insert(region).second) {
+          pool.addTexturePackJob(region, true);
+        }
+      }
+    }
+  }
+
+  // Drops rows north of minRz
+  void evict(int minRz) {
+    std::lock_guard<std::mutex> lock(fMut);
+    std::erase_if(fTiles, [minRz](auto const &it) { return it.first.second < minRz; });
+    std::erase_if(fRequested, [minRz](Region const &region) { return region.second < minRz; });
+  }
+
+  // Returns false when cancelled
+  bool waitForTiles(int minRx, int maxRx, int minRz, int maxRz) {
+    while (!threadShouldExit()) {
+      bool ready = true;
+      {
+        std::lock_guard<std::mutex> lock(fMut);
+        for (int rz = minRz; rz <= maxRz && ready; rz++) {
+          for (int rx = minRx; rx <= maxRx && ready; rx++) {
+            ready = fTiles.count(MakeRegion(rx, rz)) > 0;
+          }
+        }
+      }
+      if (ready) {
+        return true;
+      }
+      fTileArrived.wait(100);
+    }
+    return false;
+  }
+
+  void texturePackThreadPoolDidFinishJob(TexturePackThreadPool *pool, std::shared_ptr<TexturePackJob::Result> result) override {
+    if (result->fProvisional) {
+      return;
+    }
+    // nullptr for regions that don't exist
+    std::shared_ptr<juce::PixelARGB[]> tile;
+    if (result->fPixels) {
+      int const lod = fLod;
+      int const level = (std::min)(lod, (int)result->fLods.size());
+      tile = RegionToTexture::Reduce(level == 0 ? result->fPixels : result->fLods[level - 1], level, lod);
+    }
+    {
+      std::lock_guard<std::mutex> lock(fMut);
+      if (fRequested.count(result->fRegion) == 0) {
+        return;
+      }
+      fTiles[result->fRegion] = tile;
+    }
+    fTileArrived.signal();
+  }
+
+private:
+  Request const fRequest;
+  std::shared_ptr<TileCacheWriter> const fCacheWriter;
+  Delegate *const fDelegate;
+  int const fLod;
+
+  std::mutex fMut;
+  std::set<Region> fRequested;
+  std::map<Region, std::shared_ptr<juce::PixelARGB[]>> fTiles;
+  juce::WaitableEvent fTileArrived;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ExportJob)
+};
+
+} // namespace mcview
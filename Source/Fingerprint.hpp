@@ -0,0 +1,47 @@
+#pragma once
+
+namespace mcview {
+
+// 64bit FNV-1a
+class Fingerprint {
+public:
+  Fingerprint() : fHash(0xcbf29ce484222325ULL) {}
+
+  void update(void const *data, size_t size) {
+    auto p = static_cast<uint8_t const *>(data);
+    for (size_t i = 0; i < size; i++) {
+      fHash ^= p[i];
+      fHash *= 0x100000001b3ULL;
+    }
+  }
+
+  template <class T>
+  void update(T const &v) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    update(&v, sizeof(v));
+  }
+
+  void update(std::string const &s) {
+    update(s.data(), s.size());
+  }
+
+  uint64_t value() const {
+    return fHash;
+  }
+
+  static juce::String ToString(uint64_t v) {
+    return juce::String::toHexString((juce::int64)v).paddedLeft('0', 16);
+  }
+
+  static std::optional<uint64_t> FromString(juce::String const &s) {
+    if (s.length() != 16 || !s.containsOnly("0123456789abcdefABCDEF")) {
+      return std::nullopt;
+    }
+    return (uint64_t)s.getHexValue64();
+  }
+
+private:
+  uint64_t fHash;
+};
+
+} // namespace mcview
@@ -6,6 +6,10 @@ struct GLAttributes {
   GLAttributes(juce::OpenGLContext &openGLContext, juce::OpenGLShaderProgram &shader) {
     position.reset(createAttribute(openGLContext, shader, "position"));
     textureCoordIn.reset(createAttribute(openGLContext, shader, "textureCoordIn"));
+    tileIn.reset(createAttribute(openGLContext, shader, "tileIn"));
+    layers0In.reset(createAttribute(openGLContext, shader, "layers0In"));
+    layers1In.reset(createAttribute(openGLContext, shader, "layers1In"));
+    layers2In.reset(createAttribute(openGLContext, shader, "layers2In"));
   }
 
   void enable(juce::OpenGLContext &openGLContext) {
@@ -29,9 +33,37 @@ struct GLAttributes {
       openGLContext.extensions.glDisableVertexAttribArray(textureCoordIn->attributeID);
   }
 
+  // Per-instance attributes, sourced from the GLTileInstance buffer currently bound to GL_ARRAY_BUFFER
+  void enableInstances(juce::OpenGLContext &openGLContext) {
+    enableInstanceAttribute(openGLContext, tileIn.get(), 4, offsetof(GLTileInstance, tile));
+    enableInstanceAttribute(openGLContext, layers0In.get(), 4, offsetof(GLTileInstance, layers));
+    enableInstanceAttribute(openGLContext, layers1In.get(), 4, offsetof(GLTileInstance, layers) + sizeof(float) * 4);
+    enableInstanceAttribute(openGLContext, layers2In.get(), 1, offsetof(GLTileInstance, layers) + sizeof(float) * 8);
+  }
+
+  void disableInstances(juce::OpenGLContext &openGLContext) {
+    for (auto attribute : {tileIn.get(), layers0In.get(), layers1In.get(), layers2In.get()}) {
+      if (attribute) {
+        juce::gl::glVertexAttribDivisor(attribute->attributeID, 0);
+        openGLContext.extensions.glDisableVertexAttribArray(attribute->attributeID);
+      }
+    }
+  }
+
   std::unique_ptr<juce::OpenGLShaderProgram::Attribute> position, textureCoordIn;
+  std::unique_ptr<juce::OpenGLShaderProgram::Attribute> tileIn, layers0In, layers1In, layers2In;
 
 private:
+  static void enableInstanceAttribute(juce::OpenGLContext &openGLContext, juce::OpenGLShaderProgram::Attribute *attribute, GLint size, size_t offset) {
+    using namespace juce::gl;
+    if (!attribute) {
+      return;
+    }
+    openGLContext.extensions.glVertexAttribPointer(attribute->attributeID, size, GL_FLOAT, GL_FALSE, sizeof(GLTileInstance), (GLvoid *)offset);
+    openGLContext.extensions.glEnableVertexAttribArray(attribute->attributeID);
+    glVertexAttribDivisor(attribute->attributeID, 1);
+  }
+
   static juce::OpenGLShaderProgram::Attribute *createAttribute(juce::OpenGLContext &openGLContext,
                                                                juce::OpenGLShaderProgram &shader,
                                                                const char *attributeName) {
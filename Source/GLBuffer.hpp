@@ -5,6 +5,7 @@ namespace mcview {
 struct GLBuffer {
   GLuint vBuffer;
   GLuint iBuffer;
+  GLuint instanceBuffer;
 
   static GLsizei const kNumPoints = 4;
 };
@@ -0,0 +1,111 @@
+#pragma once
+
+namespace mcview {
+
+// Skips redundant program binds, texture binds and uniform writes of the modern render path.
+// When disabled, every call goes straight to GL, and textures get nearest filtering on each bind as the legacy path always did.
+// Bindings must be invalidated whenever other code may have touched them, eg. JUCE's own painting. Must be used from the GL thread.
+class GLStateCache {
+public:
+  GLStateCache() : fEnabled(false) {
+    invalidate();
+  }
+
+  void setEnabled(bool enabled) {
+    if (enabled != fEnabled) {
+      // Uniforms written while disabled were not recorded
+      fUniforms.clear();
+    }
+    fEnabled = enabled;
+    invalidate();
+  }
+
+  bool isEnabled() const {
+    return fEnabled;
+  }
+
+  // Forgets bindings, but keeps uniform values since those are stored in the programs.
+  void invalidate() {
+    fProgram = 0;
+    fActiveUnit = -1;
+    fTextures.fill({0, 0});
+  }
+
+  // Forgets everything. Call this whenever shader programs are created or deleted.
+  void reset() {
+    invalidate();
+    fUniforms.clear();
+  }
+
+  void useProgram(juce::OpenGLShaderProgram &program) {
+    if (fEnabled && fProgram == program.getProgramID()) {
+      return;
+    }
+    program.use();
+    fProgram = program.getProgramID();
+  }
+
+  void bindTexture(int unit, GLenum target, GLuint texture) {
+    using namespace juce::gl;
+    if (fEnabled && 0 <= unit && unit < kNumUnits && fTextures[unit].first == target && fTextures[unit].second == texture) {
+      return;
+    }
+    if (!fEnabled || fActiveUnit != unit) {
+      glActiveTexture(GL_TEXTURE0 + (GLenum)unit);
+      fActiveUnit = unit;
+    }
+    glBindTexture(target, texture);
+    if (0 <= unit && unit < kNumUnits) {
+      fTextures[unit] = {target, texture};
+    }
+    if (!fEnabled && target == GL_TEXTURE_2D) {
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    }
+  }
+
+  void set(juce::OpenGLShaderProgram::Uniform *uniform, GLfloat value) {
+    if (!uniform) {
+      return;
+    }
+    if (fEnabled) {
+      if (auto found = fUniforms.find(uniform); found != fUniforms.end() && found->second.fFloat && found->second.fFloatValue == value) {
+        return;
+      }
+      fUniforms[uniform] = {true, value, 0};
+    }
+    uniform->set(value);
+  }
+
+  void set(juce::OpenGLShaderProgram::Uniform *uniform, GLint value) {
+    if (!uniform) {
+      return;
+    }
+    if (fEnabled) {
+      if (auto found = fUniforms.find(uniform); found != fUniforms.end() && !found->second.fFloat && found->second.fIntValue == value) {
+        return;
+      }
+      fUniforms[uniform] = {false, 0, value};
+    }
+    uniform->set(value);
+  }
+
+private:
+  static int constexpr kNumUnits = 16;
+
+  struct UniformValue {
+    bool fFloat;
+    GLfloat fFloatValue;
+    GLint fIntValue;
+  };
+
+  bool fEnabled;
+  GLuint fProgram;
+  int fActiveUnit;
+  std::array<std::pair<GLenum, GLuint>, kNumUnits> fTextures;
+  std::unordered_map<juce::OpenGLShaderProgram::Uniform const *, UniformValue> fUniforms;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GLStateCache)
+};
+
+} // namespace mcview
@@ -0,0 +1,104 @@
+#pragma once
+
+namespace mcview {
+
+// Measures the GPU time of the commands between begin and end with GL_TIME_ELAPSED queries.
+// Results are read a few frames later so that the pipeline never stalls. Must be used from the GL thread, except for milliseconds.
+class GLTimer {
+public:
+  static int constexpr kNumQueries = 4;
+
+  GLTimer() : fQueries(kNumQueries, 0), fPending(kNumQueries, false), fIndex(0), fActive(false), fMilliseconds(-1) {}
+
+  ~GLTimer() {
+    release();
+  }
+
+  static bool IsSupported() {
+    using namespace juce::gl;
+    if (glGenQueries == nullptr || glBeginQuery == nullptr || glEndQuery == nullptr || glGetQueryObjectiv == nullptr || glGetQueryObjectui64v == nullptr) {
+      return false;
+    }
+    return juce::OpenGLHelpers::isExtensionSupported("GL_ARB_timer_query") || juce::OpenGLHelpers::isExtensionSupported("GL_EXT_timer_query");
+  }
+
+  void begin() {
+    using namespace juce::gl;
+    if (!fSupported) {
+      fSupported = IsSupported();
+    }
+    if (!*fSupported) {
+      return;
+    }
+    if (fQueries[0] == 0) {
+      glGenQueries(kNumQueries, fQueries.data());
+    }
+    for (int i = 0; i < kNumQueries; i++) {
+      collect(i);
+    }
+    if (fPending[fIndex]) {
+      // Every query is still in flight, skip this frame
+      return;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, fQueries[fIndex]);
+    fActive = true;
+  }
+
+  void end() {
+    using namespace juce::gl;
+    if (!fActive) {
+      return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    fPending[fIndex] = true;
+    fIndex = (fIndex + 1) % kNumQueries;
+    fActive = false;
+  }
+
+  // Moving average, or a negative value if not measured yet
+  float milliseconds() const {
+    return fMilliseconds.load();
+  }
+
+  void release() {
+    using namespace juce::gl;
+    if (fQueries[0] != 0) {
+      glDeleteQueries(kNumQueries, fQueries.data());
+    }
+    std::fill(fQueries.begin(), fQueries.end(), 0);
+    std::fill(fPending.begin(), fPending.end(), false);
+    fActive = false;
+    fSupported = std::nullopt;
+  }
+
+private:
+  void collect(int i) {
+    using namespace juce::gl;
+    if (!fPending[i]) {
+      return;
+    }
+    GLint available = 0;
+    glGetQueryObjectiv(fQueries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      return;
+    }
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(fQueries[i], GL_QUERY_RESULT, &ns);
+    fPending[i] = false;
+    float const ms = (float)((double)ns / 1000000.0);
+    float const previous = fMilliseconds.load();
+    fMilliseconds.store(previous < 0 ? ms : previous * 0.9f + ms * 0.1f);
+  }
+
+private:
+  std::vector<GLuint> fQueries;
+  std::vector<bool> fPending;
+  int fIndex;
+  bool fActive;
+  std::optional<bool> fSupported;
+  std::atomic<float> fMilliseconds;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GLTimer)
+};
+
+} // namespace mcview
@@ -12,6 +12,7 @@ struct GLUniforms {
     height.reset(createUniform(openGLContext, shader, "height"));
     Xr.reset(createUniform(openGLContext, shader, "Xr"));
     Zr.reset(createUniform(openGLContext, shader, "Zr"));
+    tileExtent.reset(createUniform(openGLContext, shader, "tileExtent"));
     Cx.reset(createUniform(openGLContext, shader, "Cx"));
     Cz.reset(createUniform(openGLContext, shader, "Cz"));
     grassBlockId.reset(createUniform(openGLContext, shader, "grassBlockId"));
@@ -35,12 +36,19 @@ struct GLUniforms {
     paletteSize.reset(createUniform(openGLContext, shader, "paletteSize"));
     paletteType.reset(createUniform(openGLContext, shader, "paletteType"));
     lightingType.reset(createUniform(openGLContext, shader, "lightingType"));
+    tiles.reset(createUniform(openGLContext, shader, "tiles"));
+    tileSize.reset(createUniform(openGLContext, shader, "tileSize"));
+    shade.reset(createUniform(openGLContext, shader, "shade"));
+    shaded.reset(createUniform(openGLContext, shader, "shaded"));
+    shades.reset(createUniform(openGLContext, shader, "shades"));
   }
 
   std::unique_ptr<juce::OpenGLShaderProgram::Uniform> texture, fade, heightmap, blocksPerPixel, width, height, Xr, Zr, Cx, Cz, grassBlockId, foliageBlockId, netherrackBlockId, waterBlockId, dimension;
   std::unique_ptr<juce::OpenGLShaderProgram::Uniform> north, northEast, east, southEast, south, southWest, west, northWest;
   std::unique_ptr<juce::OpenGLShaderProgram::Uniform> waterOpticalDensity, waterTranslucent, biomeBlend, enableBiome;
   std::unique_ptr<juce::OpenGLShaderProgram::Uniform> palette, paletteSize, paletteType, lightingType;
+  std::unique_ptr<juce::OpenGLShaderProgram::Uniform> tiles, tileSize, tileExtent;
+  std::unique_ptr<juce::OpenGLShaderProgram::Uniform> shade, shaded, shades;
 
 private:
   static juce::OpenGLShaderProgram::Uniform *createUniform(juce::OpenGLContext &openGLContext,
@@ -7,4 +7,9 @@ struct GLVertex {
   float texCoord[2];
 };
 
+struct GLTileInstance {
+  float tile[4];   // Xr, Zr, fade, shaded
+  float layers[9]; // center, north, northEast, east, southEast, south, southWest, west, northWest
+};
+
 } // namespace mcview
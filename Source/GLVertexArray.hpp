@@ -0,0 +1,51 @@
+#pragma once
+
+namespace mcview {
+
+// Vertex array object recording the buffer bindings and attribute layout of one shader, so that drawing with it needs a single bind.
+// Must be used from the GL thread.
+class GLVertexArray {
+public:
+  GLVertexArray() : fArray(0) {}
+
+  ~GLVertexArray() {
+    release();
+  }
+
+  static bool IsSupported() {
+    using namespace juce::gl;
+    return glGenVertexArrays != nullptr && glBindVertexArray != nullptr && glDeleteVertexArrays != nullptr;
+  }
+
+  // setup is called once, while the new array is bound, to record the layout.
+  template <class Setup>
+  void bind(Setup &&setup) {
+    using namespace juce::gl;
+    if (fArray != 0) {
+      glBindVertexArray(fArray);
+      return;
+    }
+    glGenVertexArrays(1, &fArray);
+    glBindVertexArray(fArray);
+    setup();
+  }
+
+  static void Unbind() {
+    juce::gl::glBindVertexArray(0);
+  }
+
+  void release() {
+    using namespace juce::gl;
+    if (fArray != 0) {
+      glDeleteVertexArrays(1, &fArray);
+    }
+    fArray = 0;
+  }
+
+private:
+  GLuint fArray;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GLVertexArray)
+};
+
+} // namespace mcview
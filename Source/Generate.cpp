@@ -0,0 +1,603 @@
+#include <juce_core/juce_core.h>
+#include <leveldb/db.h>
+#include <leveldb/write_batch.h>
+#include <minecraft-file.hpp>
+#include <nlohmann/json.hpp>
+
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+// clang-format off
+#include "File.hpp"
+#include "Dimension.hpp"
+#include "Region.hpp"
+#include "ParallelFor.hpp"
+// clang-format on
+
+namespace mcview {
+
+// Writes synthetic overworlds for benchmarks and tests. Every block is a function of the seed and its coordinate, computed with integer hashing and
+// fixed point noise, so the same options give the same world on every machine and compiler regardless of the number of threads or floating point contraction.
+// Fractions of the options are converted to fixed point once, by a single rounding that is exact on every IEEE platform.
+class WorldGenerator {
+public:
+  struct Options {
+    uint64_t fSeed = 1;
+    // Regions on a side of the square world, centered at the origin
+    int fRegions = 2;
+    // Approximate fraction of columns below sea level
+    double fOcean = 0.3;
+    // Blocks the land rises above sea level at most
+    int fHeightVariance = 32;
+    // Fraction of underground blocks that are stone rather than cave air
+    double fSectionDensity = 1.0;
+    // Distinct land biomes, and ocean biomes up to the same number
+    int fBiomes = 4;
+    // Fraction of chunks that exist, for sparse regions
+    double fChunkFill = 1.0;
+    // Chance of a chunk having an obsidian tower, reaching up to the build limit
+    double fStructures = 0.02;
+  };
+
+  static int constexpr kSeaLevel = 62;
+  static int constexpr kMinY = -64;
+  static int constexpr kMaxY = 319;
+
+  // Noise values are in [0, kOne)
+  static int constexpr kFractionBits = 16;
+  static int64_t constexpr kOne = int64_t(1) << kFractionBits;
+
+  explicit WorldGenerator(Options options) : fOptions(options) {
+    fOptions.fRegions = (std::max)(fOptions.fRegions, 1);
+    fOptions.fOcean = std::clamp(fOptions.fOcean, 0.0, 1.0);
+    fOptions.fHeightVariance = std::clamp(fOptions.fHeightVariance, 0, kMaxY - kSeaLevel - 1);
+    fOptions.fSectionDensity = std::clamp(fOptions.fSectionDensity, 0.0, 1.0);
+    fOptions.fBiomes = std::clamp(fOptions.fBiomes, 1, (int)kLandBiomes.size());
+    fOptions.fChunkFill = std::clamp(fOptions.fChunkFill, 0.0, 1.0);
+    fOptions.fStructures = std::clamp(fOptions.fStructures, 0.0, 1.0);
+    fOceanLevel = (int64_t)std::llround(fOptions.fOcean * kOne);
+    fSectionDensity = Threshold(fOptions.fSectionDensity);
+    fChunkFill = Threshold(fOptions.fChunkFill);
+    fStructures = Threshold(fOptions.fStructures);
+  }
+
+  bool writeJava(juce::File directory, int numThreads) const {
+    juce::File regionDirectory = DimensionDirectory(directory, Dimension::Overworld);
+    if (regionDirectory.createDirectory().failed() || !writeJavaLevelDat(directory.getChildFile("level.dat"))) {
+      return false;
+    }
+    std::vector<Region> regions = this->regions();
+    std::atomic<bool> ok = true;
+    ParallelFor((int)regions.size(), numThreads, [&](int i) {
+      if (!writeJavaRegion(regionDirectory, regions[i])) {
+        ok = false;
+      }
+    });
+    return ok;
+  }
+
+  bool writeBedrock(juce::File directory, int numThreads) const {
+    juce::File dbDirectory = directory.getChildFile("db");
+    if (dbDirectory.createDirectory().failed() || !writeBedrockLevelDat(directory.getChildFile("level.dat"))) {
+      return false;
+    }
+    leveldb::Options options;
+    options.create_if_missing = true;
+    leveldb::DB *ptr = nullptr;
+    if (auto st = leveldb::DB::Open(options, PathFromFile(dbDirectory).string(), &ptr); !st.ok() || !ptr) {
+      return false;
+    }
+    std::unique_ptr<leveldb::DB> db(ptr);
+    std::vector<Region> regions = this->regions();
+    std::atomic<bool> ok = true;
+    ParallelFor((int)regions.size(), numThreads, [&](int i) {
+      if (!writeBedrockRegion(*db, regions[i])) {
+        ok = false;
+      }
+    });
+    return ok;
+  }
+
+  nlohmann::json toJSON() const {
+    nlohmann::json obj;
+    obj["seed"] = fOptions.fSeed;
+    obj["regions"] = fOptions.fRegions;
+    obj["ocean"] = fOptions.fOcean;
+    obj["height_variance"] = fOptions.fHeightVariance;
+    obj["section_density"] = fOptions.fSectionDensity;
+    obj["biomes"] = fOptions.fBiomes;
+    obj["chunk_fill"] = fOptions.fChunkFill;
+    obj["structures"] = fOptions.fStructures;
+    return obj;
+  }
+
+private:
+  enum class Kind : uint8_t {
+    air,
+    stone,
+    grass,
+    gravel,
+    water,
+    structure,
+  };
+
+  struct Biome {
+    mcfile::biomes::BiomeId fJava;
+    int32_t fBedrock;
+  };
+
+  struct Column {
+    int fHeight;
+    bool fOcean;
+    int fBiome;
+  };
+
+  // Ordered so that the first n are used for fBiomes = n
+  static inline std::array<Biome, 8> const kLandBiomes = {{
+      {mcfile::biomes::minecraft::plains, 1},
+      {mcfile::biomes::minecraft::forest, 4},
+      {mcfile::biomes::minecraft::desert, 2},
+      {mcfile::biomes::minecraft::taiga, 5},
+      {mcfile::biomes::minecraft::swamp, 6},
+      {mcfile::biomes::minecraft::jungle, 21},
+      {mcfile::biomes::minecraft::savanna, 35},
+      {mcfile::biomes::minecraft::badlands, 37},
+  }};
+
+  static inline std::array<Biome, 5> const kOceanBiomes = {{
+      {mcfile::biomes::minecraft::ocean, 0},
+      {mcfile::biomes::minecraft::warm_ocean, 40},
+      {mcfile::biomes::minecraft::lukewarm_ocean, 42},
+      {mcfile::biomes::minecraft::cold_ocean, 44},
+      {mcfile::biomes::minecraft::frozen_ocean, 46},
+  }};
+
+  std::vector<Region> regions() const {
+    std::vector<Region> regions;
+    int const min = -fOptions.fRegions / 2;
+    for (int rz = min; rz < min + fOptions.fRegions; rz++) {
+      for (int rx = min; rx < min + fOptions.fRegions; rx++) {
+        regions.push_back(MakeRegion(rx, rz));
+      }
+    }
+    return regions;
+  }
+
+  // splitmix64 of the seed, a salt and the coordinate
+  uint64_t hash(uint64_t salt, int x, int y, int z) const {
+    uint64_t h = fOptions.fSeed ^ (salt * 0x9e3779b97f4a7c15ULL);
+    for (uint64_t v : {(uint64_t)(uint32_t)x, (uint64_t)(uint32_t)y, (uint64_t)(uint32_t)z}) {
+      h += v + 0x9e3779b97f4a7c15ULL;
+      h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+      h ^= h >> 31;
+    }
+    return h;
+  }
+
+  // True with the probability of threshold, see Threshold
+  bool chance(uint64_t threshold, uint64_t salt, int x, int y, int z) const {
+    return (hash(salt, x, y, z) >> 32) < threshold;
+  }
+
+  // Value noise in [0, kOne) with a lattice of scale blocks, smoothed between lattice points
+  int64_t noise(uint64_t salt, int x, int z, int scale) const {
+    int const x0 = FloorDiv(x, scale);
+    int const z0 = FloorDiv(z, scale);
+    int64_t const fx = Smooth((x - x0 * scale) * kOne / scale);
+    int64_t const fz = Smooth((z - z0 * scale) * kOne / scale);
+    int64_t const v00 = (int64_t)(hash(salt, x0, 0, z0) >> (64 - kFractionBits));
+    int64_t const v10 = (int64_t)(hash(salt, x0 + 1, 0, z0) >> (64 - kFractionBits));
+    int64_t const v01 = (int64_t)(hash(salt, x0, 0, z0 + 1) >> (64 - kFractionBits));
+    int64_t const v11 = (int64_t)(hash(salt, x0 + 1, 0, z0 + 1) >> (64 - kFractionBits));
+    return Lerp(Lerp(v00, v10, fx), Lerp(v01, v11, fx), fz);
+  }
+
+  Column column(int x, int z) const {
+    int64_t const n = (noise(1, x, z, 256) * 3 + noise(2, x, z, 32)) / 4;
+    Column c;
+    c.fOcean = n < fOceanLevel;
+    if (c.fOcean) {
+      c.fHeight = kSeaLevel - 1 - (int)((fOceanLevel - n) * 40 / fOceanLevel);
+    } else {
+      c.fHeight = kSeaLevel + (int)((n - fOceanLevel) * fOptions.fHeightVariance / (std::max)(kOne - fOceanLevel, int64_t(1)));
+    }
+    int const count = c.fOcean ? (std::min)(fOptions.fBiomes, (int)kOceanBiomes.size()) : fOptions.fBiomes;
+    c.fBiome = (std::min)((int)((noise(3, x, z, 128) * count) >> kFractionBits), count - 1);
+    return c;
+  }
+
+  bool chunkExists(int cx, int cz) const {
+    return chance(fChunkFill, 4, cx, 0, cz);
+  }
+
+  // Top of the tower in the chunk, if any. Towers are 4x4 columns in the middle of the chunk
+  std::optional<int> tower(int cx, int cz) const {
+    if (!chance(fStructures, 5, cx, 0, cz)) {
+      return std::nullopt;
+    }
+    return kSeaLevel + 16 + (int)(hash(6, cx, 0, cz) % (uint64_t)(kMaxY - kSeaLevel - 16));
+  }
+
+  Kind kindAt(Column const &c, std::optional<int> tower, int x, int y, int z) const {
+    if (tower && y > c.fHeight && y <= *tower && 6 <= (x & 15) && (x & 15) < 10 && 6 <= (z & 15) && (z & 15) < 10) {
+      return Kind::structure;
+    }
+    if (y > c.fHeight) {
+      return y <= kSeaLevel ? Kind::water : Kind::air;
+    }
+    if (y == c.fHeight) {
+      return c.fOcean ? Kind::gravel : Kind::grass;
+    }
+    if (y <= kMinY || y >= c.fHeight - 3 || chance(fSectionDensity, 7, x, y, z)) {
+      return Kind::stone;
+    }
+    return Kind::air;
+  }
+
+  Biome biomeOf(Column const &c) const {
+    return c.fOcean ? kOceanBiomes[c.fBiome] : kLandBiomes[c.fBiome];
+  }
+
+  bool writeJavaRegion(juce::File directory, Region region) const {
+    using namespace mcfile::blocks::minecraft;
+    juce::File mca = directory.getChildFile(RegionFileName(region));
+    {
+      // An empty region file is a zeroed header
+      juce::FileOutputStream stream(mca);
+      if (!stream.openedOk() || !stream.setPosition(0) || !stream.truncate().wasOk() || !stream.writeRepeatedByte(0, 8192)) {
+        return false;
+      }
+    }
+    auto file = PathFromFile(mca);
+    auto editor = mcfile::je::McaEditor::Open(file);
+    if (!editor) {
+      return false;
+    }
+    int const dataVersion = mcfile::je::Chunk::kDataVersion;
+    std::map<Kind, std::shared_ptr<mcfile::je::Block const>> blocks = {
+        {Kind::stone, mcfile::je::Block::FromId(stone, dataVersion)},
+        {Kind::grass, mcfile::je::Block::FromId(grass_block, dataVersion)},
+        {Kind::gravel, mcfile::je::Block::FromId(gravel, dataVersion)},
+        {Kind::water, mcfile::je::Block::FromId(water, dataVersion)},
+        {Kind::structure, mcfile::je::Block::FromId(obsidian, dataVersion)},
+    };
+    for (int cz = region.second * 32; cz < region.second * 32 + 32; cz++) {
+      for (int cx = region.first * 32; cx < region.first * 32 + 32; cx++) {
+        if (!chunkExists(cx, cz)) {
+          continue;
+        }
+        auto chunk = mcfile::je::WritableChunk::MakeEmpty(cx, kMinY / 16, cz);
+        auto tower = this->tower(cx, cz);
+        for (int z = cz * 16; z < cz * 16 + 16; z++) {
+          for (int x = cx * 16; x < cx * 16 + 16; x++) {
+            Column const c = column(x, z);
+            int const top = (std::max)({c.fHeight, kSeaLevel, tower.value_or(kMinY)});
+            for (int y = kMinY; y <= top; y++) {
+              if (Kind kind = kindAt(c, tower, x, y, z); kind != Kind::air) {
+                chunk->setBlockAt(x, y, z, blocks[kind]);
+              }
+            }
+            for (int y = kMinY; y <= kMaxY; y += 4) {
+              chunk->setBiomeAt(x, y, z, biomeOf(c).fJava);
+            }
+          }
+        }
+        if (!editor->insert(cx - region.first * 32, cz - region.second * 32, *chunk->toCompoundTag(mcfile::Dimension::Overworld))) {
+          return false;
+        }
+      }
+    }
+    return editor->write(file);
+  }
+
+  bool writeBedrockRegion(leveldb::DB &db, Region region) const {
+    using mcfile::be::DbKey;
+    auto const dim = mcfile::Dimension::Overworld;
+    int const numSections = (kMaxY - kMinY + 1) / 16;
+    for (int cz = region.second * 32; cz < region.second * 32 + 32; cz++) {
+      for (int cx = region.first * 32; cx < region.first * 32 + 32; cx++) {
+        if (!chunkExists(cx, cz)) {
+          continue;
+        }
+        auto tower = this->tower(cx, cz);
+        std::vector<Column> columns;
+        for (int i = 0; i < 256; i++) {
+          columns.push_back(column(cx * 16 + i / 16, cz * 16 + i % 16));
+        }
+
+        leveldb::WriteBatch batch;
+        batch.Put(DbKey::Version(cx, cz, dim), std::string(1, (char)40));
+        std::string finalized;
+        PutInt32(finalized, 2);
+        batch.Put(DbKey::FinalizedState(cx, cz, dim), finalized);
+
+        // Height map, then a biome storage per section with an int palette, in XZY order like sub chunks
+        std::string data3d;
+        for (int i = 0; i < 256; i++) {
+          Column const &c = columns[(i % 16) * 16 + i / 16];
+          PutInt16(data3d, (int16_t)((std::max)({c.fHeight, kSeaLevel, tower.value_or(kMinY)}) + 1 - kMinY));
+        }
+        std::vector<int32_t> biomes(4096);
+        for (int i = 0; i < 4096; i++) {
+          biomes[i] = biomeOf(columns[i >> 4]).fBedrock;
+        }
+        std::string biomeStorage;
+        PutPalettedStorage(biomeStorage, biomes, true, [](std::string &out, int32_t id) {
+          PutInt32(out, id);
+        });
+        for (int section = 0; section < numSections; section++) {
+          data3d += biomeStorage;
+        }
+        batch.Put(DbKey::Data3D(cx, cz, dim), data3d);
+
+        for (int section = 0; section < numSections; section++) {
+          int const cy = kMinY / 16 + section;
+          std::vector<int32_t> kinds(4096);
+          bool empty = true;
+          for (int i = 0; i < 4096; i++) {
+            // XZY
+            int const lx = i >> 8;
+            int const lz = (i >> 4) & 15;
+            int const ly = i & 15;
+            Kind const kind = kindAt(columns[lx * 16 + lz], tower, cx * 16 + lx, cy * 16 + ly, cz * 16 + lz);
+            kinds[i] = (int32_t)kind;
+            empty &= kind == Kind::air;
+          }
+          if (empty) {
+            continue;
+          }
+          std::string subChunk;
+          subChunk.push_back((char)9);
+          subChunk.push_back((char)1);
+          subChunk.push_back((char)(int8_t)cy);
+          bool ok = true;
+          PutPalettedStorage(subChunk, kinds, false, [&ok](std::string &out, int32_t kind) {
+            if (auto nbt = mcfile::nbt::CompoundTag::Write(*BedrockBlock((Kind)kind), mcfile::Encoding::LittleEndian); nbt) {
+              out += *nbt;
+            } else {
+              ok = false;
+            }
+          });
+          if (!ok) {
+            return false;
+          }
+          batch.Put(DbKey::SubChunk(cx, cy, cz, dim), subChunk);
+        }
+        if (!db.Write(leveldb::WriteOptions(), &batch).ok()) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Palette entry of a block of Bedrock 1.21
+  static std::shared_ptr<mcfile::nbt::CompoundTag> BedrockBlock(Kind kind) {
+    using namespace mcfile::nbt;
+    auto states = std::make_shared<CompoundTag>();
+    std::u8string name;
+    switch (kind) {
+    case Kind::stone:
+      name = u8"minecraft:stone";
+      break;
+    case Kind::grass:
+      name = u8"minecraft:grass_block";
+      break;
+    case Kind::gravel:
+      name = u8"minecraft:gravel";
+      break;
+    case Kind::water:
+      name = u8"minecraft:water";
+      states->set(u8"liquid_depth", std::make_shared<IntTag>(0));
+      break;
+    case Kind::structure:
+      name = u8"minecraft:obsidian";
+      break;
+    case Kind::air:
+    default:
+      name = u8"minecraft:air";
+      break;
+    }
+    auto tag = std::make_shared<CompoundTag>();
+    tag->set(u8"name", std::make_shared<StringTag>(name));
+    tag->set(u8"states", states);
+    tag->set(u8"version", std::make_shared<IntTag>(kBedrockBlockVersion));
+    return tag;
+  }
+
+  // 1.21.0.3
+  static int32_t constexpr kBedrockBlockVersion = (1 << 24) | (21 << 16) | (0 << 8) | 3;
+
+  // Paletted storage of 4096 values: a header of the bits per value and the runtime flag, the packed indices, then the palette
+  static void PutPalettedStorage(std::string &out, std::vector<int32_t> const &values, bool runtime, std::function<void(std::string &, int32_t)> putEntry) {
+    std::vector<int32_t> palette;
+    std::vector<uint16_t> indices(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+      auto found = std::find(palette.begin(), palette.end(), values[i]);
+      if (found == palette.end()) {
+        palette.push_back(values[i]);
+        found = palette.end() - 1;
+      }
+      indices[i] = (uint16_t)(found - palette.begin());
+    }
+    int bits = 1;
+    for (int b : {1, 2, 3, 4, 5, 6, 8, 16}) {
+      bits = b;
+      if ((1 << b) >= (int)palette.size()) {
+        break;
+      }
+    }
+    out.push_back((char)((bits << 1) | (runtime ? 1 : 0)));
+    int const perWord = 32 / bits;
+    int const words = (4096 + perWord - 1) / perWord;
+    for (int w = 0; w < words; w++) {
+      uint32_t word = 0;
+      for (int k = 0; k < perWord; k++) {
+        int const i = w * perWord + k;
+        if (i < 4096) {
+          word |= (uint32_t)indices[i] << (k * bits);
+        }
+      }
+      PutInt32(out, (int32_t)word);
+    }
+    PutInt32(out, (int32_t)palette.size());
+    for (int32_t entry : palette) {
+      putEntry(out, entry);
+    }
+  }
+
+  bool writeJavaLevelDat(juce::File file) const {
+    using namespace mcfile::nbt;
+    auto data = std::make_shared<CompoundTag>();
+    data->set(u8"LevelName", std::make_shared<StringTag>(levelName()));
+    data->set(u8"DataVersion", std::make_shared<IntTag>(mcfile::je::Chunk::kDataVersion));
+    data->set(u8"version", std::make_shared<IntTag>(19133));
+    data->set(u8"LastPlayed", std::make_shared<LongTag>(0));
+    auto root = std::make_shared<CompoundTag>();
+    root->set(u8"Data", data);
+    auto nbt = CompoundTag::Write(*root, mcfile::Encoding::Java);
+    if (!nbt) {
+      return false;
+    }
+    juce::FileOutputStream stream(file);
+    if (!stream.openedOk() || !stream.setPosition(0) || !stream.truncate().wasOk()) {
+      return false;
+    }
+    juce::GZIPCompressorOutputStream gzip(stream, 9, juce::GZIPCompressorOutputStream::windowBitsGZIP);
+    return gzip.write(nbt->data(), nbt->size());
+  }
+
+  bool writeBedrockLevelDat(juce::File file) const {
+    using namespace mcfile::nbt;
+    auto root = std::make_shared<CompoundTag>();
+    root->set(u8"LevelName", std::make_shared<StringTag>(levelName()));
+    root->set(u8"StorageVersion", std::make_shared<IntTag>(10));
+    root->set(u8"LastPlayed", std::make_shared<LongTag>(0));
+    auto nbt = CompoundTag::Write(*root, mcfile::Encoding::LittleEndian);
+    if (!nbt) {
+      return false;
+    }
+    std::string dat;
+    PutInt32(dat, 10);
+    PutInt32(dat, (int32_t)nbt->size());
+    dat += *nbt;
+    return file.replaceWithData(dat.data(), dat.size());
+  }
+
+  std::u8string levelName() const {
+    auto name = juce::String("mcview-generate ") + juce::String((juce::int64)fOptions.fSeed);
+    return std::u8string((char8_t const *)name.toRawUTF8());
+  }
+
+  static void PutInt16(std::string &out, int16_t v) {
+    out.push_back((char)(v & 0xff));
+    out.push_back((char)((v >> 8) & 0xff));
+  }
+
+  static void PutInt32(std::string &out, int32_t v) {
+    for (int i = 0; i < 4; i++) {
+      out.push_back((char)((v >> (8 * i)) & 0xff));
+    }
+  }
+
+  // 3t^2 - 2t^3 of t in [0, kOne]
+  static int64_t Smooth(int64_t t) {
+    return (t * t * (3 * kOne - 2 * t)) >> (2 * kFractionBits);
+  }
+
+  // a + (b - a) * t of t in [0, kOne]. Right shifts of negative values round down, as floor does
+  static int64_t Lerp(int64_t a, int64_t b, int64_t t) {
+    return a + (((b - a) * t) >> kFractionBits);
+  }
+
+  static int FloorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+  }
+
+  // Fraction of 2^32 for chance, so that a fraction of 1 is always true and 0 never
+  static uint64_t Threshold(double fraction) {
+    return (uint64_t)std::llround(fraction * 4294967296.0);
+  }
+
+private:
+  Options fOptions;
+  // fOptions in fixed point. Noise below fOceanLevel is ocean
+  int64_t fOceanLevel;
+  uint64_t fSectionDensity;
+  uint64_t fChunkFill;
+  uint64_t fStructures;
+};
+
+} // namespace mcview
+
+int main(int argc, char *argv[]) {
+  juce::ArgumentList args(argc, argv);
+  mcview::WorldGenerator::Options options;
+  bool bedrock = false;
+  if (args.containsOption("--edition")) {
+    juce::String const edition = args.removeValueForOption("--edition");
+    if (edition != "java" && edition != "bedrock") {
+      std::cerr << "Error: --edition must be java or bedrock" << std::endl;
+      return 1;
+    }
+    bedrock = edition == "bedrock";
+  }
+  auto option = [&args](char const *name, auto &value) {
+    if (!args.containsOption(name)) {
+      return;
+    }
+    juce::String const v = args.removeValueForOption(name);
+    if constexpr (std::is_floating_point_v<std::remove_reference_t<decltype(value)>>) {
+      value = v.getDoubleValue();
+    } else {
+      value = (std::remove_reference_t<decltype(value)>)v.getLargeIntValue();
+    }
+  };
+  option("--seed", options.fSeed);
+  option("--regions", options.fRegions);
+  option("--ocean", options.fOcean);
+  option("--height-variance", options.fHeightVariance);
+  option("--section-density", options.fSectionDensity);
+  option("--biomes", options.fBiomes);
+  option("--chunk-fill", options.fChunkFill);
+  option("--structures", options.fStructures);
+  if (args.size() != 1) {
+    std::cerr << "Usage: " << args.executableName << " [options] <output directory>" << std::endl;
+    std::cerr << "  --edition          java or bedrock. Default java" << std::endl;
+    std::cerr << "  --seed             Seed of the world. The same options always give the same world. Default 1" << std::endl;
+    std::cerr << "  --regions          Regions on a side of the square world. Default 2" << std::endl;
+    std::cerr << "  --ocean            Approximate fraction of columns below sea level. Default 0.3" << std::endl;
+    std::cerr << "  --height-variance  Blocks the land rises above sea level at most. Default 32" << std::endl;
+    std::cerr << "  --section-density  Fraction of underground blocks that are stone rather than caves. Default 1" << std::endl;
+    std::cerr << "  --biomes           Distinct biomes, 1 to 8. Default 4" << std::endl;
+    std::cerr << "  --chunk-fill       Fraction of chunks that exist, for sparse regions. Default 1" << std::endl;
+    std::cerr << "  --structures       Chance of a chunk having a tower reaching up to the build limit. Default 0.02" << std::endl;
+    return 1;
+  }
+  juce::File output = args[0].resolveAsFile();
+  if (output.exists() && (!output.isDirectory() || output.getNumberOfChildFiles(juce::File::findFilesAndDirectories) > 0)) {
+    std::cerr << "Error: " << output.getFullPathName() << " is not an empty directory" << std::endl;
+    return 1;
+  }
+  if (output.createDirectory().failed()) {
+    std::cerr << "Error: cannot create " << output.getFullPathName() << std::endl;
+    return 1;
+  }
+
+  mcview::WorldGenerator generator(options);
+  double const start = juce::Time::getMillisecondCounterHiRes();
+  int const numThreads = juce::SystemStats::getNumCpus();
+  bool const ok = bedrock ? generator.writeBedrock(output, numThreads) : generator.writeJava(output, numThreads);
+  if (!ok) {
+    std::cerr << "Error: cannot write " << output.getFullPathName() << std::endl;
+    return 1;
+  }
+  auto json = generator.toJSON();
+  json["edition"] = bedrock ? "bedrock" : "java";
+  output.getChildFile("mcview-generate.json").replaceWithText(juce::String(json.dump(2)));
+  double const elapsed = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+  std::cout << "Wrote " << output.getFullPathName() << " in " << juce::String(elapsed, 1) << "s" << std::endl;
+  return 0;
+}
@@ -9,8 +9,9 @@ public:
                      Region region,
                      Dimension dim,
                      bool useCache,
+                     TileCacheWriter *cacheWriter,
                      Delegate *delegate)
-      : TexturePackJob(mcaFile.getFileName(), region, delegate),
+      : TexturePackJob(mcaFile.getFileName(), region, cacheWriter, delegate),
         fWorldDirectory(worldDirectory),
         fDimension(dim),
         fRegionFile(mcaFile),
@@ -18,15 +19,28 @@ public:
   }
 
   ThreadPoolJob::JobStatus runJob() override {
+    Trace::Span span("TexturePackJob::runJob", fRegion);
     auto result = std::make_shared<Result>(fWorldDirectory, fDimension, fRegion);
+    int64_t modified = fRegionFile.getLastModificationTime().toMilliseconds();
+    std::optional<uint64_t> fingerprint;
+    bool store = false;
     defer {
+      result->buildLods();
       fDelegate->texturePackJobDidFinish(result);
+      if (store && fingerprint) {
+        fCacheWriter->enqueue(result->fPixels, modified, CacheFile(*fingerprint));
+      }
+      if (fingerprint && result->fPixels) {
+        storeCacheIndex(fWorldDirectory, fDimension, *fingerprint);
+      }
     };
     try {
-      int64_t modified = fRegionFile.getLastModificationTime().toMilliseconds();
-      juce::File cache = CacheFile(fWorldDirectory, fDimension, fRegion);
-      if (fUseCache && cache.existsAsFile()) {
-        if (LoadCache(result->fPixels, modified, cache)) {
+      {
+        Trace::Span fp("TexturePackJob::ContentFingerprint", fRegion);
+        fingerprint = ContentFingerprint(fRegionFile, fDimension, fRegion);
+      }
+      if (fUseCache && fingerprint) {
+        if (loadCache(result->fPixels, std::nullopt, CacheFile(*fingerprint))) {
           return ThreadPoolJob::jobHasFinished;
         }
       }
@@ -35,17 +49,18 @@ public:
       if (!std::filesystem::exists(mca)) {
         return ThreadPoolJob::jobHasFinished;
       }
-      auto region = mcfile::je::Region::MakeRegion(mca);
+      auto region = [&]() {
+        Trace::Span open("TexturePackJob::openRegion", fRegion);
+        return mcfile::je::Region::MakeRegion(mca);
+      }();
       if (!region) {
         return ThreadPoolJob::jobHasFinished;
       }
-      result->fPixels.reset(RegionToTexture::LoadJava(*region, fDimension, *this));
+      result->fPixels.reset(RegionToTexture::LoadJava(*region, fDimension, *this, provisionalDelivery(fWorldDirectory, fDimension)));
       if (shouldExit()) {
         return ThreadPoolJob::jobHasFinished;
       }
-      if (result->fPixels) {
-        StoreCache(result->fPixels.get(), modified, cache);
-      }
+      store = result->fPixels != nullptr;
       return ThreadPoolJob::jobHasFinished;
     } catch (std::exception &e) {
       juce::Logger::writeToLog(e.what());
@@ -58,6 +73,26 @@ public:
     }
   }
 
+  static std::optional<uint64_t> ContentFingerprint(juce::File const &mcaFile, Dimension dim, Region region) {
+    // Chunk locations and timestamps
+    int constexpr kHeaderSize = 8192;
+    juce::FileInputStream stream(mcaFile);
+    if (!stream.openedOk()) {
+      return std::nullopt;
+    }
+    std::vector<uint8_t> header(kHeaderSize);
+    if (stream.read(header.data(), kHeaderSize) != kHeaderSize) {
+      return std::nullopt;
+    }
+    Fingerprint fp;
+    fp.update(std::string("java"));
+    fp.update(dim);
+    fp.update(region);
+    fp.update(stream.getTotalLength());
+    fp.update(header.data(), header.size());
+    return fp.value();
+  }
+
 private:
   juce::File const fWorldDirectory;
   Dimension const fDimension;
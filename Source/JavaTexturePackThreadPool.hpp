@@ -4,8 +4,8 @@ namespace mcview {
 
 class JavaTexturePackThreadPool : public TexturePackThreadPool {
 public:
-  JavaTexturePackThreadPool(juce::File directory, Dimension dim, Delegate *delegate)
-      : TexturePackThreadPool(delegate),
+  JavaTexturePackThreadPool(juce::File directory, Dimension dim, std::shared_ptr<TileCacheWriter> cacheWriter, Delegate *delegate)
+      : TexturePackThreadPool(cacheWriter, delegate),
         fWorldDirectory(directory),
         fDimension(dim) {
   }
@@ -15,7 +15,7 @@ public:
   void addTexturePackJob(Region region, bool useCache) override {
     juce::File dir = DimensionDirectory(fWorldDirectory, fDimension);
     juce::File mca = dir.getChildFile(mcfile::je::Region::GetDefaultRegionFileName(region.first, region.second));
-    addJob(new JavaTexturePackJob(fWorldDirectory, mca, region, fDimension, useCache, this), true);
+    addJob(new JavaTexturePackJob(fWorldDirectory, mca, region, fDimension, useCache, fCacheWriter.get(), this), true);
   }
 
 private:
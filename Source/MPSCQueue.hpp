@@ -0,0 +1,59 @@
+#pragma once
+
+namespace mcview {
+
+// Unbounded queue that any number of threads push to without locking, drained by a single consumer at a time.
+// Producers prepend to a singly linked list with compare-and-swap. The consumer detaches the whole list with one exchange, so there is no ABA problem.
+template <class T>
+class MPSCQueue {
+public:
+  MPSCQueue() : fHead(nullptr) {}
+
+  ~MPSCQueue() {
+    clear();
+  }
+
+  void push(T value) {
+    Node *node = new Node{std::move(value), fHead.load(std::memory_order_relaxed)};
+    while (!fHead.compare_exchange_weak(node->fNext, node, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+  }
+
+  bool empty() const {
+    return fHead.load(std::memory_order_acquire) == nullptr;
+  }
+
+  // Calls fn with each value, in the order they were pushed.
+  template <class Fn>
+  void drain(Fn &&fn) {
+    Node *node = fHead.exchange(nullptr, std::memory_order_acquire);
+    Node *reversed = nullptr;
+    while (node) {
+      Node *next = node->fNext;
+      node->fNext = reversed;
+      reversed = node;
+      node = next;
+    }
+    while (reversed) {
+      std::unique_ptr<Node> current(reversed);
+      reversed = reversed->fNext;
+      fn(std::move(current->fValue));
+    }
+  }
+
+  void clear() {
+    drain([](T &&) {});
+  }
+
+private:
+  struct Node {
+    T fValue;
+    Node *fNext;
+  };
+
+  std::atomic<Node *> fHead;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MPSCQueue)
+};
+
+} // namespace mcview
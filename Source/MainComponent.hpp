@@ -29,6 +29,9 @@ public:
     fMapViewComponent->setPaletteType(fSettings->fPaletteType);
     fMapViewComponent->setLightingType(fSettings->fLightingType);
     fMapViewComponent->setShowPin(fSettings->fShowPin);
+    fMapViewComponent->setTextureMemoryBudget(fSettings->fTextureMemoryBudgetMB);
+    fMapViewComponent->setPrecomputeShading(fSettings->fPrecomputeShading);
+    fMapViewComponent->setModernRenderer(fSettings->fModernRenderer);
 
     addAndMakeVisible(fMapViewComponent.get());
 
@@ -80,6 +83,14 @@ public:
       fMapViewComponent->setShowPin(show);
       fSettings->fShowPin = show;
     };
+    fSettingsComponent->onPrecomputeShadingChanged = [this](bool precompute) {
+      fMapViewComponent->setPrecomputeShading(precompute);
+      fSettings->fPrecomputeShading = precompute;
+    };
+    fSettingsComponent->onModernRendererChanged = [this](bool modern) {
+      fMapViewComponent->setModernRenderer(modern);
+      fSettings->fModernRenderer = modern;
+    };
     fSettingsComponent->onPaletteChanged = [this](PaletteType palette) {
       fMapViewComponent->setPaletteType(palette);
       fSettings->fPaletteType = palette;
@@ -189,6 +200,11 @@ public:
     fDelegate->mainComponentDidClose();
   }
 
+  void mainViewComponentModernRendererDisabled() override {
+    fSettings->fModernRenderer = false;
+    fSettingsComponent->setModernRenderer(false);
+  }
+
   bool isInterestedInFileDrag(juce::StringArray const &files) override {
     for (auto const &file : files) {
       if (GameDirectory::HasInterest(juce::File(file))) {
@@ -0,0 +1,128 @@
+#pragma once
+
+namespace mcview {
+
+// Offscreen copy of the composed map, so that a frame where nothing on the map changed is a single blit.
+// Tiles are redrawn only when invalidated, by an upload, a fade step, or a change of the view or the settings. Must be used from the GL thread.
+class MapComposite {
+public:
+  // Everything that affects every pixel of the map at once
+  struct Key {
+    LookAt fLookAt;
+    int fWidth = 0;
+    int fHeight = 0;
+    int fOverviewLevel = 0;
+    bool fTextureArrays = false;
+    Dimension fDimension = Dimension::Overworld;
+    PaletteType fPalette = PaletteType::mcview;
+    LightingType fLighting = LightingType::topLeft;
+    float fWaterOpticalDensity = 0;
+    bool fWaterTranslucent = false;
+    bool fEnableBiome = false;
+    int fBiomeBlend = 0;
+
+    bool operator==(Key const &o) const {
+      return fLookAt.fX == o.fLookAt.fX && fLookAt.fZ == o.fLookAt.fZ && fLookAt.fBlocksPerPixel == o.fLookAt.fBlocksPerPixel &&
+             fWidth == o.fWidth && fHeight == o.fHeight && fOverviewLevel == o.fOverviewLevel && fTextureArrays == o.fTextureArrays &&
+             fDimension == o.fDimension && fPalette == o.fPalette && fLighting == o.fLighting &&
+             fWaterOpticalDensity == o.fWaterOpticalDensity && fWaterTranslucent == o.fWaterTranslucent && fEnableBiome == o.fEnableBiome && fBiomeBlend == o.fBiomeBlend;
+    }
+
+    bool operator!=(Key const &o) const {
+      return !(*this == o);
+    }
+  };
+
+  MapComposite() : fFull(true), fDrawingFull(false) {}
+
+  // Returns false if the framebuffer is not available. The map should then be drawn directly.
+  bool prepare(juce::OpenGLContext &context, Key const &key) {
+    if (!fFrameBuffer || fFrameBuffer->getWidth() != key.fWidth || fFrameBuffer->getHeight() != key.fHeight) {
+      fFrameBuffer = std::make_unique<juce::OpenGLFrameBuffer>();
+      if (!fFrameBuffer->initialise(context, key.fWidth, key.fHeight)) {
+        fFrameBuffer.reset();
+        return false;
+      }
+      juce::gl::glBindTexture(juce::gl::GL_TEXTURE_2D, fFrameBuffer->getTextureID());
+      TextureUploader::SetNearestFilter();
+      fFull = true;
+    }
+    if (key != fKey) {
+      fKey = key;
+      fFull = true;
+    }
+    return true;
+  }
+
+  bool hasWork() const {
+    return fFull || !fDirty.empty();
+  }
+
+  // Starts redrawing into the framebuffer. Invalidations from here on apply to the next frame.
+  void beginRedraw() {
+    using namespace juce::gl;
+    fDrawingFull = fFull;
+    fDrawing.clear();
+    fDrawing.swap(fDirty);
+    fFull = false;
+    fFrameBuffer->makeCurrentRenderingTarget();
+    if (fDrawingFull) {
+      juce::OpenGLHelpers::clear(juce::Colours::transparentBlack);
+    }
+    // Tiles don't overlap, so each covered pixel is simply replaced
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+  }
+
+  void endRedraw() {
+    fFrameBuffer->releaseAsRenderingTarget();
+    fDrawing.clear();
+    fDrawingFull = false;
+  }
+
+  // Whether the tile of the region has to be drawn in the current redraw
+  bool isDirty(Region region) const {
+    return fDrawingFull || fDrawing.count(region) > 0;
+  }
+
+  void invalidate() {
+    fFull = true;
+  }
+
+  // The region and its neighbours, which sample its edges
+  void invalidate(Region region) {
+    for (int dx = -1; dx <= 1; dx++) {
+      for (int dz = -1; dz <= 1; dz++) {
+        fDirty.insert(MakeRegion(region.first + dx, region.second + dz));
+      }
+    }
+  }
+
+  // Only the region itself, eg. while it is fading in
+  void invalidateTile(Region region) {
+    fDirty.insert(region);
+  }
+
+  GLuint textureID() const {
+    return fFrameBuffer ? fFrameBuffer->getTextureID() : 0;
+  }
+
+  void release() {
+    fFrameBuffer.reset();
+    fDirty.clear();
+    fDrawing.clear();
+    fFull = true;
+  }
+
+private:
+  std::unique_ptr<juce::OpenGLFrameBuffer> fFrameBuffer;
+  Key fKey;
+  bool fFull;
+  bool fDrawingFull;
+  std::set<Region> fDirty;
+  std::set<Region> fDrawing;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MapComposite)
+};
+
+} // namespace mcview
@@ -11,14 +11,11 @@ class MapViewComponent
       public TexturePackThreadPool::Delegate,
       public SavePNGProgressWindow::Delegate,
       public TextInputDialog<PinEdit>::Delegate,
+      public ExportDialog::Delegate,
+      public ExportJob::Delegate,
       public JavaWorldScanThread::Delegate,
       public BedrockWorldScanThread::Delegate {
 
-  struct AsyncUpdateQueueReleaseGarbageThreadPool {
-    bool operator==(AsyncUpdateQueueReleaseGarbageThreadPool const &) const {
-      return true;
-    }
-  };
   struct AsyncUpdateQueueTriggerRepaint {
     bool operator==(AsyncUpdateQueueTriggerRepaint const &) const {
       return true;
@@ -36,19 +33,53 @@ class MapViewComponent
     }
   };
 
+  struct AsyncUpdateQueueStartCapture {
+    bool operator==(AsyncUpdateQueueStartCapture const &) const {
+      return true;
+    }
+  };
+
+  struct AsyncUpdateQueueRenderPathsDiffer {
+    int fPixels;
+    bool operator==(AsyncUpdateQueueRenderPathsDiffer const &other) const {
+      return fPixels == other.fPixels;
+    }
+  };
+
+  struct AsyncUpdateQueueExportJobFinished {
+    bool fCompleted;
+    bool operator==(AsyncUpdateQueueExportJobFinished const &other) const {
+      return fCompleted == other.fCompleted;
+    }
+  };
+
+  // A region found in the world, or a change of the world when fRegion is empty
+  struct RegionUpdate {
+    juce::File fWorldDirectory;
+    Dimension fDimension;
+    std::optional<Region> fRegion;
+  };
+
   using AsyncUpdateQueue = std::variant<
-      AsyncUpdateQueueReleaseGarbageThreadPool,
       AsyncUpdateQueueTriggerRepaint,
       AsyncUpdateQueueUpdateCaptureButtonStatus,
-      AsyncUpdateQueueShowShaderCompileErrorMessage>;
+      AsyncUpdateQueueShowShaderCompileErrorMessage,
+      AsyncUpdateQueueStartCapture,
+      AsyncUpdateQueueExportJobFinished,
+      AsyncUpdateQueueRenderPathsDiffer>;
 
-  static float constexpr kMaxScale = 10;
+  static float constexpr kMaxScale = 1024;
   static float constexpr kMinScale = 1.0f / 32.0f;
   static int constexpr kCheckeredPatternSize = 16;
 
   static int constexpr kMargin = 10;
   static int constexpr kButtonSize = 40;
   static int constexpr kFadeDurationMS = 300;
+  // Beyond this, overview tiles are shown instead of regions. An overview tile of level n has the same detail as a region texture of lod n.
+  static int constexpr kMinOverviewLevel = RegionToTexture::kMaxLod;
+  // Milliseconds per frame spent uploading textures
+  static double constexpr kUploadBudgetMS = 4.0;
+  static int constexpr kMaxOverviewLevel = 12;
   static int constexpr kScrollUpdateHz = 50;
 
 public:
@@ -57,6 +88,7 @@ public:
     virtual void mainViewComponentOpenButtonClicked() = 0;
     virtual void mainViewComponentSettingsButtonClicked() = 0;
     virtual void mainViewComponentClosed() = 0;
+    virtual void mainViewComponentModernRendererDisabled() = 0;
   };
 
   static int constexpr kMinimumWidth = 250;
@@ -68,11 +100,15 @@ public:
         fWaterTranslucent(true),
         fEnableBiome(true),
         fBiomeBlend(2),
+        fPrecomputeShading(true),
+        fModernRenderer(false),
+        fCompareRenderPaths(false),
         fPaletteType(PaletteType::mcview),
         fLightingType(LightingType::topLeft),
         fClosing(false),
         fDelegate(delegate),
-        fCapturingToImage(false) {
+        fCapturingToImage(false),
+        fExporting(false) {
     using namespace juce;
 
     if (auto *peer = getPeer(); peer) {
@@ -144,6 +180,9 @@ public:
     };
     addAndMakeVisible(*fSettingsButton);
 
+    fCacheWriter = std::make_shared<TileCacheWriter>(TexturePackJob::StoreCache);
+    fCacheWriter->start();
+
     setOpaque(true);
     fGLContext.setRenderer(this);
     fGLContext.attachTo(*this);
@@ -193,6 +232,8 @@ public:
     jassert(!fWorldScanThread);
     jassert(!fPool);
     jassert(fPoolTrashBin.empty());
+    jassert(!fCacheWriter);
+    jassert(!fExportJob);
     fGLContext.detach();
   }
 
@@ -209,6 +250,9 @@ public:
     if (fWorldScanThread) {
       fWorldScanThread->signalThreadShouldExit();
     }
+    if (fExportJob) {
+      fExportJob->signalThreadShouldExit();
+    }
     if (fPool) {
       fPool->abandon(0);
     }
@@ -269,6 +313,10 @@ public:
           }
         }
       }
+      if (float const ms = fGLTimer.milliseconds(); ms >= 0) {
+        g.setFont(juce::FontOptions(14));
+        g.drawText(String::formatted("GPU: %.2f ms", ms), kMargin, height - kMargin - lineHeight, 200, lineHeight, Justification::centredLeft);
+      }
     }
 
     juce::Rectangle<float> const border(width - kMargin - kButtonSize - kMargin - coordLabelWidth, kMargin, coordLabelWidth, coordLabelHeight);
@@ -294,6 +342,17 @@ public:
     g.drawFittedText(String::formatted("%d", (int)floor(block.y)), line2, Justification::centredRight, 1);
     y += lineHeight;
 
+    if (fExporting.get()) {
+      juce::Rectangle<float> const box(width - kMargin - kButtonSize - kMargin - 2 * coordLabelWidth, border.getBottom() + kMargin, 2 * coordLabelWidth, lineHeight);
+      g.setColour(Colour::fromFloatRGBA(1, 1, 1, 0.8));
+      g.fillRoundedRectangle(box, 6.0f);
+      g.setColour(Colours::lightgrey);
+      g.drawRoundedRectangle(box, 6.0f, 1.0f);
+      g.setColour(Colours::black);
+      g.setFont(regular);
+      g.drawFittedText(TRANS("Exporting image") + String::formatted(": %d%%", (int)floor(fExportProgress.load() * 100)), box.reduced(kMargin, 0).toNearestInt(), Justification::centredLeft, 1);
+    }
+
     paintOverlayMessages(g);
   }
 
@@ -342,7 +401,10 @@ public:
     std::vector<uint32_t> indices = {0, 1, 2, 3};
     fGLContext.extensions.glBufferData(gl::GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * indices.size(), indices.data(), gl::GL_STATIC_DRAW);
 
+    fGLContext.extensions.glGenBuffers(1, &buffer->instanceBuffer);
+
     fGLBuffer.reset(buffer.release());
+    fGLVertexArraysSupported = GLVertexArray::IsSupported();
   }
 
   void renderOpenGL() override {
@@ -360,14 +422,32 @@ public:
 
   void openGLContextClosing() override {
     fTextures.clear();
+    fResidentResults.clear();
+    fOverviewTextures.clear();
+    fLoadingOverviewTiles.clear();
+    fResidency.clear();
     fGLPalette.reset();
     fGLPaletteJava.reset();
     fGLPaletteBedrock.reset();
     if (fGLBuffer) {
       fGLContext.extensions.glDeleteBuffers(1, &fGLBuffer->vBuffer);
       fGLContext.extensions.glDeleteBuffers(1, &fGLBuffer->iBuffer);
+      fGLContext.extensions.glDeleteBuffers(1, &fGLBuffer->instanceBuffer);
       fGLBuffer.reset();
     }
+    fGLArrayShader.reset();
+    fGLArrayUniforms.reset();
+    fGLArrayAttributes.reset();
+    fComposite.release();
+    fGLCompositeShader.reset();
+    fGLCompositeUniforms.reset();
+    fGLCompositeAttributes.reset();
+    fGLTimer.release();
+    fUploader.release();
+    fGLTileVertexArray.release();
+    fGLArrayVertexArray.release();
+    fGLCompositeVertexArray.release();
+    fGLState.reset();
   }
 
   void savePNGProgressWindowRender(int const width, int const height, LookAt const lookAt) override {
@@ -376,7 +456,16 @@ public:
 
   void savePNGProgressWindowDidFinishRendering() override {
     fCapturingToImage = false;
-    unsafeEnqueueAsyncUpdate(AsyncUpdateQueueUpdateCaptureButtonStatus{});
+    enqueueAsyncUpdate(AsyncUpdateQueueUpdateCaptureButtonStatus{});
+  }
+
+  void exportJobDidProgress(ExportJob *job, double progress) override {
+    fExportProgress = progress;
+    enqueueAsyncUpdate(AsyncUpdateQueueTriggerRepaint{});
+  }
+
+  void exportJobDidFinish(ExportJob *job, bool completed) override {
+    enqueueAsyncUpdate(AsyncUpdateQueueExportJobFinished{completed});
   }
 
   void mouseMagnify(juce::MouseEvent const &event, float scaleFactor) override {
@@ -492,14 +581,17 @@ public:
     }
   }
 
+  // Called from worker threads. Results are handed to the GL thread without locking, so that a worker never waits for a frame to finish.
   void texturePackThreadPoolDidFinishJob(TexturePackThreadPool *pool, std::shared_ptr<TexturePackJob::Result> result) override {
-    std::lock_guard<std::mutex> lock(fMut);
-    if (pool != fPool.get()) {
-      return;
-    }
-    fGLJobResults.push_back(result);
-    unsafeEnqueueAsyncUpdate(AsyncUpdateQueueReleaseGarbageThreadPool{});
-    unsafeEnqueueAsyncUpdate(AsyncUpdateQueueTriggerRepaint{});
+    fFinishedJobs.push(std::make_pair(pool->fGeneration, result));
+    fJobsFinished = true;
+    triggerAsyncUpdate();
+  }
+
+  void texturePackThreadPoolDidFinishOverviewJob(TexturePackThreadPool *pool, std::shared_ptr<OverviewJob::Result> result) override {
+    fFinishedOverviewJobs.push(std::make_pair(pool->fGeneration, result));
+    fJobsFinished = true;
+    triggerAsyncUpdate();
   }
 
   void unsafeEnqueueAsyncUpdate(AsyncUpdateQueue q) {
@@ -544,43 +636,33 @@ public:
     }
     if (edition == Edition::Bedrock) {
       if (!db || !dbAttachment) {
-        juce::String workDirName = juce::String("proxy-") + juce::Uuid().toDashedString();
-        juce::File work = WorkingDirectory().getChildFile(workDirName);
-        if (work.deleteRecursively() && work.createDirectory()) {
-          auto path = PathFromFile(directory);
-          leveldb::DB *ptr = nullptr;
-          std::unique_ptr<je2be::ReadonlyDb::Closer> closer;
-          if (auto st = je2be::ReadonlyDb::Open(path / "db", &ptr, PathFromFile(work), closer); st.ok() && closer && ptr) {
-            dbAttachment.reset(closer.release());
-            db.reset(ptr);
-          }
-          lastPlayed = ReadLastPlayedTimestamp(path / "level.dat");
+        if (BedrockTexturePackThreadPool::OpenDb(directory, db, dbAttachment)) {
+          lastPlayed = BedrockTexturePackThreadPool::ReadLastPlayedTimestamp(PathFromFile(directory) / "level.dat");
         }
       }
-      fPool.reset(new BedrockTexturePackThreadPool(directory, dim, lastPlayed, db, dbAttachment, this));
+      fPool.reset(new BedrockTexturePackThreadPool(directory, dim, lastPlayed, db, dbAttachment, fCacheWriter, this));
     } else {
-      fPool.reset(new JavaTexturePackThreadPool(directory, dim, this));
+      fPool.reset(new JavaTexturePackThreadPool(directory, dim, fCacheWriter, this));
     }
+    fPool->setShadeBiomeBlend(shadeBiomeBlend());
 
     if (fWorldScanThread) {
       fWorldScanThread->stopThread(-1);
       fWorldScanThread.reset();
     }
 
-    auto garbageTextures = std::make_shared<std::map<Region, std::unique_ptr<RegionTextureCache>>>();
-    garbageTextures->swap(fTextures);
-
     LookAt const lookAt = fLookAt.load();
     juce::Point<int> size = fSize.load();
 
     fLoadingRegions.clear();
+    fReloadingRegions.clear();
+    fLoadingOverviewTiles.clear();
     fWorldDirectory = directory;
     fDimension = dim;
     fWorldData = data;
     fEdition = edition;
-    for (auto &it : *garbageTextures) {
-      fTextureTrashBin.push_back(std::move(it.second));
-    }
+    // The GL thread drops the textures of the previous world
+    fRegionUpdates.push({directory, dim, std::nullopt});
     fVisibleRegions = VisibleRegions();
     resetPinComponents();
 
@@ -624,7 +706,7 @@ public:
           return distanceA < distanceB;
         });
         for (Region region : regions) {
-          fTextures[region] = std::make_unique<RegionTextureCache>(directory, dim, region);
+          fRegionUpdates.push({directory, dim, region});
           fPool->addTexturePackJob(region, true);
           fLoadingRegions.insert(region);
         }
@@ -690,9 +772,7 @@ public:
     if (fWorldDirectory != worldDirectory || fDimension != dimension) {
       return;
     }
-    if (fTextures.count(region) == 0) {
-      fTextures[region] = std::make_unique<RegionTextureCache>(worldDirectory, dimension, region);
-    }
+    fRegionUpdates.push({worldDirectory, dimension, region});
     VisibleRegions vr = fVisibleRegions.load();
     vr.add(region.first, region.second);
     fVisibleRegions.store(vr);
@@ -708,9 +788,7 @@ public:
     if (fWorldDirectory != worldDirectory || fDimension != dimension) {
       return;
     }
-    if (fTextures.count(region) == 0) {
-      fTextures[region] = std::make_unique<RegionTextureCache>(worldDirectory, dimension, region);
-    }
+    fRegionUpdates.push({worldDirectory, dimension, region});
     VisibleRegions vr = fVisibleRegions.load();
     vr.add(region.first, region.second);
     fVisibleRegions.store(vr);
@@ -734,10 +812,11 @@ public:
     }
   }
 
+  // fMut is held only while exchanging state with other threads, not while drawing.
   void render(int const width, int const height, LookAt const lookAt, bool capturing) {
     using namespace juce;
     using namespace juce::gl;
-    std::lock_guard<std::mutex> lock(fMut);
+    Trace::Span span("MapViewComponent::render");
 
     if (capturing) {
       OpenGLHelpers::clear(Colours::transparentBlack);
@@ -749,8 +828,19 @@ public:
     }
     glViewport(0, 0, width, height);
 
+    Dimension dimension;
+    std::vector<Region> loadingRegions;
+    {
+      std::lock_guard<std::mutex> lock(fMut);
+      unsafeApplyRegionUpdates();
+      dimension = fDimension;
+      if (!capturing) {
+        loadingRegions.assign(fLoadingRegions.begin(), fLoadingRegions.end());
+      }
+    }
+
     if (!capturing) {
-      unsafeDrawBackground();
+      drawBackground(loadingRegions);
     }
 
     Time const now = Time::getCurrentTime();
@@ -787,220 +877,559 @@ public:
       paletteTexture = fGLPalette.get();
     }
 
+    // JUCE's painting of the background has touched the bindings
+    fGLState.setEnabled(fModernRenderer.get());
+
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_TEXTURE_2D);
-
-    fGLShader->use();
 
     int minRx, minRz, maxRx, maxRz;
     viewportRegions(&minRx, &minRz, &maxRx, &maxRz);
 
-    for (auto &it : fTextures) {
-      auto [rx, rz] = it.first;
-      if (rx < minRx || maxRx < rx || rz < minRz || maxRz < rz) {
-        continue;
-      }
-      auto &cache = it.second;
-      if (!cache->fTexture) {
-        continue;
-      }
-      if (fGLUniforms->blocksPerPixel.get() != nullptr) {
-        fGLUniforms->blocksPerPixel->set(lookAt.fBlocksPerPixel);
-      }
-      if (fGLUniforms->Xr.get() != nullptr) {
-        fGLUniforms->Xr->set((GLfloat)cache->fRegion.first * 512);
-      }
-      if (fGLUniforms->Zr.get() != nullptr) {
-        fGLUniforms->Zr->set((GLfloat)cache->fRegion.second * 512);
-      }
-      if (fGLUniforms->width.get() != nullptr) {
-        fGLUniforms->width->set((GLfloat)width);
-      }
-      if (fGLUniforms->height.get() != nullptr) {
-        fGLUniforms->height->set((GLfloat)height);
-      }
-      if (fGLUniforms->Cx.get() != nullptr) {
-        fGLUniforms->Cx->set((GLfloat)lookAt.fX);
+    uint64_t const frame = fResidency.beginFrame();
+    unsafeMarkVisible(minRx, minRz, maxRx, maxRz, frame);
+
+    int const level = overviewLevel(lookAt.fBlocksPerPixel);
+    bool const textureArrays = fResidency.usesTextureArrays() && fGLArrayShader;
+
+    MapFrame map;
+    map.fWidth = width;
+    map.fHeight = height;
+    map.fLookAt = lookAt;
+    map.fDimension = dimension;
+    map.fOverviewLevel = level;
+    map.fTextureArrays = textureArrays;
+    map.fPalette = palette;
+    map.fLighting = lighting;
+    map.fPaletteTexture = paletteTexture;
+    map.fMinRx = minRx;
+    map.fMinRz = minRz;
+    map.fMaxRx = maxRx;
+    map.fMaxRz = maxRz;
+    map.fNow = now;
+    map.fCapturing = capturing;
+
+    if (!capturing && fCompareRenderPaths.exchange(false)) {
+      unsafeCompareRenderPaths(map);
+    }
+
+    MapComposite *composite = nullptr;
+    if (!capturing && fGLCompositeShader) {
+      MapComposite::Key key;
+      key.fLookAt = lookAt;
+      key.fWidth = width;
+      key.fHeight = height;
+      key.fOverviewLevel = level;
+      key.fTextureArrays = textureArrays;
+      key.fDimension = dimension;
+      key.fPalette = palette;
+      key.fLighting = lighting;
+      key.fWaterOpticalDensity = fWaterOpticalDensity.get();
+      key.fWaterTranslucent = fWaterTranslucent.get();
+      key.fEnableBiome = fEnableBiome.get();
+      key.fBiomeBlend = fBiomeBlend.get();
+      if (fComposite.prepare(fGLContext, key)) {
+        composite = &fComposite;
+      }
+      // Creating the framebuffer binds its texture
+      fGLState.invalidate();
+    }
+
+    if (!capturing) {
+      fGLTimer.begin();
+    }
+    bool const redraw = !composite || composite->hasWork();
+    if (composite && redraw) {
+      composite->beginRedraw();
+      glViewport(0, 0, width, height);
+    }
+    if (redraw) {
+      unsafeDrawMap(map, composite);
+    }
+    if (composite) {
+      if (redraw) {
+        composite->endRedraw();
+        glViewport(0, 0, width, height);
       }
-      if (fGLUniforms->Cz.get() != nullptr) {
-        fGLUniforms->Cz->set((GLfloat)lookAt.fZ);
+      unsafeDrawComposite(*composite);
+    }
+    if (!capturing) {
+      fGLTimer.end();
+    }
+
+    if (!capturing && !fClosing.get()) {
+      std::lock_guard<std::mutex> lock(fMut);
+      unsafeInstantiateTextures();
+    }
+  }
+
+  // Applies the regions found or dropped by other threads to fTextures, which only the GL thread touches
+  void unsafeApplyRegionUpdates() {
+    fRegionUpdates.drain([this](RegionUpdate &&update) {
+      if (!update.fRegion) {
+        fTextures.forEach([this](Region, RegionTextureCache &cache) {
+          fResidency.release(cache);
+        });
+        fTextures.clear();
+        fOverviewTextures.clear();
+        fGLJobResults.clear();
+        fComposite.invalidate();
+        return;
       }
-      if (fGLUniforms->grassBlockId.get() != nullptr) {
-        fGLUniforms->grassBlockId->set((GLint)mcfile::blocks::minecraft::grass_block);
+      if (update.fWorldDirectory != fWorldDirectory || update.fDimension != fDimension) {
+        return;
       }
-      if (fGLUniforms->foliageBlockId) {
-        fGLUniforms->foliageBlockId->set((GLint)mcfile::blocks::minecraft::oak_leaves);
+      if (auto &cache = fTextures[*update.fRegion]; !cache) {
+        cache = std::make_unique<RegionTextureCache>(update.fWorldDirectory, update.fDimension, *update.fRegion);
       }
-      if (fGLUniforms->netherrackBlockId) {
-        fGLUniforms->netherrackBlockId->set((GLint)mcfile::blocks::minecraft::netherrack);
+    });
+  }
+
+  void unsafeMarkVisible(int minRx, int minRz, int maxRx, int maxRz, uint64_t frame) {
+    fTextures.forEachIn(minRx, minRz, maxRx, maxRz, [frame](Region, RegionTextureCache &cache) {
+      if (cache.isResident()) {
+        cache.fLastVisibleFrame = frame;
       }
-      if (fGLUniforms->waterBlockId) {
-        fGLUniforms->waterBlockId->set((GLint)mcfile::blocks::minecraft::water);
+    });
+  }
+
+  struct MapFrame {
+    int fWidth;
+    int fHeight;
+    LookAt fLookAt;
+    Dimension fDimension;
+    int fOverviewLevel;
+    bool fTextureArrays;
+    PaletteType fPalette;
+    LightingType fLighting;
+    juce::OpenGLTexture *fPaletteTexture;
+    int fMinRx;
+    int fMinRz;
+    int fMaxRx;
+    int fMaxRz;
+    juce::Time fNow;
+    bool fCapturing;
+  };
+
+  // composite: only its dirty tiles are drawn when given
+  void unsafeDrawMap(MapFrame const &map, MapComposite *composite) {
+    using namespace juce::gl;
+    if (!fGLState.isEnabled()) {
+      glEnable(GL_TEXTURE_2D);
+    }
+    if (map.fOverviewLevel > 0) {
+      fGLState.useProgram(*fGLShader);
+      unsafeSetFrameUniforms(*fGLUniforms, map);
+      unsafeRenderOverview(map.fOverviewLevel);
+    } else if (map.fTextureArrays) {
+      fGLState.useProgram(*fGLArrayShader);
+      unsafeSetFrameUniforms(*fGLArrayUniforms, map);
+      unsafeRenderTextureArray(map.fMinRx, map.fMinRz, map.fMaxRx, map.fMaxRz, map.fNow, map.fCapturing, composite);
+    } else {
+      fGLState.useProgram(*fGLShader);
+      unsafeSetFrameUniforms(*fGLUniforms, map);
+      unsafeRenderTextures(map.fMinRx, map.fMinRz, map.fMaxRx, map.fMaxRz, map.fNow, map.fCapturing, composite);
+    }
+  }
+
+  // Draws the map with both render paths into offscreen framebuffers. The modern path is turned off when any pixel differs
+  void unsafeCompareRenderPaths(MapFrame const &map) {
+    using namespace juce;
+    using namespace juce::gl;
+    bool const modern = fGLState.isEnabled();
+    std::array<std::vector<PixelARGB>, 2> pixels;
+    for (int i = 0; i < 2; i++) {
+      OpenGLFrameBuffer buffer;
+      if (!buffer.initialise(fGLContext, map.fWidth, map.fHeight)) {
+        fGLState.setEnabled(modern);
+        return;
       }
-      if (fGLUniforms->waterOpticalDensity) {
-        fGLUniforms->waterOpticalDensity->set((GLfloat)fWaterOpticalDensity.get());
+      fGLState.setEnabled(i == 1);
+      buffer.makeCurrentRenderingTarget();
+      OpenGLHelpers::clear(Colours::transparentBlack);
+      glDisable(GL_BLEND);
+      glDisable(GL_DEPTH_TEST);
+      unsafeDrawMap(map, nullptr);
+      buffer.releaseAsRenderingTarget();
+      pixels[i].resize((size_t)map.fWidth * map.fHeight);
+      buffer.readPixels(pixels[i].data(), juce::Rectangle<int>(0, 0, map.fWidth, map.fHeight));
+    }
+    int differ = 0;
+    for (size_t i = 0; i < pixels[0].size(); i++) {
+      if (pixels[0][i].getNativeARGB() != pixels[1][i].getNativeARGB()) {
+        differ++;
+      }
+    }
+    Logger::writeToLog(String::formatted("Render path comparison: %d of %d pixels differ between the legacy and the modern path", differ, map.fWidth * map.fHeight));
+
+    bool enabled = modern;
+    if (differ > 0) {
+      jassertfalse;
+      fModernRenderer = false;
+      enabled = false;
+      unsafeEnqueueAsyncUpdate(AsyncUpdateQueueRenderPathsDiffer{differ});
+    }
+    fGLState.setEnabled(enabled);
+    glViewport(0, 0, map.fWidth, map.fHeight);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  }
+
+  // The modern path records the layout in a vertex array, when available
+  GLVertexArray *unsafeVertexArray(GLVertexArray &array) {
+    if (fGLState.isEnabled() && fGLVertexArraysSupported) {
+      return &array;
+    }
+    return nullptr;
+  }
+
+  void unsafeBeginQuads(GLAttributes &attributes, GLVertexArray *vertexArray) {
+    using namespace juce::gl;
+    auto setup = [this, &attributes]() {
+      fGLContext.extensions.glBindBuffer(GL_ARRAY_BUFFER, fGLBuffer->vBuffer);
+      fGLContext.extensions.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fGLBuffer->iBuffer);
+      attributes.enable(fGLContext);
+    };
+    if (vertexArray) {
+      vertexArray->bind(setup);
+    } else {
+      setup();
+    }
+  }
+
+  void unsafeEndQuads(GLAttributes &attributes, GLVertexArray *vertexArray) {
+    if (vertexArray) {
+      GLVertexArray::Unbind();
+    } else {
+      attributes.disable(fGLContext);
+    }
+  }
+
+  // GL_QUADS is not available in core profiles
+  GLenum unsafeQuadMode() const {
+    using namespace juce::gl;
+    return fGLState.isEnabled() ? GL_TRIANGLE_FAN : GL_QUADS;
+  }
+
+  void unsafeDrawComposite(MapComposite const &composite) {
+    using namespace juce::gl;
+
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    fGLState.useProgram(*fGLCompositeShader);
+    fGLState.set(fGLCompositeUniforms->texture.get(), (GLint)0);
+    fGLState.bindTexture(0, GL_TEXTURE_2D, composite.textureID());
+
+    GLVertexArray *vertexArray = unsafeVertexArray(fGLCompositeVertexArray);
+    unsafeBeginQuads(*fGLCompositeAttributes, vertexArray);
+    glDrawElements(unsafeQuadMode(), GLBuffer::kNumPoints, GL_UNSIGNED_INT, nullptr);
+    unsafeEndQuads(*fGLCompositeAttributes, vertexArray);
+  }
+
+  void unsafeSetFrameUniforms(GLUniforms &uniforms, MapFrame const &map) {
+    using namespace juce::gl;
+    juce::OpenGLTexture const &paletteTexture = *map.fPaletteTexture;
+    fGLState.set(uniforms.blocksPerPixel.get(), (GLfloat)map.fLookAt.fBlocksPerPixel);
+    fGLState.set(uniforms.width.get(), (GLfloat)map.fWidth);
+    fGLState.set(uniforms.height.get(), (GLfloat)map.fHeight);
+    fGLState.set(uniforms.Cx.get(), (GLfloat)map.fLookAt.fX);
+    fGLState.set(uniforms.Cz.get(), (GLfloat)map.fLookAt.fZ);
+    fGLState.set(uniforms.grassBlockId.get(), (GLint)mcfile::blocks::minecraft::grass_block);
+    fGLState.set(uniforms.foliageBlockId.get(), (GLint)mcfile::blocks::minecraft::oak_leaves);
+    fGLState.set(uniforms.netherrackBlockId.get(), (GLint)mcfile::blocks::minecraft::netherrack);
+    fGLState.set(uniforms.waterBlockId.get(), (GLint)mcfile::blocks::minecraft::water);
+    fGLState.set(uniforms.waterOpticalDensity.get(), (GLfloat)fWaterOpticalDensity.get());
+    fGLState.set(uniforms.waterTranslucent.get(), (GLint)fWaterTranslucent.get());
+    fGLState.set(uniforms.biomeBlend.get(), (GLint)fBiomeBlend.get());
+    fGLState.set(uniforms.enableBiome.get(), (GLint)fEnableBiome.get());
+    fGLState.set(uniforms.dimension.get(), (GLint)map.fDimension);
+    fGLState.set(uniforms.tileExtent.get(), (GLfloat)512);
+
+    fGLState.bindTexture(9, GL_TEXTURE_2D, paletteTexture.getTextureID());
+    fGLState.set(uniforms.palette.get(), (GLint)9);
+    fGLState.set(uniforms.paletteSize.get(), (GLint)paletteTexture.getWidth());
+    fGLState.set(uniforms.lightingType.get(), static_cast<GLint>(map.fLighting));
+    if (uniforms.paletteType) {
+      GLint pt = 0;
+      switch (map.fPalette) {
+      case PaletteType::java:
+        pt = 1;
+        break;
+      case PaletteType::bedrock:
+        pt = 2;
+        break;
+      case PaletteType::mcview:
+      default:
+        pt = 0;
+        break;
       }
-      if (fGLUniforms->waterTranslucent) {
-        fGLUniforms->waterTranslucent->set((GLboolean)fWaterTranslucent.get());
+      fGLState.set(uniforms.paletteType.get(), pt);
+    }
+  }
+
+  // Offsets of the neighbours bound to texture unit 1 to 8, in the order of the samplers in tile_sampler.glsl
+  static std::array<Region, 8> NeighbourOffsets() {
+    return {
+        MakeRegion(0, -1),
+        MakeRegion(1, -1),
+        MakeRegion(1, 0),
+        MakeRegion(1, 1),
+        MakeRegion(0, 1),
+        MakeRegion(-1, 1),
+        MakeRegion(-1, 0),
+        MakeRegion(-1, -1),
+    };
+  }
+
+  void unsafeSetSamplerUnits(GLUniforms &uniforms) {
+    fGLState.set(uniforms.texture.get(), (GLint)0);
+    std::array<juce::OpenGLShaderProgram::Uniform *, 8> const neighbours = {
+        uniforms.north.get(),
+        uniforms.northEast.get(),
+        uniforms.east.get(),
+        uniforms.southEast.get(),
+        uniforms.south.get(),
+        uniforms.southWest.get(),
+        uniforms.west.get(),
+        uniforms.northWest.get(),
+    };
+    for (size_t i = 0; i < neighbours.size(); i++) {
+      fGLState.set(neighbours[i], (GLint)i + 1);
+    }
+    fGLState.set(uniforms.shade.get(), (GLint)10);
+  }
+
+  // Whether the precomputed shade of the cache matches the current settings
+  bool unsafeIsShaded(RegionTextureCache const &cache) const {
+    return cache.isShaded() && cache.fShadeBiomeBlend == fBiomeBlend.get();
+  }
+
+  // composite: only its dirty tiles are drawn when given
+  void unsafeRenderTextures(int minRx, int minRz, int maxRx, int maxRz, juce::Time now, bool capturing, MapComposite *composite) {
+    using namespace juce::gl;
+
+    unsafeSetSamplerUnits(*fGLUniforms);
+    auto const offsets = NeighbourOffsets();
+    GLenum const mode = unsafeQuadMode();
+
+    GLVertexArray *vertexArray = unsafeVertexArray(fGLTileVertexArray);
+    unsafeBeginQuads(*fGLAttributes, vertexArray);
+
+    fTextures.forEachIn(minRx, minRz, maxRx, maxRz, [&](Region region, RegionTextureCache &cache) {
+      auto [rx, rz] = region;
+      if (!cache.fTexture) {
+        return;
       }
-      if (fGLUniforms->biomeBlend) {
-        fGLUniforms->biomeBlend->set((GLint)fBiomeBlend.get());
+      if (composite && !composite->isDirty(region)) {
+        return;
       }
-      if (fGLUniforms->enableBiome) {
-        fGLUniforms->enableBiome->set((GLboolean)fEnableBiome.get());
+      GLfloat const fade = FadeAlpha(cache, now, capturing);
+      if (composite && fade < 1) {
+        composite->invalidateTile(region);
       }
-      if (fGLUniforms->dimension) {
-        fGLUniforms->dimension->set((GLint)fDimension);
+      fGLState.set(fGLUniforms->Xr.get(), (GLfloat)rx * 512);
+      fGLState.set(fGLUniforms->Zr.get(), (GLfloat)rz * 512);
+      fGLState.set(fGLUniforms->fade.get(), fade);
+      fGLState.set(fGLUniforms->tileSize.get(), (GLfloat)cache.fTexture->getWidth());
+      bool const shaded = cache.fShadeTexture && unsafeIsShaded(cache);
+      fGLState.set(fGLUniforms->shaded.get(), (GLint)shaded);
+
+      fGLState.bindTexture(0, GL_TEXTURE_2D, cache.fTexture->getTextureID());
+      if (shaded) {
+        fGLState.bindTexture(10, GL_TEXTURE_2D, cache.fShadeTexture->getTextureID());
       }
 
-      if (fGLUniforms->fade.get() != nullptr) {
-        if (!capturing) {
-          int const ms = (int)std::clamp(now.toMilliseconds() - cache->fLoadTime.toMilliseconds(), 0LL, (int64)kFadeDurationMS);
-          GLfloat const a = ms > kFadeDurationMS ? 1.0f : CubicEaseInOut((float)ms / (float)kFadeDurationMS, 0.0f, 1.0f, 1.0f);
-          fGLUniforms->fade->set(a);
-        } else {
-          fGLUniforms->fade->set(1.0f);
+      for (size_t i = 0; i < offsets.size(); i++) {
+        auto [dx, dz] = offsets[i];
+        if (auto neighbour = fTextures.find(MakeRegion(rx + dx, rz + dz)); neighbour && neighbour->fTexture) {
+          fGLState.bindTexture(1 + (int)i, GL_TEXTURE_2D, neighbour->fTexture->getTextureID());
         }
       }
 
-      fGLContext.extensions.glActiveTexture(GL_TEXTURE0);
-      cache->fTexture->bind();
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-      if (fGLUniforms->texture.get() != nullptr) {
-        fGLUniforms->texture->set(0);
-      }
+      glDrawElements(mode, GLBuffer::kNumPoints, GL_UNSIGNED_INT, nullptr);
+    });
 
-      int const x = it.first.first;
-      int const z = it.first.second;
+    unsafeEndQuads(*fGLAttributes, vertexArray);
+  }
 
-      if (auto const &north = fTextures.find(MakeRegion(x, z - 1)); north != fTextures.end() && north->second->fTexture) {
-        fGLContext.extensions.glActiveTexture(GL_TEXTURE0 + 1);
-        north->second->fTexture->bind();
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        if (fGLUniforms->north) {
-          fGLUniforms->north->set(1);
-        }
-      }
+  void unsafeRenderOverview(int level) {
+    using namespace juce::gl;
 
-      if (auto const &northEast = fTextures.find(MakeRegion(x + 1, z - 1)); northEast != fTextures.end() && northEast->second->fTexture) {
-        fGLContext.extensions.glActiveTexture(GL_TEXTURE0 + 2);
-        northEast->second->fTexture->bind();
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        if (fGLUniforms->northEast) {
-          fGLUniforms->northEast->set(2);
-        }
-      }
+    unsafeSetSamplerUnits(*fGLUniforms);
+    auto const offsets = NeighbourOffsets();
+    GLenum const mode = unsafeQuadMode();
+    fGLState.set(fGLUniforms->tileExtent.get(), (GLfloat)(512 << level));
+    fGLState.set(fGLUniforms->tileSize.get(), (GLfloat)512);
+    fGLState.set(fGLUniforms->fade.get(), 1.0f);
+    fGLState.set(fGLUniforms->shaded.get(), (GLint)0);
 
-      if (auto const &east = fTextures.find(MakeRegion(x + 1, z)); east != fTextures.end() && east->second->fTexture) {
-        fGLContext.extensions.glActiveTexture(GL_TEXTURE0 + 3);
-        east->second->fTexture->bind();
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        if (fGLUniforms->east) {
-          fGLUniforms->east->set(3);
-        }
-      }
+    GLVertexArray *vertexArray = unsafeVertexArray(fGLTileVertexArray);
+    unsafeBeginQuads(*fGLAttributes, vertexArray);
 
-      if (auto const &southEast = fTextures.find(MakeRegion(x + 1, z + 1)); southEast != fTextures.end() && southEast->second->fTexture) {
-        fGLContext.extensions.glActiveTexture(GL_TEXTURE0 + 4);
-        southEast->second->fTexture->bind();
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        if (fGLUniforms->southEast) {
-          fGLUniforms->southEast->set(4);
-        }
+    for (auto &it : fOverviewTextures) {
+      OverviewTile const tile = it.first;
+      if (tile.fLevel != level || !it.second) {
+        continue;
       }
+      fGLState.set(fGLUniforms->Xr.get(), (GLfloat)tile.minRx() * 512);
+      fGLState.set(fGLUniforms->Zr.get(), (GLfloat)tile.minRz() * 512);
 
-      if (auto const &south = fTextures.find(MakeRegion(x, z + 1)); south != fTextures.end() && south->second->fTexture) {
-        fGLContext.extensions.glActiveTexture(GL_TEXTURE0 + 5);
-        south->second->fTexture->bind();
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        if (fGLUniforms->south) {
-          fGLUniforms->south->set(5);
-        }
-      }
+      fGLState.bindTexture(0, GL_TEXTURE_2D, it.second->getTextureID());
 
-      if (auto const &southWest = fTextures.find(MakeRegion(x - 1, z + 1)); southWest != fTextures.end() && southWest->second->fTexture) {
-        fGLContext.extensions.glActiveTexture(GL_TEXTURE0 + 6);
-        southWest->second->fTexture->bind();
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        if (fGLUniforms->southWest) {
-          fGLUniforms->southWest->set(6);
+      for (size_t i = 0; i < offsets.size(); i++) {
+        auto [dx, dz] = offsets[i];
+        if (auto neighbour = fOverviewTextures.find({level, tile.fX + dx, tile.fZ + dz}); neighbour != fOverviewTextures.end() && neighbour->second) {
+          fGLState.bindTexture(1 + (int)i, GL_TEXTURE_2D, neighbour->second->getTextureID());
         }
       }
 
-      if (auto const &west = fTextures.find(MakeRegion(x - 1, z)); west != fTextures.end() && west->second->fTexture) {
-        fGLContext.extensions.glActiveTexture(GL_TEXTURE0 + 7);
-        west->second->fTexture->bind();
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        if (fGLUniforms->west) {
-          fGLUniforms->west->set(7);
-        }
-      }
+      glDrawElements(mode, GLBuffer::kNumPoints, GL_UNSIGNED_INT, nullptr);
+    }
 
-      if (auto const &northWest = fTextures.find(MakeRegion(x - 1, z - 1)); northWest != fTextures.end() && northWest->second->fTexture) {
-        fGLContext.extensions.glActiveTexture(GL_TEXTURE0 + 8);
-        northWest->second->fTexture->bind();
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        if (fGLUniforms->northWest) {
-          fGLUniforms->northWest->set(8);
-        }
+    unsafeEndQuads(*fGLAttributes, vertexArray);
+  }
+
+  void unsafeRenderTextureArray(int minRx, int minRz, int maxRx, int maxRz, juce::Time now, bool capturing, MapComposite *composite) {
+    using namespace juce::gl;
+
+    // Regions in the viewport plus a 1 region margin, to look up neighbours
+    int const stride = maxRx - minRx + 3;
+    int const rows = maxRz - minRz + 3;
+    fGLTileTable.assign((size_t)stride * rows, nullptr);
+    fTextures.forEachIn(minRx - 1, minRz - 1, maxRx + 1, maxRz + 1, [this, stride, minRx, minRz](Region region, RegionTextureCache &cache) {
+      fGLTileTable[(region.second - minRz + 1) * stride + (region.first - minRx + 1)] = &cache;
+    });
+    // Neighbours of another level of detail live in another array, so they can't be sampled
+    auto layerAt = [this, stride, minRx, minRz](int rx, int rz, int lod) {
+      RegionTextureCache const *cache = fGLTileTable[(rz - minRz + 1) * stride + (rx - minRx + 1)];
+      if (!cache || cache->fLayer < 0 || cache->fLod != lod) {
+        return -1.0f;
       }
+      return (float)cache->fLayer;
+    };
 
-      fGLContext.extensions.glActiveTexture(GL_TEXTURE0 + 9);
-      paletteTexture->bind();
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-      if (fGLUniforms->palette) {
-        fGLUniforms->palette->set(9);
+    for (auto &instances : fGLTileInstances) {
+      instances.clear();
+    }
+    fTextures.forEachIn(minRx, minRz, maxRx, maxRz, [&](Region region, RegionTextureCache &cache) {
+      auto [rx, rz] = region;
+      if (cache.fLayer < 0) {
+        return;
       }
-      if (fGLUniforms->paletteSize) {
-        fGLUniforms->paletteSize->set((GLint)paletteTexture->getWidth());
+      if (composite && !composite->isDirty(region)) {
+        return;
       }
-      if (fGLUniforms->lightingType) {
-        fGLUniforms->lightingType->set(static_cast<GLint>(lighting));
+      int const lod = cache.fLod;
+      GLTileInstance instance;
+      instance.tile[0] = (GLfloat)rx * 512;
+      instance.tile[1] = (GLfloat)rz * 512;
+      instance.tile[2] = FadeAlpha(cache, now, capturing);
+      if (composite && instance.tile[2] < 1) {
+        composite->invalidateTile(region);
+      }
+      instance.tile[3] = unsafeIsShaded(cache) ? 1.0f : 0.0f;
+      instance.layers[0] = (float)cache.fLayer;
+      instance.layers[1] = layerAt(rx, rz - 1, lod);
+      instance.layers[2] = layerAt(rx + 1, rz - 1, lod);
+      instance.layers[3] = layerAt(rx + 1, rz, lod);
+      instance.layers[4] = layerAt(rx + 1, rz + 1, lod);
+      instance.layers[5] = layerAt(rx, rz + 1, lod);
+      instance.layers[6] = layerAt(rx - 1, rz + 1, lod);
+      instance.layers[7] = layerAt(rx - 1, rz, lod);
+      instance.layers[8] = layerAt(rx - 1, rz - 1, lod);
+      fGLTileInstances[lod].push_back(instance);
+    });
+
+    fGLState.set(fGLArrayUniforms->tiles.get(), (GLint)0);
+    fGLState.set(fGLArrayUniforms->shades.get(), (GLint)1);
+    GLenum const mode = unsafeQuadMode();
+    GLVertexArray *vertexArray = unsafeVertexArray(fGLArrayVertexArray);
+    for (int lod = 0; lod <= RegionToTexture::kMaxLod; lod++) {
+      auto const &instances = fGLTileInstances[lod];
+      TileTextureArray *array = fResidency.textureArray(lod);
+      if (instances.empty() || !array) {
+        continue;
       }
-      if (fGLUniforms->paletteType) {
-        GLint pt = 0;
-        switch (palette) {
-        case PaletteType::java:
-          pt = 1;
-          break;
-        case PaletteType::bedrock:
-          pt = 2;
-          break;
-        case PaletteType::mcview:
-        default:
-          pt = 0;
-          break;
-        }
-        fGLUniforms->paletteType->set(pt);
+      fGLState.bindTexture(0, GL_TEXTURE_2D_ARRAY, array->textureID());
+      if (array->planes() > 1) {
+        fGLState.bindTexture(1, GL_TEXTURE_2D_ARRAY, array->textureID(1));
+      }
+      fGLState.set(fGLArrayUniforms->tileSize.get(), (GLfloat)array->size());
+
+      fGLContext.extensions.glBindBuffer(GL_ARRAY_BUFFER, fGLBuffer->instanceBuffer);
+      fGLContext.extensions.glBufferData(GL_ARRAY_BUFFER, sizeof(GLTileInstance) * instances.size(), instances.data(), GL_STREAM_DRAW);
+      auto setup = [this]() {
+        fGLContext.extensions.glBindBuffer(GL_ARRAY_BUFFER, fGLBuffer->instanceBuffer);
+        fGLArrayAttributes->enableInstances(fGLContext);
+        fGLContext.extensions.glBindBuffer(GL_ARRAY_BUFFER, fGLBuffer->vBuffer);
+        fGLContext.extensions.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fGLBuffer->iBuffer);
+        fGLArrayAttributes->enable(fGLContext);
+      };
+      if (vertexArray) {
+        vertexArray->bind(setup);
+      } else {
+        setup();
       }
 
-      fGLContext.extensions.glBindBuffer(GL_ARRAY_BUFFER, fGLBuffer->vBuffer);
-      fGLContext.extensions.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fGLBuffer->iBuffer);
+      glDrawElementsInstanced(mode, GLBuffer::kNumPoints, GL_UNSIGNED_INT, nullptr, (GLsizei)instances.size());
 
-      fGLAttributes->enable(fGLContext);
-      glDrawElements(GL_QUADS, GLBuffer::kNumPoints, GL_UNSIGNED_INT, nullptr);
-      fGLAttributes->disable(fGLContext);
+      if (vertexArray) {
+        GLVertexArray::Unbind();
+      } else {
+        fGLArrayAttributes->disable(fGLContext);
+        fGLArrayAttributes->disableInstances(fGLContext);
+      }
     }
+  }
 
-    if (!capturing && !fClosing.get()) {
-      unsafeInstantiateTextures();
+  // Level of detail of the textures to upload, from the number of blocks per physical screen pixel
+  int unsafeDesiredLod() const {
+    if (fCaptureFile != juce::File()) {
+      // Images are captured at 1 block per pixel
+      return 0;
+    }
+    float const blocksPerPixel = fLookAt.load().fBlocksPerPixel / (float)fGLContext.getRenderingScale();
+    if (blocksPerPixel < 2) {
+      return 0;
+    }
+    return (std::min)((int)std::floor(std::log2(blocksPerPixel)), RegionToTexture::kMaxLod);
+  }
+
+  // Level of overview tiles to show instead of regions, or 0.
+  // blocksPerPixel is per physical pixel when called from render, per logical pixel otherwise.
+  int overviewLevel(float blocksPerPixel) const {
+    if (blocksPerPixel < (float)(1 << kMinOverviewLevel)) {
+      return 0;
+    }
+    return (std::min)((int)std::floor(std::log2(blocksPerPixel)), kMaxOverviewLevel);
+  }
+
+  int overviewLevel(LookAt const &lookAt) const {
+    return overviewLevel(lookAt.fBlocksPerPixel / (float)fGLContext.getRenderingScale());
+  }
+
+  static GLfloat FadeAlpha(RegionTextureCache const &cache, juce::Time now, bool capturing) {
+    if (capturing) {
+      return 1.0f;
     }
+    int const ms = (int)std::clamp(now.toMilliseconds() - cache.fLoadTime.toMilliseconds(), 0LL, (juce::int64)kFadeDurationMS);
+    return ms > kFadeDurationMS ? 1.0f : CubicEaseInOut((float)ms / (float)kFadeDurationMS, 0.0f, 1.0f, 1.0f);
   }
 
   void handleAsyncUpdate() override {
+    if (fJobsFinished.exchange(false)) {
+      for (int i = (int)fPoolTrashBin.size() - 1; i >= 0; i--) {
+        if (fPoolTrashBin[i]->getNumJobs() == 0) {
+          fPoolTrashBin.erase(fPoolTrashBin.begin() + i);
+        }
+      }
+      triggerRepaint();
+    }
     std::deque<AsyncUpdateQueue> copy;
     {
       std::lock_guard<std::mutex> lock(fMut);
@@ -1022,19 +1451,21 @@ public:
     }
     juce::StringArray shaderCompileErrorMessages;
     for (auto const &q : queue) {
-      if (std::holds_alternative<AsyncUpdateQueueReleaseGarbageThreadPool>(q)) {
-        for (int i = (int)fPoolTrashBin.size() - 1; i >= 0; i--) {
-          if (fPoolTrashBin[i]->getNumJobs() == 0) {
-            fPoolTrashBin.erase(fPoolTrashBin.begin() + i);
-          }
-        }
-      } else if (std::holds_alternative<AsyncUpdateQueueTriggerRepaint>(q)) {
+      if (std::holds_alternative<AsyncUpdateQueueTriggerRepaint>(q)) {
         triggerRepaint();
       } else if (std::holds_alternative<AsyncUpdateQueueUpdateCaptureButtonStatus>(q)) {
         updateCaptureButtonStatus();
       } else if (std::holds_alternative<AsyncUpdateQueueShowShaderCompileErrorMessage>(q)) {
         auto p = std::get<AsyncUpdateQueueShowShaderCompileErrorMessage>(q);
         shaderCompileErrorMessages.add(p.fMessage);
+      } else if (std::holds_alternative<AsyncUpdateQueueStartCapture>(q)) {
+        startCapture();
+      } else if (std::holds_alternative<AsyncUpdateQueueExportJobFinished>(q)) {
+        auto p = std::get<AsyncUpdateQueueExportJobFinished>(q);
+        exportJobFinished(p.fCompleted);
+      } else if (std::holds_alternative<AsyncUpdateQueueRenderPathsDiffer>(q)) {
+        auto p = std::get<AsyncUpdateQueueRenderPathsDiffer>(q);
+        renderPathsDiffer(p.fPixels);
       }
     }
     if (!shaderCompileErrorMessages.isEmpty()) {
@@ -1082,6 +1513,29 @@ public:
       return;
     }
     fBiomeBlend = blend;
+    if (fPool) {
+      fPool->setShadeBiomeBlend(shadeBiomeBlend());
+    }
+    triggerRepaint();
+  }
+
+  void setPrecomputeShading(bool precompute) {
+    if (precompute == fPrecomputeShading.get()) {
+      return;
+    }
+    fPrecomputeShading = precompute;
+    if (fPool) {
+      fPool->setShadeBiomeBlend(shadeBiomeBlend());
+    }
+    triggerRepaint();
+  }
+
+  void setModernRenderer(bool modern) {
+    if (modern == fModernRenderer.get()) {
+      return;
+    }
+    fModernRenderer = modern;
+    fCompareRenderPaths = true;
     triggerRepaint();
   }
 
@@ -1110,7 +1564,16 @@ public:
     triggerRepaint();
   }
 
+  void setTextureMemoryBudget(int megaBytes) {
+    fResidency.setBudget(int64_t(megaBytes) * 1024 * 1024);
+  }
+
 private:
+  // Biome blend the worker threads precompute shades with, or -1 when shading is done entirely in the fragment shader
+  int shadeBiomeBlend() const {
+    return fPrecomputeShading.get() ? fBiomeBlend.get() : -1;
+  }
+
   void paintOverlayMessages(juce::Graphics &g) {
     juce::String message;
     bool dots = false;
@@ -1143,62 +1606,40 @@ private:
     s.draw(g, getLocalBounds().toFloat());
   }
 
-  static std::optional<int64_t> ReadLastPlayedTimestamp(std::filesystem::path const &dat) {
-    auto fs = std::make_shared<mcfile::stream::FileInputStream>(dat);
-    if (!fs->valid()) {
-      return std::nullopt;
-    }
-    mcfile::stream::InputStreamReader reader(fs, mcfile::Encoding::LittleEndian);
-    uint32_t version;
-    if (!reader.read(&version)) {
-      return std::nullopt;
-    }
-    uint32_t size;
-    if (!reader.read(&size)) {
-      return std::nullopt;
-    }
-    std::string buffer;
-    buffer.resize(size);
-    if (!fs->read(buffer.data(), buffer.size())) {
-      return std::nullopt;
-    }
-    fs.reset();
-    auto comp = mcfile::nbt::CompoundTag::Read(buffer, mcfile::Encoding::LittleEndian);
-    if (!comp) {
-      return std::nullopt;
-    }
-    return comp->int64(u8"LastPlayed");
-  }
-
   void updateCaptureButtonStatus() {
     std::lock_guard<std::mutex> lock(fMut);
     unsafeUpdateCaptureButtonStatus();
   }
 
+  // The button opens the export dialog. A background export reads any area from the world, so only capturing on the GL thread depends on what the map shows, see unsafeGLCaptureUnavailableReason
   bool unsafeShouldEnableCaptureButton() {
-    if (fCapturingToImage.get()) {
+    if (fExporting.get()) {
+      // To cancel the export
+      return true;
+    }
+    if (fCapturingToImage.get() || fCaptureFile != juce::File()) {
       return false;
     }
+    // Every known region of the open world is in fVisibleRegions
+    return fVisibleRegions.load().getWidth() > 0;
+  }
+
+  // Message telling why the map can not be captured on the GL thread now, or empty when it can
+  std::optional<juce::String> unsafeGLCaptureUnavailableReason() {
     if (fGLShaderCompileAlreadyFailed.load() == true) {
-      return false;
+      return TRANS("Failed compiling shader");
     }
-    if (fTextures.empty()) {
-      return false;
+    if (overviewLevel(fLookAt.load()) > 0) {
+      return TRANS("Zoom in until regions are shown to capture with the GPU, or export in the background");
     }
     int minRx, minRz, maxRx, maxRz;
     viewportRegions(&minRx, &minRz, &maxRx, &maxRz);
-    int count = 0;
-    for (int rz = minRz; rz <= maxRz; rz++) {
-      for (int rx = minRx; rx <= maxRx; rx++) {
-        auto region = MakeRegion(rx, rz);
-        if (fTextures.count(region) > 0) {
-          if (fLoadingRegions.count(region) > 0) {
-            return false;
-          }
-        }
+    for (Region region : fLoadingRegions) {
+      if (minRx <= region.first && region.first <= maxRx && minRz <= region.second && region.second <= maxRz) {
+        return TRANS("Wait until the visible regions are loaded to capture with the GPU, or export in the background");
       }
     }
-    return true;
+    return std::nullopt;
   }
 
   void unsafeUpdateCaptureButtonStatus() {
@@ -1225,6 +1666,12 @@ private:
       }
       fWorldScanThread.reset();
     }
+    if (fExportJob) {
+      if (fExportJob->isThreadRunning()) {
+        return;
+      }
+      fExportJob.reset();
+    }
     if (fPool) {
       if (fPool->getNumJobs() > 0) {
         return;
@@ -1237,6 +1684,13 @@ private:
       }
     }
     fPoolTrashBin.clear();
+    if (fCacheWriter) {
+      fCacheWriter->close();
+      if (fCacheWriter->isThreadRunning()) {
+        return;
+      }
+      fCacheWriter.reset();
+    }
     fDelegate->mainViewComponentClosed();
   }
 
@@ -1254,18 +1708,100 @@ private:
     }
     texture.reset(new juce::OpenGLTexture);
     texture->loadARGB(data.get(), size, size);
+    TextureUploader::SetNearestFilter();
   }
 
   void updateShader() {
+    using namespace juce;
+    String error;
+    auto shader = compileShader(String::fromUTF8(BinaryData::tile_vert, BinaryData::tile_vertSize),
+                                String(),
+                                String::fromUTF8(BinaryData::tile_sampler_glsl, BinaryData::tile_sampler_glslSize),
+                                error);
+    if (!shader) {
+      AsyncUpdateQueueShowShaderCompileErrorMessage m;
+      m.fMessage = error;
+      enqueueAsyncUpdate(m);
+      return;
+    }
+    fGLUniforms.reset(new GLUniforms(fGLContext, *shader));
+    fGLAttributes.reset(new GLAttributes(fGLContext, *shader));
+    fGLShader.reset(shader.release());
+    fGLTileVertexArray.release();
+    fGLState.reset();
+
+    updateCompositeShader();
+
+    fGLArrayShader.reset();
+    fGLArrayUniforms.reset();
+    fGLArrayAttributes.reset();
+    fGLArrayVertexArray.release();
+    if (!TileTextureArray::IsSupported()) {
+      return;
+    }
+    String const arrayVertex = String::fromUTF8(BinaryData::tile_array_vert, BinaryData::tile_array_vertSize);
+    std::unique_ptr<OpenGLShaderProgram> arrayShader;
+    bool integer = false;
+    if (TileTextureArray::IsIntegerSupported()) {
+      // Packed pixel info is decoded with integer operations, falling back to normalized textures below
+      arrayShader = compileShader(arrayVertex,
+                                  "#extension GL_EXT_texture_array : enable",
+                                  String::fromUTF8(BinaryData::tile_array_integer_sampler_glsl, BinaryData::tile_array_integer_sampler_glslSize),
+                                  error);
+      if (arrayShader) {
+        integer = true;
+      } else {
+        Logger::writeToLog("Integer texture array is not available: " + error);
+      }
+    }
+    if (!arrayShader) {
+      arrayShader = compileShader(arrayVertex,
+                                  "#extension GL_EXT_texture_array : enable",
+                                  String::fromUTF8(BinaryData::tile_array_sampler_glsl, BinaryData::tile_array_sampler_glslSize),
+                                  error);
+    }
+    if (!arrayShader) {
+      Logger::writeToLog("Texture array is not available: " + error);
+      return;
+    }
+    fGLArrayUniforms.reset(new GLUniforms(fGLContext, *arrayShader));
+    fGLArrayAttributes.reset(new GLAttributes(fGLContext, *arrayShader));
+    fGLArrayShader.reset(arrayShader.release());
+    if (!fResidency.usesTextureArrays() || fResidency.usesIntegerTextureArrays() != integer) {
+      unsafeReleaseTextures();
+      fResidency.setTextureArraysEnabled(true, integer);
+    }
+  }
+
+  // The map is drawn directly when this fails
+  void updateCompositeShader() {
+    using namespace juce;
+    fGLCompositeShader.reset();
+    fGLCompositeUniforms.reset();
+    fGLCompositeAttributes.reset();
+    fGLCompositeVertexArray.release();
+    fComposite.release();
+
+    auto shader = std::make_unique<OpenGLShaderProgram>(fGLContext);
+    if (!shader->addVertexShader(String::fromUTF8(BinaryData::composite_vert, BinaryData::composite_vertSize)) ||
+        !shader->addFragmentShader(String::fromUTF8(BinaryData::composite_frag, BinaryData::composite_fragSize)) ||
+        !shader->link()) {
+      Logger::writeToLog("Map composite is not available: " + shader->getLastError());
+      return;
+    }
+    fGLCompositeUniforms.reset(new GLUniforms(fGLContext, *shader));
+    fGLCompositeAttributes.reset(new GLAttributes(fGLContext, *shader));
+    fGLCompositeShader.reset(shader.release());
+  }
+
+  std::unique_ptr<juce::OpenGLShaderProgram> compileShader(juce::String const &vertex, juce::String const &tileExtensions, juce::String const &tileSampler, juce::String &error) {
     using namespace std;
     using namespace juce;
     std::unique_ptr<juce::OpenGLShaderProgram> newShader(new juce::OpenGLShaderProgram(fGLContext));
 
-    if (!newShader->addVertexShader(String::fromUTF8(BinaryData::tile_vert, BinaryData::tile_vertSize))) {
-      AsyncUpdateQueueShowShaderCompileErrorMessage m;
-      m.fMessage = "addVertexShader failed: " + newShader->getLastError();
-      unsafeEnqueueAsyncUpdate(m);
-      return;
+    if (!newShader->addVertexShader(vertex)) {
+      error = "addVertexShader failed: " + newShader->getLastError();
+      return nullptr;
     }
 
     colormap::kbinani::Altitude altitude;
@@ -1311,7 +1847,9 @@ private:
     fragment << "}" << std::endl;
 
     String fragmentShaderTemplate = fragment.str();
-    String fragmentShader = fragmentShaderTemplate.replace("#{airBlockId}", String(mcfile::blocks::minecraft::air));
+    String fragmentShader = fragmentShaderTemplate.replace("#{airBlockId}", String(mcfile::blocks::minecraft::air))
+                                .replace("#{tileExtensions}", tileExtensions)
+                                .replace("#{tileSampler}", tileSampler);
 
 #if 0
     int lineNumber = 0;
@@ -1320,24 +1858,24 @@ private:
     }
 #endif
     if (!newShader->addFragmentShader(fragmentShader)) {
-      AsyncUpdateQueueShowShaderCompileErrorMessage q;
-      q.fMessage = "addFragmentShader failed: " + newShader->getLastError();
-      unsafeEnqueueAsyncUpdate(q);
-      return;
+      error = "addFragmentShader failed: " + newShader->getLastError();
+      return nullptr;
     }
 
     if (!newShader->link()) {
-      AsyncUpdateQueueShowShaderCompileErrorMessage q;
-      q.fMessage = "link failed: " + newShader->getLastError();
-      unsafeEnqueueAsyncUpdate(q);
-      return;
+      error = "link failed: " + newShader->getLastError();
+      return nullptr;
     }
     newShader->use();
+    return newShader;
+  }
 
-    fGLUniforms.reset(new GLUniforms(fGLContext, *newShader));
-    fGLAttributes.reset(new GLAttributes(fGLContext, *newShader));
-
-    fGLShader.reset(newShader.release());
+  // Drops all resident textures. Regions in the viewport are loaded again, mostly from the tile cache.
+  void unsafeReleaseTextures() {
+    fTextures.forEach([this](Region, RegionTextureCache &cache) {
+      fResidency.release(cache);
+    });
+    fComposite.invalidate();
   }
 
   juce::Point<float> getMapCoordinateFromView(juce::Point<float> p) const {
@@ -1395,7 +1933,7 @@ private:
     triggerRepaint();
   }
 
-  void unsafeDrawBackground() {
+  void drawBackground(std::vector<Region> const &loadingRegions) {
     using namespace juce;
     juce::Point<int> size = fSize.load();
     const int width = size.x;
@@ -1441,7 +1979,7 @@ private:
     }
 
     g.setColour(Colour::fromRGBA(0, 0, 0, 37));
-    for (Region region : fLoadingRegions) {
+    for (Region region : loadingRegions) {
       int const x = region.first * 512;
       int const z = region.second * 512;
       juce::Point<float> topLeft = getViewCoordinateFromMap(juce::Point<float>(x, z), current);
@@ -1456,7 +1994,51 @@ private:
   }
 
   void captureToImage() {
+    if (fExportJob) {
+      auto options = juce::MessageBoxOptions()
+                         .withButton(TRANS("Stop"))
+                         .withButton(TRANS("Continue"))
+                         .withIconType(juce::MessageBoxIconType::QuestionIcon)
+                         .withMessage(TRANS("Do you want to stop exporting the image?"))
+                         .withTitle(TRANS("Confirm"));
+      juce::AlertWindow::showAsync(options, [this](int buttonIndex) {
+        if (buttonIndex == 1 && fExportJob) {
+          fExportJob->signalThreadShouldExit();
+        }
+      });
+      return;
+    }
+    ExportDialog::showAsync(this, fExportOptions, this);
+  }
+
+  void exportDialogDidClickOkButton(ExportOptions options) override {
     using namespace juce;
+    fExportOptions = options;
+    if (options.fBackground) {
+      fFileChooser.reset(new FileChooser(TRANS("Choose file name"), File(), "*.png", true));
+      fFileChooser->launchAsync(FileBrowserComponent::FileChooserFlags::saveMode | FileBrowserComponent::FileChooserFlags::warnAboutOverwriting, [this](FileChooser const &chooser) {
+        File file = chooser.getResult();
+        if (file == File()) {
+          return;
+        }
+        startExportJob(file);
+      });
+      return;
+    }
+    std::optional<String> unavailable;
+    {
+      std::lock_guard<std::mutex> lock(fMut);
+      unavailable = unsafeGLCaptureUnavailableReason();
+    }
+    if (unavailable) {
+      auto opt = MessageBoxOptions()
+                     .withButton("OK")
+                     .withIconType(MessageBoxIconType::WarningIcon)
+                     .withTitle(TRANS("Error"))
+                     .withMessage(*unavailable);
+      AlertWindow::showAsync(opt, nullptr);
+      return;
+    }
     fCapturingToImage = true;
     updateCaptureButtonStatus();
 
@@ -1472,14 +2054,139 @@ private:
         return;
       }
 
-      int minX, maxX, minZ, maxZ;
-      viewportRegions(&minX, &minZ, &maxX, &maxZ);
-
-      fSavePngWindow.reset(new SavePNGProgressWindow(this, fGLContext, file, minX, minZ, maxX, maxZ));
-      fSavePngWindow->launchThread();
+      // Keep rendering until every visible region is reloaded at full detail, then startCapture
+      {
+        std::lock_guard<std::mutex> lock(fMut);
+        fCaptureFile = file;
+        fCapturingToImage = false;
+        startLoadingTimer();
+      }
+      triggerRepaint();
     });
   }
 
+  void startCapture() {
+    juce::File file;
+    {
+      std::lock_guard<std::mutex> lock(fMut);
+      if (fCaptureFile == juce::File()) {
+        return;
+      }
+      file = fCaptureFile;
+      fCaptureFile = juce::File();
+      fCapturingToImage = true;
+    }
+
+    int minX, maxX, minZ, maxZ;
+    viewportRegions(&minX, &minZ, &maxX, &maxZ);
+
+    fSavePngWindow.reset(new SavePNGProgressWindow(this, fGLContext, file, fExportOptions.fPNG, minX, minZ, maxX, maxZ));
+    fSavePngWindow->launchThread();
+  }
+
+  void startExportJob(juce::File file) {
+    if (fExportJob || fClosing.get()) {
+      return;
+    }
+    ExportJob::Request request;
+    std::shared_ptr<TileCacheWriter> cacheWriter;
+    {
+      std::lock_guard<std::mutex> lock(fMut);
+      request.fWorldDirectory = fWorldDirectory;
+      request.fEdition = fEdition;
+      request.fDimension = fDimension;
+      if (fExportOptions.fArea == ExportOptions::Area::dimension) {
+        VisibleRegions regions = fVisibleRegions.load();
+        if (regions.getWidth() > 0 && regions.getHeight() > 0) {
+          request.fArea = ExportJob::AreaOfRegions(regions.getX(), regions.getY(), regions.getRight(), regions.getBottom());
+        }
+      } else {
+        // Regions under the viewport. viewportRegions can not be used, it is empty while overview tiles are shown
+        LookAt const lookAt = fLookAt.load();
+        juce::Point<int> const size = fSize.load();
+        auto topLeft = GetMapCoordinateFromView(juce::Point<float>(0, 0), size, lookAt);
+        auto rightBottom = GetMapCoordinateFromView(juce::Point<float>(size.x, size.y), size, lookAt);
+        int const minRx = mcfile::Coordinate::RegionFromBlock((int)floor(topLeft.x));
+        int const minRz = mcfile::Coordinate::RegionFromBlock((int)floor(topLeft.y));
+        int const maxRx = mcfile::Coordinate::RegionFromBlock((int)ceil(rightBottom.x) - 1);
+        int const maxRz = mcfile::Coordinate::RegionFromBlock((int)ceil(rightBottom.y) - 1);
+        request.fArea = ExportJob::AreaOfRegions(minRx, minRz, maxRx, maxRz);
+        // Zoomed out, most of the viewport can be outside of the dimension
+        VisibleRegions regions = fVisibleRegions.load();
+        request.fArea = request.fArea.getIntersection(ExportJob::AreaOfRegions(regions.getX(), regions.getY(), regions.getRight(), regions.getBottom()));
+      }
+      if (auto pool = dynamic_cast<BedrockTexturePackThreadPool *>(fPool.get()); pool) {
+        request.fDb = pool->fDb;
+        request.fDbAttachment = pool->fDbAttachment;
+        request.fLastPlayed = pool->fLastPlayed;
+      }
+      cacheWriter = fCacheWriter;
+    }
+    if (request.fArea.isEmpty()) {
+      return;
+    }
+    if (ExportJob::MemoryUsage(request.fArea, fExportOptions.fScale) > ExportJob::kMaxMemory) {
+      auto opt = juce::MessageBoxOptions()
+                     .withButton("OK")
+                     .withIconType(juce::MessageBoxIconType::WarningIcon)
+                     .withTitle(TRANS("Error"))
+                     .withMessage(TRANS("The area is too wide to export at this scale. Choose a larger scale"));
+      juce::AlertWindow::showAsync(opt, nullptr);
+      return;
+    }
+    request.fFile = file;
+    request.fScale = fExportOptions.fScale;
+    request.fEncode = fExportOptions.fPNG;
+    request.fRender.fDimension = request.fDimension;
+    request.fRender.fPalette = fPaletteType.get();
+    request.fRender.fLighting = fLightingType.get();
+    request.fRender.fWaterOpticalDensity = fWaterOpticalDensity.get();
+    request.fRender.fWaterTranslucent = fWaterTranslucent.get();
+    request.fRender.fBiomeEnabled = fEnableBiome.get();
+    request.fRender.fBiomeBlend = fBiomeBlend.get();
+
+    fExportProgress = 0;
+    fExporting = true;
+    fExportJob.reset(new ExportJob(request, cacheWriter, this));
+    fExportJob->startThread();
+    updateCaptureButtonStatus();
+    repaint();
+  }
+
+  void exportJobFinished(bool completed) {
+    if (!fExportJob) {
+      return;
+    }
+    bool const cancelled = fExportJob->threadShouldExit();
+    fExportJob->stopThread(-1);
+    fExportJob.reset();
+    fExporting = false;
+    updateCaptureButtonStatus();
+    repaint();
+    if (completed || cancelled || fClosing.get()) {
+      return;
+    }
+    auto opt = juce::MessageBoxOptions()
+                   .withButton("OK")
+                   .withIconType(juce::MessageBoxIconType::WarningIcon)
+                   .withTitle(TRANS("Error"))
+                   .withMessage(TRANS("Failed to export image"));
+    juce::AlertWindow::showAsync(opt, nullptr);
+  }
+
+  void renderPathsDiffer(int pixels) {
+    fDelegate->mainViewComponentModernRendererDisabled();
+    if (fClosing.get()) {
+      return;
+    }
+    auto opt = juce::MessageBoxOptions()
+                   .withButton("OK")
+                   .withIconType(juce::MessageBoxIconType::WarningIcon)
+                   .withTitle(TRANS("Error"))
+                   .withMessage(TRANS("The modern renderer drew the map differently from the legacy renderer, and has been turned off") + " (" + juce::String(pixels) + " px)");
+    juce::AlertWindow::showAsync(opt, nullptr);
+  }
+
   LookAt clampLookAt(LookAt l) const {
     VisibleRegions visibleRegions = fVisibleRegions.load();
 
@@ -1533,9 +2240,7 @@ private:
         continue;
       }
       auto region = MakeRegion(r->fX, r->fZ);
-      if (auto found = fTextures.find(region); found == fTextures.end()) {
-        fTextures[region] = std::make_unique<RegionTextureCache>(fWorldDirectory, fDimension, region);
-      }
+      fRegionUpdates.push({fWorldDirectory, fDimension, region});
       visibleRegions.add(r->fX, r->fZ);
 
       if (r->fX < minRx || maxRx < r->fX || r->fZ < minRz || maxRz < r->fZ) {
@@ -1565,7 +2270,15 @@ private:
     viewportRegions(lookAt, size.x, size.y, minRx, minRz, maxRx, maxRz);
   }
 
+  // The range is empty while overview tiles are shown.
   void viewportRegions(LookAt lookAt, int width, int height, int *minRx, int *minRz, int *maxRx, int *maxRz) {
+    if (overviewLevel(lookAt) > 0) {
+      *minRx = 0;
+      *minRz = 0;
+      *maxRx = -1;
+      *maxRz = -1;
+      return;
+    }
     juce::Point<int> size(width, height);
     auto topLeft = GetMapCoordinateFromView(juce::Point<float>(0, 0), size, lookAt);
     auto rightBottom = GetMapCoordinateFromView(juce::Point<float>(size.x, size.y), size, lookAt);
@@ -1576,9 +2289,25 @@ private:
   }
 
   void unsafeInstantiateTextures() {
-    fTextureTrashBin.clear();
+    Trace::Span span("MapViewComponent::unsafeInstantiateTextures");
+    fFinishedJobs.drain([this](auto &&finished) {
+      if (fPool && finished.first == fPool->fGeneration) {
+        fGLJobResults.push_back(finished.second);
+      }
+    });
+
+    // Textures are uploaded nearest first, as many as fit in the time budget shared by overview tiles and regions.
+    // At least one of each per frame, so that loading always progresses
+    double const uploadStart = juce::Time::getMillisecondCounterHiRes();
+    unsafeInstantiateOverview(uploadStart);
 
     LookAt lookAt = fLookAt.load();
+    int const lod = unsafeDesiredLod();
+    int const shadeBlend = shadeBiomeBlend();
+    if (int const planes = shadeBlend >= 0 ? 2 : 1; fResidency.usesTextureArrays() && fResidency.textureArrayPlanes() != planes) {
+      unsafeReleaseTextures();
+      fResidency.setTextureArrayPlanes(planes);
+    }
 
     bool loadingFinished = false;
     bool needsUpdatingCaptureButton = false;
@@ -1592,8 +2321,17 @@ private:
     worldDirectory = fWorldDirectory;
     dimension = fDimension;
 
+    std::map<Region, size_t> latest;
+    for (size_t i = 0; i < fGLJobResults.size(); i++) {
+      latest[fGLJobResults[i]->fRegion] = i;
+    }
+
     for (size_t i = 0; i < fGLJobResults.size(); i++) {
       auto const &result = fGLJobResults[i];
+      if (result->fProvisional && latest[result->fRegion] != i) {
+        remove.push_back(result);
+        continue;
+      }
       if (result->fWorldDirectory != worldDirectory) {
         remove.push_back(result);
         continue;
@@ -1603,8 +2341,11 @@ private:
         continue;
       }
       if (result->fRegion.first < minRx || maxRx < result->fRegion.first || result->fRegion.second < minRz || maxRz < result->fRegion.second) {
-        fLoadingRegions.erase(result->fRegion);
-        needsUpdatingCaptureButton = true;
+        if (!result->fProvisional) {
+          fLoadingRegions.erase(result->fRegion);
+          fReloadingRegions.erase(result->fRegion);
+          needsUpdatingCaptureButton = true;
+        }
         remove.push_back(result);
         continue;
       }
@@ -1616,36 +2357,81 @@ private:
       return a.second < b.second;
     });
 
-    int constexpr kNumLoadTexturesPerFrame = 16;
-    for (int i = 0; i < kNumLoadTexturesPerFrame && i < distances.size(); i++) {
+    for (int i = 0; i < distances.size(); i++) {
+      if (i > 0 && juce::Time::getMillisecondCounterHiRes() - uploadStart > kUploadBudgetMS) {
+        break;
+      }
       std::shared_ptr<TexturePackJob::Result> j = distances[i].first;
       remove.push_back(j);
 
-      auto before = fTextures.find(j->fRegion);
+      RegionTextureCache *before = fTextures.find(j->fRegion);
+      if (j->fProvisional) {
+        // Never replace a complete texture with a partial one
+        if (before && before->isResident() && !before->fProvisional) {
+          continue;
+        }
+        if (fLoadingRegions.count(j->fRegion) == 0) {
+          continue;
+        }
+      }
       if (j->fPixels) {
-        auto cache = std::make_unique<RegionTextureCache>(j->fWorldDirectory, j->fDimension, j->fRegion);
-        cache->load(j->fPixels.get());
-        if (before != fTextures.end()) {
-          cache->fLoadTime = juce::Time::getCurrentTime();
+        auto &cache = fTextures[j->fRegion];
+        if (!cache) {
+          cache = std::make_unique<RegionTextureCache>(j->fWorldDirectory, j->fDimension, j->fRegion);
+        }
+        bool const reloading = fReloadingRegions.count(j->fRegion) > 0 && cache->isResident() && !cache->fProvisional;
+        juce::Time const loadTime = cache->fLoadTime;
+        if (cache->isResident() && cache->fLod != lod) {
+          fResidency.release(*cache);
+        }
+        if (auto array = fResidency.textureArray(lod); array && fGLArrayShader) {
+          if (!cache->load(fUploader, *array, j->pixels(lod), j->shade(lod), j->fShadeBiomeBlend, lod, j->fProvisional)) {
+            // The array is full, fall back to individual textures
+            juce::Logger::writeToLog("Texture array is full, falling back to individual textures");
+            unsafeReleaseTextures();
+            fResidency.setTextureArraysEnabled(false);
+            fGLArrayShader.reset();
+            fGLArrayUniforms.reset();
+            fGLArrayAttributes.reset();
+            fGLArrayVertexArray.release();
+            fGLState.reset();
+          }
+        }
+        if (!fResidency.usesTextureArrays()) {
+          if (!cache->fTexture) {
+            cache->fTexture = fResidency.acquire();
+          }
+          cache->load(fUploader, j->pixels(lod), j->shade(lod), j->fShadeBiomeBlend, lod, j->fProvisional);
+        }
+        if (reloading) {
+          // Same content at another level of detail, no need to fade in again
+          cache->fLoadTime = loadTime;
         }
         cache->fSuccessful = true;
-        fTextures[j->fRegion] = std::move(cache);
+        fResidency.track(*cache);
+        fComposite.invalidate(j->fRegion);
+        if (j->fProvisional) {
+          continue;
+        }
+        fResidentResults[j->fRegion] = j;
       } else {
-        assert(before != fTextures.end());
-        if (before != fTextures.end()) {
-          before->second->fTexture.reset();
-          before->second->fSuccessful = false;
+        fResidentResults.erase(j->fRegion);
+        assert(before);
+        if (before) {
+          fResidency.release(*before);
+          before->fSuccessful = false;
+          fComposite.invalidate();
         }
       }
 
-      auto it = fLoadingRegions.find(j->fRegion);
-      if (it != fLoadingRegions.end()) {
-        fLoadingRegions.erase(it);
-        if (fLoadingRegions.empty()) {
-          loadingFinished = true;
-        }
+      bool const reloaded = fReloadingRegions.erase(j->fRegion) > 0;
+      bool const loaded = fLoadingRegions.erase(j->fRegion) > 0;
+      if (loaded) {
         needsUpdatingCaptureButton = true;
       }
+      if ((loaded || reloaded) && fLoadingRegions.empty() && fReloadingRegions.empty()) {
+        loadingFinished = true;
+      }
     }
     for (auto const &it : remove) {
       for (size_t i = 0; i < fGLJobResults.size(); i++) {
@@ -1655,15 +2441,13 @@ private:
         }
       }
     }
-    for (auto const &it : fTextures) {
-      auto [rx, rz] = it.first;
-      if (rx < minRx || maxRx < rx || rz < minRz || maxRz < rz) {
-        if (it.second->fTexture) {
-          it.second->fTexture.reset();
-          needsUpdatingCaptureButton = true;
-        }
-      }
+    if (fResidency.evict(minRx, minRz, maxRx, maxRz, lookAt) > 0) {
+      needsUpdatingCaptureButton = true;
     }
+    std::erase_if(fResidentResults, [this](auto const &it) {
+      RegionTextureCache *cache = fTextures.find(it.first);
+      return !cache || !cache->isResident();
+    });
     if (fPool) {
       for (int i = fPool->getNumJobs(); i >= 0; i--) {
         if (auto job = dynamic_cast<TexturePackJob *>(fPool->getJob(i)); job && !job->isRunning()) {
@@ -1671,6 +2455,7 @@ private:
           if (rx < minRx || maxRx < rx || rz < minRz || maxRz < rz) {
             if (fPool->removeJob(job, false, 0)) {
               fLoadingRegions.erase(MakeRegion(rx, rz));
+              fReloadingRegions.erase(MakeRegion(rx, rz));
               needsUpdatingCaptureButton = true;
             }
           }
@@ -1680,14 +2465,31 @@ private:
       for (int rx = minRx; rx <= maxRx; rx++) {
         for (int rz = minRz; rz <= maxRz; rz++) {
           auto region = MakeRegion(rx, rz);
-          if (auto found = fTextures.find(region); found != fTextures.end() && !found->second->fTexture && found->second->fSuccessful) {
-            if (fLoadingRegions.count(region) > 0) {
-              continue;
-            }
+          RegionTextureCache *found = fTextures.find(region);
+          if (!found || !found->fSuccessful) {
+            continue;
+          }
+          if (fLoadingRegions.count(region) > 0 || fReloadingRegions.count(region) > 0) {
+            continue;
+          }
+          if (!found->isResident()) {
             fLoadingRegions.insert(region);
             needsUpdatingCaptureButton = true;
             fPool->addTexturePackJob(region, true);
             queued++;
+          } else if (!found->fProvisional && (found->fLod != lod || (shadeBlend >= 0 && found->fShadeBiomeBlend != shadeBlend))) {
+            // Bind the level of detail for the current zoom, or precompute shades for the current biome blend
+            fReloadingRegions.insert(region);
+            if (auto kept = fResidentResults.find(region); kept == fResidentResults.end()) {
+              fPool->addTexturePackJob(region, true);
+            } else if (shadeBlend < 0 || kept->second->fShadeBiomeBlend == shadeBlend) {
+              // Every level is at hand, upload another one without packing the region again
+              fGLJobResults.push_back(kept->second);
+            } else {
+              // Shade the resident pixels again on a worker
+              fPool->addReshadeJob(kept->second);
+            }
+            queued++;
           }
         }
       }
@@ -1697,32 +2499,185 @@ private:
       }
     }
     if (loadingFinished) {
+      // Compare again once the textures of the view are all there, a comparison of an empty map proves nothing
+      if (fModernRenderer.get()) {
+        fCompareRenderPaths = true;
+      }
       callAfterDelay(kFadeDurationMS, [this]() {
-        if (fLoadingRegions.empty()) {
+        bool idle;
+        {
+          std::lock_guard<std::mutex> lock(fMut);
+          idle = fLoadingRegions.empty() && fReloadingRegions.empty() && fLoadingOverviewTiles.empty();
+        }
+        if (idle) {
           stopTimer();
         }
       });
     }
+    if (fCaptureFile != juce::File() && unsafeReadyToCapture(minRx, minRz, maxRx, maxRz)) {
+      unsafeEnqueueAsyncUpdate(AsyncUpdateQueueStartCapture{});
+    }
     if (needsUpdatingCaptureButton) {
       unsafeEnqueueAsyncUpdate(AsyncUpdateQueueUpdateCaptureButtonStatus{});
     }
   }
 
+  void unsafeInstantiateOverview(double uploadStart) {
+    LookAt const lookAt = fLookAt.load();
+    int const level = overviewLevel(lookAt);
+
+    // Visible tiles plus a 1 tile margin
+    int minTx = 0, minTz = 0, maxTx = -1, maxTz = -1;
+    if (level > 0) {
+      juce::Point<int> size = fSize.load();
+      auto topLeft = GetMapCoordinateFromView(juce::Point<float>(0, 0), size, lookAt);
+      auto rightBottom = GetMapCoordinateFromView(juce::Point<float>(size.x, size.y), size, lookAt);
+      OverviewTile const tl = OverviewTile::FromRegion(level, mcfile::Coordinate::RegionFromBlock((int)floor(topLeft.x)), mcfile::Coordinate::RegionFromBlock((int)floor(topLeft.y)));
+      OverviewTile const br = OverviewTile::FromRegion(level, mcfile::Coordinate::RegionFromBlock((int)ceil(rightBottom.x)), mcfile::Coordinate::RegionFromBlock((int)ceil(rightBottom.y)));
+      minTx = tl.fX - 1;
+      minTz = tl.fZ - 1;
+      maxTx = br.fX + 1;
+      maxTz = br.fZ + 1;
+    }
+    auto wanted = [level, minTx, minTz, maxTx, maxTz](OverviewTile const &tile) {
+      return tile.fLevel == level && minTx <= tile.fX && tile.fX <= maxTx && minTz <= tile.fZ && tile.fZ <= maxTz;
+    };
+
+    fFinishedOverviewJobs.drain([this](auto &&finished) {
+      if (fPool && finished.first == fPool->fGeneration) {
+        fGLOverviewResults.push_back(finished.second);
+      }
+    });
+    bool finished = false;
+    std::sort(fGLOverviewResults.begin(), fGLOverviewResults.end(), [lookAt](auto const &a, auto const &b) {
+      return DistanceSqBetweenOverviewTileAndLookAt(lookAt, a->fTile) < DistanceSqBetweenOverviewTileAndLookAt(lookAt, b->fTile);
+    });
+    size_t uploaded = 0;
+    for (; uploaded < fGLOverviewResults.size(); uploaded++) {
+      auto const &result = fGLOverviewResults[uploaded];
+      bool const current = result->fWorldDirectory == fWorldDirectory && result->fDimension == fDimension && wanted(result->fTile);
+      if (current && result->fPixels && uploaded > 0 && juce::Time::getMillisecondCounterHiRes() - uploadStart > kUploadBudgetMS) {
+        break;
+      }
+      if (fLoadingOverviewTiles.erase(result->fTile) > 0 && fLoadingOverviewTiles.empty()) {
+        finished = true;
+      }
+      if (!current) {
+        continue;
+      }
+      std::unique_ptr<juce::OpenGLTexture> texture;
+      if (result->fPixels) {
+        texture = std::make_unique<juce::OpenGLTexture>();
+        fUploader.upload(result->fPixels.get(), 512, [&texture](juce::PixelARGB const *p) {
+          texture->loadARGB(p, 512, 512);
+          TextureUploader::SetNearestFilter();
+        });
+      }
+      fOverviewTextures[result->fTile] = std::move(texture);
+      fComposite.invalidate();
+    }
+    fGLOverviewResults.erase(fGLOverviewResults.begin(), fGLOverviewResults.begin() + uploaded);
+
+    // The number of tiles on screen is bounded at any level, so keep only the wanted ones
+    for (auto it = fOverviewTextures.begin(); it != fOverviewTextures.end();) {
+      if (wanted(it->first)) {
+        it++;
+      } else {
+        it = fOverviewTextures.erase(it);
+        fComposite.invalidate();
+      }
+    }
+
+    if (!fPool) {
+      return;
+    }
+    for (int i = fPool->getNumJobs(); i >= 0; i--) {
+      if (auto job = dynamic_cast<OverviewJob *>(fPool->getJob(i)); job && !job->isRunning() && !wanted(job->fTile)) {
+        if (fPool->removeJob(job, false, 0)) {
+          fLoadingOverviewTiles.erase(job->fTile);
+        }
+      }
+    }
+    VisibleRegions const visible = fVisibleRegions.load();
+    if (level == 0 || visible.getWidth() == 0) {
+      return;
+    }
+    int queued = 0;
+    for (int tz = minTz; tz <= maxTz; tz++) {
+      for (int tx = minTx; tx <= maxTx; tx++) {
+        OverviewTile tile = {level, tx, tz};
+        if (tile.maxRx() < visible.getX() || visible.getRight() < tile.minRx() || tile.maxRz() < visible.getY() || visible.getBottom() < tile.minRz()) {
+          continue;
+        }
+        if (fOverviewTextures.count(tile) > 0 || fLoadingOverviewTiles.count(tile) > 0) {
+          continue;
+        }
+        std::vector<Region> regions;
+        fTextures.forEachIn(tile.minRx(), tile.minRz(), tile.maxRx(), tile.maxRz(), [&regions](Region region, RegionTextureCache const &) {
+          regions.push_back(region);
+        });
+        if (regions.empty()) {
+          continue;
+        }
+        fPool->addOverviewJob(fWorldDirectory, fDimension, tile, regions);
+        fLoadingOverviewTiles.insert(tile);
+        queued++;
+      }
+    }
+    if (queued > 0) {
+      startLoadingTimer();
+    } else if (finished) {
+      callAfterDelay(kFadeDurationMS, [this]() {
+        bool idle;
+        {
+          std::lock_guard<std::mutex> lock(fMut);
+          idle = fLoadingRegions.empty() && fReloadingRegions.empty() && fLoadingOverviewTiles.empty();
+        }
+        if (idle) {
+          stopTimer();
+        }
+      });
+    }
+  }
+
+  bool unsafeReadyToCapture(int minRx, int minRz, int maxRx, int maxRz) const {
+    if (!fLoadingRegions.empty() || !fReloadingRegions.empty()) {
+      return false;
+    }
+    bool ready = true;
+    fTextures.forEachIn(minRx, minRz, maxRx, maxRz, [&ready](Region, RegionTextureCache const &cache) {
+      if (cache.isResident() && cache.fLod != 0) {
+        ready = false;
+      }
+    });
+    return ready;
+  }
+
   void mouseRightClicked(juce::MouseEvent const &e) {
     using namespace juce;
     if (!fWorldDirectory.exists()) {
       return;
     }
-    if (!fShowPin) {
-      return;
-    }
     LookAt current = clampedLookAt();
     Dimension dim = fDimension;
 
     PopupMenu menu;
-    menu.addItem(1, TRANS("Put a pin here"));
+    if (fShowPin) {
+      menu.addItem(1, TRANS("Put a pin here"));
+    }
+    // Hidden unless shift is held, for diagnosing slow loading
+    if (e.mods.isShiftDown()) {
+      menu.addItem(2, Trace::Enabled() ? "Stop tracing and save..." : "Start tracing");
+    }
+    if (menu.getNumItems() == 0) {
+      return;
+    }
     juce::Point<int> pos = e.getScreenPosition();
     menu.showMenuAsync(PopupMenu::Options().withTargetScreenArea(juce::Rectangle<int>(pos, pos)), [this, e, dim, current](int menuId) {
+      if (menuId == 2) {
+        toggleTracing();
+        return;
+      }
       if (menuId != 1) {
         return;
       }
@@ -1738,6 +2693,30 @@ private:
     });
   }
 
+  void toggleTracing() {
+    using namespace juce;
+    if (!Trace::Enabled()) {
+      Trace::SetEnabled(true);
+      return;
+    }
+    Trace::SetEnabled(false);
+    fFileChooser.reset(new FileChooser(TRANS("Choose file name"), File(), "*.json", true));
+    fFileChooser->launchAsync(FileBrowserComponent::FileChooserFlags::saveMode | FileBrowserComponent::FileChooserFlags::warnAboutOverwriting, [](FileChooser const &chooser) {
+      File file = chooser.getResult();
+      if (file == File()) {
+        return;
+      }
+      if (!Trace::Save(file)) {
+        auto opt = MessageBoxOptions()
+                       .withButton("OK")
+                       .withIconType(MessageBoxIconType::WarningIcon)
+                       .withTitle(TRANS("Error"))
+                       .withMessage("Failed to save the trace");
+        AlertWindow::showAsync(opt, nullptr);
+      }
+    });
+  }
+
   void textInputDialogDidClickOkButton(juce::String input, PinEdit edit) override {
     using namespace juce;
     edit.fPin->fMessage = input;
@@ -1886,6 +2865,13 @@ private:
     }
   }
 
+  static float DistanceSqBetweenOverviewTileAndLookAt(LookAt lookAt, OverviewTile tile) {
+    float const size = 512.0f * (1 << tile.fLevel);
+    float const dx = tile.fX * size + size / 2 - lookAt.fX;
+    float const dz = tile.fZ * size + size / 2 - lookAt.fZ;
+    return dx * dx + dz * dz;
+  }
+
   static float DistanceSqBetweenRegionAndLookAt(LookAt lookAt, Region region) {
     float const regionCenterX = region.first * 512 - 256;
     float const regionCenterZ = region.second * 512 - 256;
@@ -1916,12 +2902,33 @@ private:
   std::vector<std::unique_ptr<PinComponent>> fPinComponents;
   bool fShowPin;
 
-  std::map<Region, std::unique_ptr<RegionTextureCache>> fTextures;
-  std::deque<std::unique_ptr<RegionTextureCache>> fTextureTrashBin;
+  // Owned by the GL thread. Other threads add or drop regions through fRegionUpdates
+  RegionGrid<RegionTextureCache> fTextures;
+  // An entry without texture is a tile with no rendered region. Owned by the GL thread
+  std::map<OverviewTile, std::unique_ptr<juce::OpenGLTexture>> fOverviewTextures;
+  std::set<OverviewTile> fLoadingOverviewTiles;
+  std::deque<std::shared_ptr<OverviewJob::Result>> fGLOverviewResults;
+  TextureResidency fResidency;
   std::unique_ptr<juce::OpenGLShaderProgram> fGLShader;
   std::unique_ptr<GLUniforms> fGLUniforms;
   std::unique_ptr<GLAttributes> fGLAttributes;
   std::unique_ptr<GLBuffer> fGLBuffer;
+  std::unique_ptr<juce::OpenGLShaderProgram> fGLArrayShader;
+  std::unique_ptr<GLUniforms> fGLArrayUniforms;
+  std::unique_ptr<GLAttributes> fGLArrayAttributes;
+  std::array<std::vector<GLTileInstance>, RegionToTexture::kMaxLod + 1> fGLTileInstances;
+  std::unique_ptr<juce::OpenGLShaderProgram> fGLCompositeShader;
+  std::unique_ptr<GLUniforms> fGLCompositeUniforms;
+  std::unique_ptr<GLAttributes> fGLCompositeAttributes;
+  MapComposite fComposite;
+  GLTimer fGLTimer;
+  TextureUploader fUploader;
+  GLStateCache fGLState;
+  bool fGLVertexArraysSupported = false;
+  GLVertexArray fGLTileVertexArray;
+  GLVertexArray fGLArrayVertexArray;
+  GLVertexArray fGLCompositeVertexArray;
+  std::vector<RegionTextureCache const *> fGLTileTable;
   std::unique_ptr<juce::OpenGLTexture> fGLPalette;
   std::unique_ptr<juce::OpenGLTexture> fGLPaletteJava;
   std::unique_ptr<juce::OpenGLTexture> fGLPaletteBedrock;
@@ -1937,9 +2944,19 @@ private:
 
   std::unique_ptr<TexturePackThreadPool> fPool;
   std::deque<std::unique_ptr<TexturePackThreadPool>> fPoolTrashBin;
+  std::shared_ptr<TileCacheWriter> fCacheWriter;
   std::deque<std::shared_ptr<TexturePackJob::Result>> fGLJobResults;
+  // Final results of resident regions. They hold every level of detail, so that zooming only changes which one is uploaded. Used on the GL thread only
+  std::map<Region, std::shared_ptr<TexturePackJob::Result>> fResidentResults;
+  // Results tagged with the generation of the pool that made them
+  MPSCQueue<std::pair<uint64_t, std::shared_ptr<TexturePackJob::Result>>> fFinishedJobs;
+  MPSCQueue<std::pair<uint64_t, std::shared_ptr<OverviewJob::Result>>> fFinishedOverviewJobs;
+  std::atomic<bool> fJobsFinished = false;
+  MPSCQueue<RegionUpdate> fRegionUpdates;
 
   std::set<Region> fLoadingRegions;
+  // Resident regions being loaded again at another level of detail
+  std::set<Region> fReloadingRegions;
   std::mutex fMut;
 
   std::unique_ptr<ImageButton> fBrowserOpenButton;
@@ -1972,6 +2989,9 @@ private:
   juce::Atomic<bool> fWaterTranslucent;
   juce::Atomic<bool> fEnableBiome;
   juce::Atomic<int> fBiomeBlend;
+  juce::Atomic<bool> fPrecomputeShading;
+  juce::Atomic<bool> fModernRenderer;
+  std::atomic<bool> fCompareRenderPaths;
   juce::Atomic<PaletteType> fPaletteType;
   juce::Atomic<LightingType> fLightingType;
   std::unique_ptr<juce::FileChooser> fFileChooser;
@@ -1981,7 +3001,15 @@ private:
   std::unique_ptr<TimerInstance> fCloseWatchDogTimer;
   Delegate *const fDelegate;
   juce::Atomic<bool> fCapturingToImage;
+  // Chosen while the visible regions are still being reloaded at full detail. Guarded by fMut
+  juce::File fCaptureFile;
+  // Used on the message thread only
+  ExportOptions fExportOptions;
   std::unique_ptr<SavePNGProgressWindow> fSavePngWindow;
+  // Used on the message thread only
+  std::unique_ptr<ExportJob> fExportJob;
+  juce::Atomic<bool> fExporting;
+  std::atomic<double> fExportProgress = 0;
   std::unique_ptr<TimerInstance> fCaptureButtonEnableTimer;
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MapViewComponent)
@@ -0,0 +1,189 @@
+#pragma once
+
+namespace mcview {
+
+// Node of the overview quadtree. A tile of level n covers 2^n x 2^n regions with a 512x512 texture, merged from its four children of level n - 1.
+// Level 0 is a single region.
+struct OverviewTile {
+  int fLevel;
+  int fX;
+  int fZ;
+
+  int minRx() const {
+    return fX * (1 << fLevel);
+  }
+
+  int minRz() const {
+    return fZ * (1 << fLevel);
+  }
+
+  int maxRx() const {
+    return minRx() + (1 << fLevel) - 1;
+  }
+
+  int maxRz() const {
+    return minRz() + (1 << fLevel) - 1;
+  }
+
+  // 0: north west, 1: north east, 2: south west, 3: south east
+  OverviewTile child(int i) const {
+    return {fLevel - 1, fX * 2 + (i & 1), fZ * 2 + (i >> 1)};
+  }
+
+  bool operator<(OverviewTile const &other) const {
+    return std::tie(fLevel, fX, fZ) < std::tie(other.fLevel, other.fX, other.fZ);
+  }
+
+  bool operator==(OverviewTile const &other) const {
+    return fLevel == other.fLevel && fX == other.fX && fZ == other.fZ;
+  }
+
+  static OverviewTile FromRegion(int level, int rx, int rz) {
+    // Arithmetic shift rounds toward negative infinity
+    return {level, rx >> level, rz >> level};
+  }
+};
+
+// Builds an overview tile from the tile cache. Regions that were never rendered are left empty.
+// Merged tiles are stored in the tile cache too, keyed by a fingerprint of their descendants, so that only changed branches are merged again.
+class OverviewJob : public ThreadPoolJob {
+public:
+  class Result {
+  public:
+    Result(juce::File worldDirectory, Dimension dimension, OverviewTile tile) : fWorldDirectory(worldDirectory), fDimension(dimension), fTile(tile) {}
+
+    juce::File const fWorldDirectory;
+    Dimension const fDimension;
+    OverviewTile const fTile;
+    // nullptr if no region in the tile has been rendered yet
+    std::shared_ptr<juce::PixelARGB[]> fPixels;
+  };
+
+  class Delegate {
+  public:
+    virtual ~Delegate() = default;
+    virtual void overviewJobDidFinish(std::shared_ptr<Result> result) = 0;
+  };
+
+  // regions: regions in the tile known to exist
+  OverviewJob(juce::File worldDirectory, Dimension dim, OverviewTile tile, std::vector<Region> regions, TileCacheWriter *cacheWriter, Delegate *delegate)
+      : ThreadPoolJob(juce::String::formatted("overview.%d.%d.%d", tile.fLevel, tile.fX, tile.fZ)),
+        fTile(tile),
+        fWorldDirectory(worldDirectory),
+        fDimension(dim),
+        fRegions(regions),
+        fCacheWriter(cacheWriter),
+        fDelegate(delegate) {}
+
+  JobStatus runJob() override {
+    auto result = std::make_shared<Result>(fWorldDirectory, fDimension, fTile);
+    defer {
+      fDelegate->overviewJobDidFinish(result);
+    };
+    computeFingerprints();
+    if (auto fingerprint = fingerprintOf(fTile); fingerprint) {
+      bool complete = true;
+      result->fPixels = pixelsOf(fTile, *fingerprint, complete);
+    }
+    return ThreadPoolJob::jobHasFinished;
+  }
+
+private:
+  // Fingerprints of the known regions, then of their ancestors up to fTile one level at a time, so that the work grows with the regions rather than the area
+  void computeFingerprints() {
+    std::map<OverviewTile, std::array<uint64_t, 4>> parents;
+    for (Region region : fRegions) {
+      if (auto fingerprint = TexturePackJob::LoadCacheIndex(fWorldDirectory, fDimension, region); fingerprint) {
+        OverviewTile const tile = OverviewTile::FromRegion(0, region.first, region.second);
+        fFingerprints[tile] = *fingerprint;
+        parents[OverviewTile::FromRegion(1, region.first, region.second)][(region.first & 1) + (region.second & 1) * 2] = *fingerprint;
+      }
+    }
+    for (int level = 1; level <= fTile.fLevel; level++) {
+      std::map<OverviewTile, std::array<uint64_t, 4>> next;
+      for (auto const &[tile, children] : parents) {
+        Fingerprint fp;
+        fp.update(std::string("overview"));
+        fp.update(tile.fLevel);
+        for (uint64_t child : children) {
+          // 0 for empty children
+          fp.update(child);
+        }
+        uint64_t const fingerprint = fp.value();
+        fFingerprints[tile] = fingerprint;
+        next[OverviewTile{level + 1, tile.fX >> 1, tile.fZ >> 1}][(tile.fX & 1) + (tile.fZ & 1) * 2] = fingerprint;
+      }
+      parents.swap(next);
+    }
+  }
+
+  std::optional<uint64_t> fingerprintOf(OverviewTile tile) const {
+    if (auto found = fFingerprints.find(tile); found != fFingerprints.end()) {
+      return found->second;
+    }
+    return std::nullopt;
+  }
+
+  // complete is cleared when a descendant could not be read. Such a tile is delivered, but not stored.
+  std::shared_ptr<juce::PixelARGB[]> pixelsOf(OverviewTile tile, uint64_t fingerprint, bool &complete) {
+    using namespace juce;
+    File file = TexturePackJob::CacheFile(fingerprint);
+    std::shared_ptr<PixelARGB[]> pixels = fCacheWriter->find(file, std::nullopt);
+    if (pixels) {
+      return pixels;
+    }
+    if (file.existsAsFile() && TexturePackJob::LoadCache(pixels, std::nullopt, file)) {
+      return pixels;
+    }
+    if (tile.fLevel == 0) {
+      // Indexed, but the tile itself is gone or not written yet
+      complete = false;
+      return nullptr;
+    }
+
+    pixels.reset(new PixelARGB[512 * 512]);
+    std::fill_n(pixels.get(), 512 * 512, PixelARGB(0, 0, 0, 0));
+    for (int i = 0; i < 4; i++) {
+      if (shouldExit()) {
+        complete = false;
+        return nullptr;
+      }
+      OverviewTile child = tile.child(i);
+      auto childFingerprint = fingerprintOf(child);
+      if (!childFingerprint) {
+        continue;
+      }
+      bool childComplete = true;
+      auto childPixels = pixelsOf(child, *childFingerprint, childComplete);
+      if (!childComplete) {
+        complete = false;
+      }
+      if (!childPixels) {
+        continue;
+      }
+      std::unique_ptr<PixelARGB[]> reduced(RegionToTexture::Downsample(childPixels.get(), 512));
+      int const x0 = (i & 1) * 256;
+      int const z0 = (i >> 1) * 256;
+      for (int z = 0; z < 256; z++) {
+        std::copy_n(reduced.get() + z * 256, 256, pixels.get() + (z0 + z) * 512 + x0);
+      }
+    }
+    if (complete) {
+      fCacheWriter->enqueue(pixels, 0, file);
+    }
+    return pixels;
+  }
+
+public:
+  OverviewTile const fTile;
+
+private:
+  juce::File const fWorldDirectory;
+  Dimension const fDimension;
+  std::vector<Region> const fRegions;
+  TileCacheWriter *const fCacheWriter;
+  Delegate *const fDelegate;
+  std::map<OverviewTile, uint64_t> fFingerprints;
+};
+
+} // namespace mcview
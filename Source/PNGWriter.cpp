@@ -2,7 +2,13 @@
 // See "#if 0 // begin mcview customization" preprocessor
 #include <juce_gui_basics/juce_gui_basics.h>
 
+#include <condition_variable>
+#include <span>
+#include <thread>
+
 #include "PNGWriter.hpp"
+#include "ParallelFor.hpp"
+#include "PixelConversion.hpp"
 
 /*
   ==============================================================================
@@ -635,8 +641,8 @@ using namespace juce;
 
 namespace mcview {
 
-PNGWriter::PNGWriter(int width, int height, OutputStream &stream)
-    : fStream(stream), fWidth(width), fWriteStruct(nullptr), fInfoStruct(nullptr), fRowData(width * 4) {
+PNGWriter::PNGWriter(int width, int height, OutputStream &stream, PNGFilterHeuristic filter)
+    : fStream(stream), fWidth(width), fHeight(height), fRowsWritten(0), fWriteStruct(nullptr), fInfoStruct(nullptr), fRowData(width * 4) {
   using namespace pnglibNamespace;
 
   auto pngWriteStruct = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
@@ -669,10 +675,29 @@ PNGWriter::PNGWriter(int width, int height, OutputStream &stream)
   sig_bit.alpha = 8;
   png_set_sBIT(pngWriteStruct, pngInfoStruct, &sig_bit);
 
+  int filters = PNG_ALL_FILTERS;
+  switch (filter) {
+  case PNGFilterHeuristic::fast:
+    filters = PNG_FILTER_NONE | PNG_FILTER_SUB | PNG_FILTER_UP;
+    break;
+  case PNGFilterHeuristic::none:
+    filters = PNG_FILTER_NONE;
+    break;
+  case PNGFilterHeuristic::up:
+    filters = PNG_FILTER_UP;
+    break;
+  case PNGFilterHeuristic::paeth:
+    filters = PNG_FILTER_PAETH;
+    break;
+  case PNGFilterHeuristic::adaptive:
+  default:
+    break;
+  }
+  png_set_filter(pngWriteStruct, PNG_FILTER_TYPE_BASE, filters);
+
   png_write_info(pngWriteStruct, pngInfoStruct);
 
-  png_set_shift(pngWriteStruct, &sig_bit);
-  png_set_packing(pngWriteStruct);
+  // Rows are already 8 bit RGBA, so no png_set_shift or png_set_packing: they only add a pass over every row
 }
 
 PNGWriter::~PNGWriter() {
@@ -683,28 +708,295 @@ PNGWriter::~PNGWriter() {
 
   png_structrp pngWriteStruct = (png_structrp)fWriteStruct;
   png_infop pngInfoStruct = (png_infop)fInfoStruct;
-  png_write_end(pngWriteStruct, pngInfoStruct);
+  // libpng raises an error when an image ends with rows missing, and aborts as there is no error handler. Callers discard a cancelled image
+  if (fRowsWritten == fHeight) {
+    png_write_end(pngWriteStruct, pngInfoStruct);
+  }
   png_destroy_write_struct(&pngWriteStruct, &pngInfoStruct);
 }
 
 void PNGWriter::writeRow(PixelARGB *row) {
   using namespace pnglibNamespace;
 
-  uint8 *dst = fRowData;
-
-  for (int i = fWidth; --i >= 0;) {
-    PixelARGB p = row[fWidth - i - 1];
-    p.unpremultiply();
-
-    *dst++ = p.getRed();
-    *dst++ = p.getGreen();
-    *dst++ = p.getBlue();
-    *dst++ = p.getAlpha();
-  }
+  PixelConversion::UnpremultiplyRow(row, fWidth, fRowData);
 
   png_bytep rowPtr = fRowData;
   png_structp pngWriteStruct = (png_structp)fWriteStruct;
   png_write_rows(pngWriteStruct, &rowPtr, 1);
+  fRowsWritten++;
+}
+
+ParallelPNGWriter::ParallelPNGWriter(int width, int height, OutputStream &stream, int compressionLevel, PNGFilterHeuristic filter, int numThreads)
+    : fStream(stream),
+      fWidth(width),
+      fHeight(height),
+      fCompressionLevel(std::clamp(compressionLevel, PNGEncodeOptions::kMinCompressionLevel, PNGEncodeOptions::kMaxCompressionLevel)),
+      fFilter(filter),
+      fPool(std::make_unique<ParallelForPool>((std::max)(1, numThreads))),
+      fRowsWritten(0),
+      fAdler(1) {
+  static uint8 const kSignature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+  fStream.write(kSignature, sizeof(kSignature));
+
+  MemoryOutputStream ihdr;
+  ihdr.writeIntBigEndian(width);
+  ihdr.writeIntBigEndian(height);
+  ihdr.writeByte(8); // bit depth
+  ihdr.writeByte(6); // RGBA
+  ihdr.writeByte(0); // deflate
+  ihdr.writeByte(0); // adaptive filtering
+  ihdr.writeByte(0); // no interlace
+  auto ihdrData = static_cast<uint8 const *>(ihdr.getData());
+  writeChunk("IHDR", ihdrData, ihdr.getDataSize(), ChunkCrc("IHDR", ihdrData, ihdr.getDataSize()));
+
+  uint8 const sbit[4] = {8, 8, 8, 8};
+  writeChunk("sBIT", sbit, sizeof(sbit), ChunkCrc("sBIT", sbit, sizeof(sbit)));
+
+  // The row before the first one is all zero when filtering
+  fRaw.assign((size_t)width * 4, 0);
+}
+
+ParallelPNGWriter::~ParallelPNGWriter() {
+  if (fRowsWritten < fHeight) {
+    // Cancelled. The zlib stream was never finished, so there is nothing valid to close. The caller discards the file
+    return;
+  }
+  writeChunk("IEND", nullptr, 0, ChunkCrc("IEND", nullptr, 0));
+}
+
+void ParallelPNGWriter::writeRows(PixelARGB const *rows, int numRows) {
+  using namespace zlibNamespace;
+
+  numRows = (std::min)(numRows, fHeight - fRowsWritten);
+  if (numRows <= 0) {
+    return;
+  }
+  size_t const rowBytes = (size_t)fWidth * 4;
+  size_t const filteredRowBytes = rowBytes + 1;
+  bool const first = fRowsWritten == 0;
+  bool const last = fRowsWritten + numRows == fHeight;
+
+  fRaw.resize((numRows + 1) * rowBytes);
+  fFiltered.resize(numRows * filteredRowBytes);
+
+  int const rowsPerBand = (std::max)(1, (int)(kBandSize / filteredRowBytes));
+  int const numBands = (numRows + rowsPerBand - 1) / rowsPerBand;
+  fBands.resize(numBands);
+  for (int i = 0; i < numBands; i++) {
+    fBands[i].fBegin = i * rowsPerBand;
+    fBands[i].fEnd = (std::min)(numRows, (i + 1) * rowsPerBand);
+    fBands[i].fOutput.clear();
+  }
+
+  fPool->run(numBands, [this, rows, rowBytes](int i) {
+    for (int y = fBands[i].fBegin; y < fBands[i].fEnd; y++) {
+      PixelConversion::UnpremultiplyRow(rows + (size_t)y * fWidth, fWidth, fRaw.data() + (y + 1) * rowBytes);
+    }
+  });
+  fPool->run(numBands, [this](int i) {
+    filterBand(fBands[i]);
+  });
+  fPool->run(numBands, [this, first, last, numBands](int i) {
+    deflateBand(fBands[i], first && i == 0, last && i + 1 == numBands);
+  });
+
+  for (auto const &band : fBands) {
+    fAdler = (uint32)adler32_combine(fAdler, band.fAdler, (z_off_t)((band.fEnd - band.fBegin) * filteredRowBytes));
+  }
+  if (last) {
+    Band &band = fBands.back();
+    uint8 const trailer[4] = {(uint8)(fAdler >> 24), (uint8)(fAdler >> 16), (uint8)(fAdler >> 8), (uint8)fAdler};
+    band.fOutput.insert(band.fOutput.end(), trailer, trailer + 4);
+    band.fCrc = (uint32)crc32_combine(band.fCrc, crc32(0, trailer, 4), 4);
+  }
+  for (auto const &band : fBands) {
+    writeChunk("IDAT", band.fOutput.data(), band.fOutput.size(), band.fCrc);
+  }
+
+  std::copy_n(fRaw.data() + numRows * rowBytes, rowBytes, fRaw.data());
+  size_t const window = 1 << 15;
+  size_t const tail = (std::min)(window, fFiltered.size());
+  fDictionary.insert(fDictionary.end(), fFiltered.end() - tail, fFiltered.end());
+  if (fDictionary.size() > window) {
+    fDictionary.erase(fDictionary.begin(), fDictionary.end() - window);
+  }
+  fRowsWritten += numRows;
+}
+
+void ParallelPNGWriter::filterBand(Band const &band) {
+  size_t const rowBytes = (size_t)fWidth * 4;
+  for (int y = band.fBegin; y < band.fEnd; y++) {
+    FilterRow(fRaw.data() + y * rowBytes, fRaw.data() + (y + 1) * rowBytes, rowBytes, fFilter, fFiltered.data() + y * (rowBytes + 1));
+  }
+}
+
+void ParallelPNGWriter::deflateBand(Band &band, bool first, bool last) {
+  using namespace zlibNamespace;
+
+  size_t const filteredRowBytes = (size_t)fWidth * 4 + 1;
+  size_t const offset = band.fBegin * filteredRowBytes;
+  size_t const size = (band.fEnd - band.fBegin) * filteredRowBytes;
+  uint8 const *data = fFiltered.data() + offset;
+  band.fAdler = (uint32)adler32(1, data, (uInt)size);
+
+  if (first) {
+    // zlib header: deflate with 32KB window, and the compression level hint
+    uint8 const cmf = 0x78;
+    int const level = fCompressionLevel < 2 ? 0 : fCompressionLevel < 6 ? 1 : fCompressionLevel == 6 ? 2 : 3;
+    int flg = level << 6;
+    flg += 31 - ((cmf << 8) | flg) % 31;
+    band.fOutput.push_back(cmf);
+    band.fOutput.push_back((uint8)flg);
+  }
+
+  z_stream stream;
+  zeromem(&stream, sizeof(stream));
+  if (deflateInit2(&stream, fCompressionLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    jassertfalse;
+    return;
+  }
+
+  // Prime with the 32KB preceding the band, which may reach back into the previous call
+  size_t const window = 1 << 15;
+  if (offset >= window) {
+    deflateSetDictionary(&stream, data - window, (uInt)window);
+  } else if (offset + fDictionary.size() > 0) {
+    std::vector<uint8> dictionary;
+    size_t const carried = (std::min)(window - offset, fDictionary.size());
+    dictionary.insert(dictionary.end(), fDictionary.end() - carried, fDictionary.end());
+    dictionary.insert(dictionary.end(), fFiltered.begin(), fFiltered.begin() + offset);
+    deflateSetDictionary(&stream, dictionary.data(), (uInt)dictionary.size());
+  }
+
+  size_t const header = band.fOutput.size();
+  // deflateBound does not count the empty stored block of a sync flush
+  band.fOutput.resize(header + deflateBound(&stream, (uLong)size) + 16);
+  stream.next_in = const_cast<Bytef *>(data);
+  stream.avail_in = (uInt)size;
+  stream.next_out = band.fOutput.data() + header;
+  stream.avail_out = (uInt)(band.fOutput.size() - header);
+
+  int const flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+  while (true) {
+    int const ret = deflate(&stream, flush);
+    if (ret == Z_STREAM_ERROR) {
+      jassertfalse;
+      break;
+    }
+    if (last ? ret == Z_STREAM_END : stream.avail_out > 0) {
+      break;
+    }
+    size_t const used = stream.next_out - band.fOutput.data();
+    band.fOutput.resize(band.fOutput.size() * 2);
+    stream.next_out = band.fOutput.data() + used;
+    stream.avail_out = (uInt)(band.fOutput.size() - used);
+  }
+  band.fOutput.resize(stream.next_out - band.fOutput.data());
+  deflateEnd(&stream);
+
+  band.fCrc = ChunkCrc("IDAT", band.fOutput.data(), band.fOutput.size());
+}
+
+void ParallelPNGWriter::writeChunk(char const *type, uint8 const *data, size_t size, uint32 crc) {
+  fStream.writeIntBigEndian((int)size);
+  fStream.write(type, 4);
+  if (size > 0) {
+    fStream.write(data, size);
+  }
+  fStream.writeIntBigEndian((int)crc);
+}
+
+template <int Filter>
+static uint8 FilteredByte(uint8 const *prev, uint8 const *row, size_t i) {
+  int const a = i >= 4 ? row[i - 4] : 0;
+  int const b = prev[i];
+  int const c = i >= 4 ? prev[i - 4] : 0;
+  int predicted = 0;
+  if constexpr (Filter == 1) {
+    predicted = a;
+  } else if constexpr (Filter == 2) {
+    predicted = b;
+  } else if constexpr (Filter == 3) {
+    predicted = (a + b) / 2;
+  } else if constexpr (Filter == 4) {
+    int const p = a + b - c;
+    int const pa = std::abs(p - a);
+    int const pb = std::abs(p - b);
+    int const pc = std::abs(p - c);
+    predicted = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+  }
+  return (uint8)(row[i] - predicted);
+}
+
+// Sum of the filtered bytes taken as signed, or any value not less than limit once it is exceeded
+template <int Filter>
+static uint64 FilteredSum(uint8 const *prev, uint8 const *row, size_t rowBytes, uint64 limit) {
+  uint64 sum = 0;
+  for (size_t i = 0; i < rowBytes; i++) {
+    uint8 const d = FilteredByte<Filter>(prev, row, i);
+    sum += d < 128 ? d : 256 - d;
+    if ((i & 63) == 63 && sum >= limit) {
+      break;
+    }
+  }
+  return sum;
+}
+
+template <int Filter>
+static void ApplyFilter(uint8 const *prev, uint8 const *row, size_t rowBytes, uint8 *out) {
+  out[0] = (uint8)Filter;
+  for (size_t i = 0; i < rowBytes; i++) {
+    out[i + 1] = FilteredByte<Filter>(prev, row, i);
+  }
+}
+
+void ParallelPNGWriter::FilterRow(uint8 const *prev, uint8 const *row, size_t rowBytes, PNGFilterHeuristic heuristic, uint8 *out) {
+  static uint64 (*const sums[5])(uint8 const *, uint8 const *, size_t, uint64) = {FilteredSum<0>, FilteredSum<1>, FilteredSum<2>, FilteredSum<3>, FilteredSum<4>};
+  static void (*const filters[5])(uint8 const *, uint8 const *, size_t, uint8 *) = {ApplyFilter<0>, ApplyFilter<1>, ApplyFilter<2>, ApplyFilter<3>, ApplyFilter<4>};
+  static int const kAdaptive[] = {0, 1, 2, 3, 4};
+  static int const kFast[] = {2, 1, 0};
+
+  std::span<int const> candidates = kAdaptive;
+  switch (heuristic) {
+  case PNGFilterHeuristic::none:
+    filters[0](prev, row, rowBytes, out);
+    return;
+  case PNGFilterHeuristic::up:
+    filters[2](prev, row, rowBytes, out);
+    return;
+  case PNGFilterHeuristic::paeth:
+    filters[4](prev, row, rowBytes, out);
+    return;
+  case PNGFilterHeuristic::fast:
+    candidates = kFast;
+    break;
+  case PNGFilterHeuristic::adaptive:
+  default:
+    break;
+  }
+
+  int best = 0;
+  uint64 bestSum = std::numeric_limits<uint64>::max();
+  for (int filter : candidates) {
+    uint64 const sum = sums[filter](prev, row, rowBytes, bestSum);
+    if (sum < bestSum) {
+      best = filter;
+      bestSum = sum;
+    }
+    if (bestSum == 0 && heuristic == PNGFilterHeuristic::fast) {
+      break;
+    }
+  }
+  filters[best](prev, row, rowBytes, out);
+}
+
+uint32 ParallelPNGWriter::ChunkCrc(char const *type, uint8 const *data, size_t size) {
+  using namespace zlibNamespace;
+  uLong crc = crc32(0, reinterpret_cast<Bytef const *>(type), 4);
+  if (size > 0) {
+    crc = crc32(crc, data, (uInt)size);
+  }
+  return (uint32)crc;
 }
 
 } // namespace mcview
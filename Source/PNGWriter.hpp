@@ -2,9 +2,34 @@
 
 namespace mcview {
 
+class ParallelForPool;
+
+// How the filter of each row is chosen
+enum class PNGFilterHeuristic {
+  // Tries all five filters and keeps the one with the smallest sum of absolute values, as libpng does. Smallest output
+  adaptive,
+  // Tries Up, Sub and None in that order, and stops at the first one that zeroes the row. Flat rows of a map are filtered almost for free
+  fast,
+  none,
+  up,
+  paeth,
+};
+
+struct PNGEncodeOptions {
+  static int constexpr kMinCompressionLevel = 0;
+  static int constexpr kMaxCompressionLevel = 9;
+  static int constexpr kDefaultCompressionLevel = 6;
+
+  // Encode with ParallelPNGWriter instead of PNGWriter
+  bool fParallel = true;
+  // zlib level of ParallelPNGWriter. PNGWriter always uses the libpng default
+  int fCompressionLevel = kDefaultCompressionLevel;
+  PNGFilterHeuristic fFilter = PNGFilterHeuristic::adaptive;
+};
+
 class PNGWriter {
 public:
-  PNGWriter(int width, int height, juce::OutputStream &stream);
+  PNGWriter(int width, int height, juce::OutputStream &stream, PNGFilterHeuristic filter);
   ~PNGWriter();
 
   void writeRow(juce::PixelARGB *row);
@@ -12,9 +37,63 @@ public:
 private:
   juce::OutputStream &fStream;
   int fWidth;
+  int fHeight;
+  int fRowsWritten;
   void *fWriteStruct;
   void *fInfoStruct;
   juce::HeapBlock<juce::uint8> fRowData;
 };
 
+// Encodes a PNG on several threads, the way pigz does for gzip.
+// Rows are split into bands that are filtered and deflated independently. Each band is primed with the last 32KB of data before it and ends with a sync flush,
+// so the raw deflate streams concatenate into one zlib stream. Every band becomes one IDAT chunk, and the Adler-32 of the stream is combined from the bands.
+// An image destroyed before its last row has no IEND chunk, so callers write through a juce::TemporaryFile and keep it only when complete.
+class ParallelPNGWriter {
+public:
+  ParallelPNGWriter(int width, int height, juce::OutputStream &stream, int compressionLevel, PNGFilterHeuristic filter, int numThreads);
+  ~ParallelPNGWriter();
+
+  // rows: numRows rows of width pixels each, top to bottom
+  void writeRows(juce::PixelARGB const *rows, int numRows);
+
+  // Uncompressed bytes per band, the block size of pigz
+  static size_t constexpr kBandSize = 128 * 1024;
+
+  // Filters one row of rowBytes bytes into out, which takes rowBytes + 1 bytes with the filter type first. prev is the row above, all zero for the first row
+  static void FilterRow(juce::uint8 const *prev, juce::uint8 const *row, size_t rowBytes, PNGFilterHeuristic heuristic, juce::uint8 *out);
+
+private:
+  struct Band {
+    int fBegin;
+    int fEnd;
+    std::vector<juce::uint8> fOutput;
+    juce::uint32 fAdler;
+    juce::uint32 fCrc;
+  };
+
+  void filterBand(Band const &band);
+  void deflateBand(Band &band, bool first, bool last);
+  void writeChunk(char const *type, juce::uint8 const *data, size_t size, juce::uint32 crc);
+
+  static juce::uint32 ChunkCrc(char const *type, juce::uint8 const *data, size_t size);
+
+private:
+  juce::OutputStream &fStream;
+  int const fWidth;
+  int const fHeight;
+  int const fCompressionLevel;
+  PNGFilterHeuristic const fFilter;
+  std::unique_ptr<ParallelForPool> fPool;
+  int fRowsWritten;
+  juce::uint32 fAdler;
+  // Unpremultiplied rows of the current call, preceded by the last row of the previous call
+  std::vector<juce::uint8> fRaw;
+  std::vector<juce::uint8> fFiltered;
+  // Tail of the filtered data of previous calls, up to the deflate window size
+  std::vector<juce::uint8> fDictionary;
+  std::vector<Band> fBands;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParallelPNGWriter)
+};
+
 } // namespace mcview
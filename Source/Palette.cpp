@@ -10,6 +10,7 @@
 #include "Dimension.hpp"
 #include "File.hpp"
 #include "Palette.hpp"
+#include "Trace.hpp"
 #include "ThreadPool.hpp"
 #include "RegionToTexture.hpp"
 // clang-format on
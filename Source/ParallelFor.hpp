@@ -0,0 +1,110 @@
+#pragma once
+
+namespace mcview {
+
+// Calls fn(i) for every i in [0, count) on up to numThreads threads, including the calling one, and returns when all calls are done
+static inline void ParallelFor(int count, int numThreads, std::function<void(int)> const &fn) {
+  std::atomic<int> next = 0;
+  auto worker = [&next, count, &fn]() {
+    for (int i = next++; i < count; i = next++) {
+      fn(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < (std::min)(numThreads, count); i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+// Threads kept across calls, for loops too short to pay for starting threads each time. run has the semantics of ParallelFor
+class ParallelForPool {
+public:
+  explicit ParallelForPool(int numThreads) {
+    for (int i = 1; i < numThreads; i++) {
+      fThreads.emplace_back([this]() { loop(); });
+    }
+  }
+
+  ~ParallelForPool() {
+    {
+      std::lock_guard<std::mutex> lock(fMut);
+      fExit = true;
+    }
+    fStart.notify_all();
+    for (auto &thread : fThreads) {
+      thread.join();
+    }
+  }
+
+  void run(int count, std::function<void(int)> const &fn) {
+    if (fThreads.empty() || count <= 1) {
+      for (int i = 0; i < count; i++) {
+        fn(i);
+      }
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(fMut);
+      fFn = &fn;
+      fCount = count;
+      fNext = 0;
+      fPending = (int)fThreads.size();
+      fGeneration++;
+    }
+    fStart.notify_all();
+    for (int i = fNext++; i < count; i = fNext++) {
+      fn(i);
+    }
+    std::unique_lock<std::mutex> lock(fMut);
+    fDone.wait(lock, [this]() { return fPending == 0; });
+    fFn = nullptr;
+  }
+
+private:
+  void loop() {
+    uint64_t seen = 0;
+    while (true) {
+      std::function<void(int)> const *fn = nullptr;
+      int count = 0;
+      {
+        std::unique_lock<std::mutex> lock(fMut);
+        fStart.wait(lock, [this, seen]() { return fExit || fGeneration != seen; });
+        if (fExit) {
+          return;
+        }
+        seen = fGeneration;
+        fn = fFn;
+        count = fCount;
+      }
+      for (int i = fNext++; i < count; i = fNext++) {
+        (*fn)(i);
+      }
+      {
+        std::lock_guard<std::mutex> lock(fMut);
+        fPending--;
+      }
+      fDone.notify_one();
+    }
+  }
+
+private:
+  std::vector<std::thread> fThreads;
+  std::mutex fMut;
+  std::condition_variable fStart;
+  std::condition_variable fDone;
+  std::atomic<int> fNext = 0;
+  // Guarded by fMut
+  std::function<void(int)> const *fFn = nullptr;
+  int fCount = 0;
+  int fPending = 0;
+  uint64_t fGeneration = 0;
+  bool fExit = false;
+
+  JUCE_DECLARE_NON_COPYABLE(ParallelForPool)
+};
+
+} // namespace mcview
@@ -0,0 +1,127 @@
+#pragma once
+
+#if JUCE_INTEL
+#include <immintrin.h>
+#elif JUCE_ARM && JUCE_64BIT
+#include <arm_neon.h>
+#endif
+
+#if JUCE_INTEL && (JUCE_CLANG || JUCE_GCC)
+#define MCVIEW_TARGET(isa) __attribute__((target(isa)))
+#else
+#define MCVIEW_TARGET(isa)
+#endif
+
+namespace mcview {
+
+// Converts rows of premultiplied PixelARGB into the straight RGBA bytes of a PNG.
+// Opaque and fully transparent pixels, which make up nearly all of a map, are swizzled in vectors. A vector holding a translucent pixel is converted
+// by the scalar path, so that the output is the same on every instruction set.
+class PixelConversion {
+public:
+  static void UnpremultiplyRow(juce::PixelARGB const *row, int width, juce::uint8 *dst) {
+    static Kernel const kernel = SelectKernel();
+    kernel(row, width, dst);
+  }
+
+  static void UnpremultiplyRowScalar(juce::PixelARGB const *row, int width, juce::uint8 *dst) {
+    for (int i = 0; i < width; i++) {
+      juce::PixelARGB p = row[i];
+      p.unpremultiply();
+
+      *dst++ = p.getRed();
+      *dst++ = p.getGreen();
+      *dst++ = p.getBlue();
+      *dst++ = p.getAlpha();
+    }
+  }
+
+private:
+  using Kernel = void (*)(juce::PixelARGB const *, int, juce::uint8 *);
+
+  static Kernel SelectKernel() {
+#if JUCE_LITTLE_ENDIAN
+#if JUCE_INTEL
+    if (juce::SystemStats::hasAVX2()) {
+      return UnpremultiplyRowAVX2;
+    }
+    if (juce::SystemStats::hasSSE41()) {
+      return UnpremultiplyRowSSE41;
+    }
+#elif JUCE_ARM && JUCE_64BIT
+    return UnpremultiplyRowNEON;
+#endif
+#endif
+    return UnpremultiplyRowScalar;
+  }
+
+#if JUCE_INTEL
+  MCVIEW_TARGET("sse4.1")
+  static void UnpremultiplyRowSSE41(juce::PixelARGB const *row, int width, juce::uint8 *dst) {
+    __m128i const alphaMask = _mm_set1_epi32((int)0xff000000);
+    __m128i const zero = _mm_setzero_si128();
+    // BGRA to RGBA
+    __m128i const swizzle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(row + x));
+      __m128i const alpha = _mm_and_si128(v, alphaMask);
+      __m128i const transparent = _mm_cmpeq_epi32(alpha, zero);
+      __m128i const opaque = _mm_cmpeq_epi32(alpha, alphaMask);
+      if (!_mm_test_all_ones(_mm_or_si128(opaque, transparent))) {
+        UnpremultiplyRowScalar(row + x, 4, dst + x * 4);
+        continue;
+      }
+      v = _mm_andnot_si128(transparent, v);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), _mm_shuffle_epi8(v, swizzle));
+    }
+    UnpremultiplyRowScalar(row + x, width - x, dst + x * 4);
+  }
+
+  MCVIEW_TARGET("avx2")
+  static void UnpremultiplyRowAVX2(juce::PixelARGB const *row, int width, juce::uint8 *dst) {
+    __m256i const alphaMask = _mm256_set1_epi32((int)0xff000000);
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i const ones = _mm256_set1_epi32(-1);
+    // vpshufb works within each 128 bit lane, so the same mask is repeated
+    __m256i const swizzle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                             2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(row + x));
+      __m256i const alpha = _mm256_and_si256(v, alphaMask);
+      __m256i const transparent = _mm256_cmpeq_epi32(alpha, zero);
+      __m256i const opaque = _mm256_cmpeq_epi32(alpha, alphaMask);
+      if (!_mm256_testc_si256(_mm256_or_si256(opaque, transparent), ones)) {
+        UnpremultiplyRowScalar(row + x, 8, dst + x * 4);
+        continue;
+      }
+      v = _mm256_andnot_si256(transparent, v);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 4), _mm256_shuffle_epi8(v, swizzle));
+    }
+    UnpremultiplyRowScalar(row + x, width - x, dst + x * 4);
+  }
+#elif JUCE_ARM && JUCE_64BIT
+  static void UnpremultiplyRowNEON(juce::PixelARGB const *row, int width, juce::uint8 *dst) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+      uint8x16x4_t const bgra = vld4q_u8(reinterpret_cast<uint8_t const *>(row + x));
+      uint8x16_t const transparent = vceqq_u8(bgra.val[3], vdupq_n_u8(0));
+      uint8x16_t const opaque = vceqq_u8(bgra.val[3], vdupq_n_u8(0xff));
+      if (vminvq_u8(vorrq_u8(opaque, transparent)) != 0xff) {
+        UnpremultiplyRowScalar(row + x, 16, dst + x * 4);
+        continue;
+      }
+      uint8x16x4_t rgba;
+      rgba.val[0] = vbicq_u8(bgra.val[2], transparent);
+      rgba.val[1] = vbicq_u8(bgra.val[1], transparent);
+      rgba.val[2] = vbicq_u8(bgra.val[0], transparent);
+      rgba.val[3] = bgra.val[3];
+      vst4q_u8(dst + x * 4, rgba);
+    }
+    UnpremultiplyRowScalar(row + x, width - x, dst + x * 4);
+  }
+#endif
+};
+
+} // namespace mcview
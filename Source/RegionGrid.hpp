@@ -0,0 +1,101 @@
+#pragma once
+
+namespace mcview {
+
+// Sparse 2D grid of regions, stored as dense chunks of kChunkSize x kChunkSize slots.
+// Lookups are O(1), and visiting a rectangle costs the number of slots and chunks it covers, regardless of how many regions the grid holds.
+template <class T>
+class RegionGrid {
+public:
+  static int constexpr kChunkBits = 5;
+  static int constexpr kChunkSize = 1 << kChunkBits;
+
+  RegionGrid() = default;
+
+  T *find(Region region) const {
+    auto found = fChunks.find(ChunkKey(region.first >> kChunkBits, region.second >> kChunkBits));
+    if (found == fChunks.end()) {
+      return nullptr;
+    }
+    return found->second->fSlots[SlotIndex(region)].get();
+  }
+
+  bool contains(Region region) const {
+    return find(region) != nullptr;
+  }
+
+  // Slot of the region, empty if it has not been set yet
+  std::unique_ptr<T> &operator[](Region region) {
+    auto &chunk = fChunks[ChunkKey(region.first >> kChunkBits, region.second >> kChunkBits)];
+    if (!chunk) {
+      chunk = std::make_unique<Chunk>();
+    }
+    return chunk->fSlots[SlotIndex(region)];
+  }
+
+  // fn(Region, T &) for every region in the grid
+  template <class Fn>
+  void forEach(Fn &&fn) const {
+    for (auto const &it : fChunks) {
+      int const cx = (int)(int32_t)(uint32_t)(it.first >> 32);
+      int const cz = (int)(int32_t)(uint32_t)it.first;
+      auto const &slots = it.second->fSlots;
+      for (int i = 0; i < kChunkSize * kChunkSize; i++) {
+        if (slots[i]) {
+          fn(MakeRegion(cx * kChunkSize + (i & (kChunkSize - 1)), cz * kChunkSize + (i >> kChunkBits)), *slots[i]);
+        }
+      }
+    }
+  }
+
+  // fn(Region, T &) for every region in the grid within [minRx, maxRx] x [minRz, maxRz], in row major order
+  template <class Fn>
+  void forEachIn(int minRx, int minRz, int maxRx, int maxRz, Fn &&fn) const {
+    if (maxRx < minRx || maxRz < minRz) {
+      return;
+    }
+    for (int cz = minRz >> kChunkBits; cz <= (maxRz >> kChunkBits); cz++) {
+      for (int cx = minRx >> kChunkBits; cx <= (maxRx >> kChunkBits); cx++) {
+        auto found = fChunks.find(ChunkKey(cx, cz));
+        if (found == fChunks.end()) {
+          continue;
+        }
+        auto const &slots = found->second->fSlots;
+        int const x0 = (std::max)(minRx, cx * kChunkSize);
+        int const x1 = (std::min)(maxRx, cx * kChunkSize + kChunkSize - 1);
+        int const z0 = (std::max)(minRz, cz * kChunkSize);
+        int const z1 = (std::min)(maxRz, cz * kChunkSize + kChunkSize - 1);
+        for (int rz = z0; rz <= z1; rz++) {
+          for (int rx = x0; rx <= x1; rx++) {
+            if (auto const &slot = slots[SlotIndex(MakeRegion(rx, rz))]; slot) {
+              fn(MakeRegion(rx, rz), *slot);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  void clear() {
+    fChunks.clear();
+  }
+
+private:
+  struct Chunk {
+    std::array<std::unique_ptr<T>, kChunkSize * kChunkSize> fSlots;
+  };
+
+  static uint64_t ChunkKey(int cx, int cz) {
+    return (uint64_t(uint32_t(cx)) << 32) | uint64_t(uint32_t(cz));
+  }
+
+  static int SlotIndex(Region region) {
+    return ((region.second & (kChunkSize - 1)) << kChunkBits) | (region.first & (kChunkSize - 1));
+  }
+
+  std::unordered_map<uint64_t, std::unique_ptr<Chunk>> fChunks;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RegionGrid)
+};
+
+} // namespace mcview
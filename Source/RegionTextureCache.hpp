@@ -5,15 +5,80 @@ namespace mcview {
 class RegionTextureCache {
 public:
   RegionTextureCache(juce::File worldDirectory, Dimension dim, Region region)
-      : fWorldDirectory(worldDirectory), fDimension(dim), fRegion(region), fSuccessful(true) {
+      : fWorldDirectory(worldDirectory), fDimension(dim), fRegion(region), fSuccessful(true), fProvisional(false), fLod(0), fLayer(-1), fShadeBiomeBlend(-1), fLastVisibleFrame(0) {
   }
 
-  void load(juce::PixelARGB *pixels) {
-    std::unique_ptr<juce::OpenGLTexture> p(new juce::OpenGLTexture());
-    p->loadARGB(pixels, 512, 512);
-    fTexture.reset(p.release());
+  // shade: RegionToTexture::Shade of pixels, or nullptr
+  void load(TextureUploader &uploader, juce::PixelARGB *pixels, juce::PixelARGB *shade, int shadeBiomeBlend, int lod, bool provisional) {
+    if (!fTexture) {
+      fTexture.reset(new juce::OpenGLTexture());
+    }
+    int const size = 512 >> lod;
+    uploader.upload(pixels, size, [this, size](juce::PixelARGB const *p) {
+      fTexture->loadARGB(p, size, size);
+      TextureUploader::SetNearestFilter();
+    });
+    if (shade) {
+      if (!fShadeTexture) {
+        fShadeTexture.reset(new juce::OpenGLTexture());
+      }
+      uploader.upload(shade, size, [this, size](juce::PixelARGB const *p) {
+        fShadeTexture->loadARGB(p, size, size);
+        TextureUploader::SetNearestFilter();
+      });
+    } else {
+      fShadeTexture.reset();
+    }
+    didLoad(shade ? shadeBiomeBlend : -1, lod, provisional);
+  }
+
+  bool load(TextureUploader &uploader, TileTextureArray &array, juce::PixelARGB *pixels, juce::PixelARGB *shade, int shadeBiomeBlend, int lod, bool provisional) {
+    if (fLayer < 0) {
+      fLayer = array.allocate();
+      if (fLayer < 0) {
+        return false;
+      }
+    }
+    int const layer = fLayer;
+    uploader.upload(pixels, array.size(), [&array, layer](juce::PixelARGB const *p) {
+      array.upload(layer, p);
+    });
+    if (shade && array.planes() > 1) {
+      uploader.upload(shade, array.size(), [&array, layer](juce::PixelARGB const *p) {
+        array.upload(layer, p, 1);
+      });
+    } else {
+      shade = nullptr;
+    }
+    didLoad(shade ? shadeBiomeBlend : -1, lod, provisional);
+    return true;
+  }
+
+  bool isShaded() const {
+    return fShadeBiomeBlend >= 0;
+  }
+
+  bool isResident() const {
+    return fTexture != nullptr || fLayer >= 0;
+  }
+
+  int64_t residentBytes() const {
+    if (!isResident()) {
+      return 0;
+    }
+    int64_t const size = 512 >> fLod;
+    return size * size * sizeof(juce::PixelARGB) * (isShaded() ? 2 : 1);
+  }
 
-    fLoadTime = juce::Time::getCurrentTime();
+private:
+  void didLoad(int shadeBiomeBlend, int lod, bool provisional) {
+    fShadeBiomeBlend = shadeBiomeBlend;
+    fLod = lod;
+    // Provisional texture has already faded in
+    if (!fProvisional) {
+      fLoadTime = juce::Time::getCurrentTime();
+    }
+    fProvisional = provisional;
   }
 
 public:
@@ -23,6 +88,15 @@ public:
   std::unique_ptr<juce::OpenGLTexture> fTexture;
   juce::Time fLoadTime;
   bool fSuccessful;
+  bool fProvisional;
+  // Level of detail of the resident texture. See RegionToTexture::kMaxLod
+  int fLod;
+  // Layer in the TileTextureArray, or -1
+  int fLayer;
+  std::unique_ptr<juce::OpenGLTexture> fShadeTexture;
+  // Biome blend the resident shade was computed with, or -1 if not shaded
+  int fShadeBiomeBlend;
+  uint64_t fLastVisibleFrame;
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RegionTextureCache);
 };
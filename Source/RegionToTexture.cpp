@@ -5,6 +5,7 @@
 
 #include "Dimension.hpp"
 #include "Palette.hpp"
+#include "Trace.hpp"
 #include "ThreadPool.hpp"
 #include "defer.hpp"
 
@@ -230,7 +231,86 @@ std::map<Biome, Colour> const RegionToTexture::kFoliageToColor = {
     {Biome::Badlands, Colour(10387789)},
 };
 
-PixelARGB *RegionToTexture::LoadBedrock(leveldb::DB &db, int rx, int rz, Dimension dim, ThreadPoolJob &job) {
+PixelARGB *RegionToTexture::Shade(PixelARGB const *pixels, int size, int biomeBlend) {
+  Trace::Span span("RegionToTexture::Shade");
+  int const count = size * size;
+  std::unique_ptr<PixelARGB[]> shade(new PixelARGB[count]);
+  std::fill_n(shade.get(), count, PixelARGB(0, 0, 0, 0));
+
+  auto altitude = [](PixelARGB p) {
+    return (int)AltitudeFromARGB(p) - 64;
+  };
+  auto compare = [](int neighbour, int center) -> uint8_t {
+    if (neighbour <= 0) {
+      return 0;
+    } else if (neighbour > center) {
+      return 1;
+    } else if (neighbour < center) {
+      return 2;
+    } else {
+      return 3;
+    }
+  };
+  for (int z = 1; z < size; z++) {
+    for (int x = 1; x < size; x++) {
+      int const h = altitude(pixels[z * size + x]);
+      uint8_t const north = compare(altitude(pixels[(z - 1) * size + x]), h);
+      uint8_t const west = compare(altitude(pixels[z * size + x - 1]), h);
+      shade[z * size + x].setARGB(north * 4 + west, 0, 0, 0);
+    }
+  }
+
+  // Box filter, separated into rows and columns
+  std::array<Colour, 8> colors;
+  for (int i = 0; i < 8; i++) {
+    auto found = kOceanToColor.find((Biome)i);
+    colors[i] = found == kOceanToColor.end() ? Colour(Palette::kDefaultOceanColor) : found->second;
+  }
+  int const window = 2 * biomeBlend + 1;
+  if (size < window) {
+    return shade.release();
+  }
+  std::vector<std::array<int, 3>> rows(count, {0, 0, 0});
+  for (int z = 0; z < size; z++) {
+    std::array<int, 3> sum = {0, 0, 0};
+    for (int x = 0; x < size; x++) {
+      Colour c = colors[(pixels[z * size + x].getBlue() >> 3) & 0x7];
+      sum[0] += c.getRed();
+      sum[1] += c.getGreen();
+      sum[2] += c.getBlue();
+      if (x >= window) {
+        Colour o = colors[(pixels[z * size + x - window].getBlue() >> 3) & 0x7];
+        sum[0] -= o.getRed();
+        sum[1] -= o.getGreen();
+        sum[2] -= o.getBlue();
+      }
+      if (x >= window - 1) {
+        rows[z * size + x - biomeBlend] = sum;
+      }
+    }
+  }
+  int const area = window * window;
+  for (int x = biomeBlend; x < size - biomeBlend; x++) {
+    std::array<int, 3> sum = {0, 0, 0};
+    for (int z = 0; z < size; z++) {
+      for (int i = 0; i < 3; i++) {
+        sum[i] += rows[z * size + x][i];
+      }
+      if (z >= window) {
+        for (int i = 0; i < 3; i++) {
+          sum[i] -= rows[(z - window) * size + x][i];
+        }
+      }
+      if (z >= window - 1) {
+        PixelARGB &p = shade[(z - biomeBlend) * size + x];
+        p.setARGB(p.getAlpha(), (uint8_t)((sum[0] + area / 2) / area), (uint8_t)((sum[1] + area / 2) / area), (uint8_t)((sum[2] + area / 2) / area));
+      }
+    }
+  }
+  return shade.release();
+}
+
+PixelARGB *RegionToTexture::LoadBedrock(leveldb::DB &db, int rx, int rz, Dimension dim, ThreadPoolJob &job, ProgressCallback progress) {
   using namespace juce;
   using namespace std;
 
@@ -241,16 +321,29 @@ PixelARGB *RegionToTexture::LoadBedrock(leveldb::DB &db, int rx, int rz, Dimensi
 
   std::vector<PixelInfo> pixelInfo(width * height, PixelInfo{-1, 0, 0});
   std::vector<Biome> biomes(width * height, Biome::Other);
+  std::vector<bool> loadedChunks(32 * 32, false);
+  auto const traceRegion = std::make_pair(rx, rz);
+  Trace::Span span("RegionToTexture::LoadBedrock", traceRegion);
 
+  bool didset = false;
+  uint32 nextProgress = Time::getMillisecondCounter() + kProgressIntervalMS;
   for (int cz = rz * 32; cz < rz * 32 + 32; cz++) {
     for (int cx = rx * 32; cx < rx * 32 + 32; cx++) {
       if (job.shouldExit()) {
         return nullptr;
       }
-      auto chunk = mcfile::be::Chunk::Load(cx, cz, DimensionFromDimension(dim), &db, mcfile::Encoding::LittleEndian, {});
+      if (progress && didset && Time::getMillisecondCounter() >= nextProgress) {
+        progress(PackProvisional(pixelInfo, biomes, loadedChunks, width, height));
+        nextProgress = Time::getMillisecondCounter() + kProgressIntervalMS;
+      }
+      auto chunk = [&]() {
+        Trace::Span read("RegionToTexture::readChunk", traceRegion);
+        return mcfile::be::Chunk::Load(cx, cz, DimensionFromDimension(dim), &db, mcfile::Encoding::LittleEndian, {});
+      }();
       if (!chunk) {
         continue;
       }
+      Trace::Span scan("RegionToTexture::scanChunk", traceRegion);
       int const sZ = chunk->minBlockZ();
       int const eZ = chunk->maxBlockZ();
       int const sX = chunk->minBlockX();
@@ -284,9 +377,11 @@ PixelARGB *RegionToTexture::LoadBedrock(leveldb::DB &db, int rx, int rz, Dimensi
           });
           if (info) {
             pixelInfo[idx] = *info;
+            didset = true;
           }
         }
       }
+      loadedChunks[(cz - rz * 32) * 32 + (cx - rx * 32)] = true;
     }
   }
 
@@ -18,13 +18,25 @@ enum class Biome : uint8_t {
 class RegionToTexture {
   RegionToTexture() = delete;
 
+public:
   struct PixelInfo {
     int height;
     int waterDepth;
     mcfile::blocks::BlockId blockId;
   };
 
-public:
+  // Receives a partially rendered texture while a region is loading. The receiver takes ownership.
+  using ProgressCallback = std::function<void(juce::PixelARGB *pixels)>;
+
+  static int constexpr kProgressIntervalMS = 250;
+
+  // Reduced textures for zoomed out views: level n is (512 >> n) pixels square
+  static int constexpr kMaxLod = 4;
+
+  static int TextureSize(int lod) {
+    return 512 >> lod;
+  }
+
   static std::optional<PixelInfo> PillarPixelInfo(Dimension dim, int x, int z, int maxBlockY, std::function<mcfile::blocks::BlockId(int, int, int)> blockIdAt) {
     uint8_t waterDepth = 0;
     int ymax = 319;
@@ -95,6 +107,7 @@ public:
 
   static juce::PixelARGB *Pack(std::vector<PixelInfo> const &pixelInfo, std::vector<Biome> const &biomes, int width, int height) {
     using namespace juce;
+    Trace::Span span("RegionToTexture::Pack");
     std::unique_ptr<PixelARGB[]> pixels(new PixelARGB[width * height]);
     std::fill_n(pixels.get(), width * height, PixelARGB(0, 0, 0, 0));
     for (int z = 0; z < height; z++) {
@@ -127,7 +140,67 @@ public:
     return pixels.release();
   }
 
-  static juce::PixelARGB *LoadJava(mcfile::je::Region const &region, Dimension dim, ThreadPoolJob &job) {
+  // Packs the chunks loaded so far, skipping the costly biome radius.
+  static juce::PixelARGB *PackProvisional(std::vector<PixelInfo> const &pixelInfo, std::vector<Biome> const &biomes, std::vector<bool> const &loadedChunks, int width, int height) {
+    using namespace juce;
+    Trace::Span span("RegionToTexture::PackProvisional");
+    std::unique_ptr<PixelARGB[]> pixels(new PixelARGB[width * height]);
+    std::fill_n(pixels.get(), width * height, PixelARGB(0, 0, 0, 0));
+    for (int z = 0; z < height; z++) {
+      for (int x = 0; x < width; x++) {
+        if (!loadedChunks[(z / 16) * (width / 16) + x / 16]) {
+          continue;
+        }
+        int idx = z * width + x;
+        PixelInfo info = pixelInfo[idx];
+        if (info.height < 0) {
+          continue;
+        }
+        pixels[idx] = PackPixelInfoToARGB(info.height, info.waterDepth, (uint8_t)biomes[idx], (uint32_t)info.blockId, 0);
+      }
+    }
+    return pixels.release();
+  }
+
+  // Precomputes the terms color.frag would otherwise gather from neighbour texels, for a size x size texture:
+  // rgb: water color blended over (2 * biomeBlend + 1)^2 texels, valid at least biomeBlend texels away from the edges
+  // alpha: north * 4 + west, how those neighbours compare in altitude (0: none, 1: higher, 2: lower, 3: same). Valid except on the first row and column
+  static juce::PixelARGB *Shade(juce::PixelARGB const *pixels, int size, int biomeBlend);
+
+  // Halves a size x size texture. Packed block ids can't be averaged, so each 2x2 cell keeps its highest surface.
+  static juce::PixelARGB *Downsample(juce::PixelARGB const *pixels, int size) {
+    using namespace juce;
+    int const half = size / 2;
+    std::unique_ptr<PixelARGB[]> reduced(new PixelARGB[half * half]);
+    for (int z = 0; z < half; z++) {
+      for (int x = 0; x < half; x++) {
+        PixelARGB const *cell[4] = {
+            pixels + (2 * z) * size + 2 * x,
+            pixels + (2 * z) * size + 2 * x + 1,
+            pixels + (2 * z + 1) * size + 2 * x,
+            pixels + (2 * z + 1) * size + 2 * x + 1,
+        };
+        PixelARGB const *highest = cell[0];
+        for (int i = 1; i < 4; i++) {
+          if (AltitudeFromARGB(*cell[i]) > AltitudeFromARGB(*highest)) {
+            highest = cell[i];
+          }
+        }
+        reduced[z * half + x] = *highest;
+      }
+    }
+    return reduced.release();
+  }
+
+  // Applies Downsample to a texture of level fromLod until it is of level toLod
+  static std::shared_ptr<juce::PixelARGB[]> Reduce(std::shared_ptr<juce::PixelARGB[]> pixels, int fromLod, int toLod) {
+    for (int lod = fromLod; lod < toLod && pixels; lod++) {
+      pixels.reset(Downsample(pixels.get(), TextureSize(lod)));
+    }
+    return pixels;
+  }
+
+  static juce::PixelARGB *LoadJava(mcfile::je::Region const &region, Dimension dim, ThreadPoolJob &job, ProgressCallback progress = nullptr) {
     using namespace juce;
     using namespace mcfile::blocks::minecraft;
 
@@ -136,13 +209,31 @@ public:
 
     std::vector<PixelInfo> pixelInfo(width * height, PixelInfo{0, 0, 0});
     std::vector<Biome> biomes(width * height, Biome::Other);
+    std::vector<bool> loadedChunks(32 * 32, false);
 
     int const minX = region.minBlockX();
     int const minZ = region.minBlockZ();
+    auto const traceRegion = std::make_pair(minX >> 9, minZ >> 9);
+    Trace::Span span("RegionToTexture::LoadJava", traceRegion);
 
     bool didset = false;
+    juce::uint32 nextProgress = juce::Time::getMillisecondCounter() + kProgressIntervalMS;
+    // Reading and decompressing a chunk happens between the callbacks
+    juce::int64 readBegin = Trace::Enabled() ? juce::Time::getHighResolutionTicks() : 0;
     bool completed = region.loadAllChunks(
-        [&pixelInfo, &biomes, minX, minZ, width, height, &job, dim, &didset](mcfile::je::Chunk const &chunk) {
+        [&pixelInfo, &biomes, &loadedChunks, minX, minZ, width, height, &job, dim, &didset, &progress, &nextProgress, &readBegin, traceRegion](mcfile::je::Chunk const &chunk) {
+          if (readBegin != 0) {
+            Trace::Record("RegionToTexture::readChunk", readBegin, juce::Time::getHighResolutionTicks(), traceRegion);
+          }
+          Trace::Span scan("RegionToTexture::scanChunk", traceRegion);
+          defer {
+            loadedChunks[((chunk.minBlockZ() - minZ) / 16) * 32 + (chunk.minBlockX() - minX) / 16] = true;
+            if (progress && didset && !job.shouldExit() && juce::Time::getMillisecondCounter() >= nextProgress) {
+              progress(PackProvisional(pixelInfo, biomes, loadedChunks, width, height));
+              nextProgress = juce::Time::getMillisecondCounter() + kProgressIntervalMS;
+            }
+            readBegin = Trace::Enabled() ? juce::Time::getHighResolutionTicks() : 0;
+          };
           int maxSectionY = -9999;
           for (int i = (int)chunk.fSections.size() - 1; i >= 0; i--) {
             if (chunk.fSections[i]) {
@@ -192,7 +283,7 @@ public:
     return Pack(pixelInfo, biomes, width, height);
   }
 
-  static juce::PixelARGB *LoadBedrock(leveldb::DB &db, int rx, int rz, Dimension dim, ThreadPoolJob &job);
+  static juce::PixelARGB *LoadBedrock(leveldb::DB &db, int rx, int rz, Dimension dim, ThreadPoolJob &job, ProgressCallback progress = nullptr);
 
 private:
   static juce::PixelARGB PackPixelInfoToARGB(uint32_t height, uint8_t waterDepth, uint8_t biome, uint32_t block, uint8_t biomeRadius) {
@@ -224,6 +315,10 @@ private:
     return p;
   }
 
+  static uint32_t AltitudeFromARGB(juce::PixelARGB p) {
+    return ((uint32_t)p.getAlpha() << 1) | ((uint32_t)p.getRed() >> 7);
+  }
+
   static inline Biome ToBiome(mcfile::biomes::BiomeId b) {
     switch (b) {
     case mcfile::biomes::minecraft::ocean:
@@ -0,0 +1,394 @@
+#include <colormap/colormap.h>
+#include <juce_core/juce_core.h>
+#include <juce_graphics/juce_graphics.h>
+#include <leveldb/env.h>
+#include <minecraft-file.hpp>
+#include <nlohmann/json.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#include "db/_readonly-db.hpp"
+
+// clang-format off
+#include "defer.hpp"
+
+#include "PaletteType.hpp"
+#include "LightingType.hpp"
+#include "Edition.hpp"
+#include "File.hpp"
+#include "LookAt.hpp"
+#include "Dimension.hpp"
+#include "Region.hpp"
+#include "Fingerprint.hpp"
+#include "PNGWriter.hpp"
+#include "ParallelFor.hpp"
+#include "Trace.hpp"
+#include "ThreadPool.hpp"
+#include "VisibleRegions.hpp"
+#include "Palette.hpp"
+#include "RegionToTexture.hpp"
+#include "TileCacheWriter.hpp"
+#include "TexturePackJob.hpp"
+#include "JavaTexturePackJob.hpp"
+#include "BedrockTexturePackJob.hpp"
+#include "OverviewJob.hpp"
+#include "TexturePackThreadPool.hpp"
+#include "JavaTexturePackThreadPool.hpp"
+#include "BedrockTexturePackThreadPool.hpp"
+#include "SoftwareRenderer.hpp"
+#include "TilePyramid.hpp"
+// clang-format on
+
+namespace mcview {
+
+// Renders every region of a world into the tile cache, without a display or GPU.
+class Renderer : public TexturePackThreadPool::Delegate {
+public:
+  Renderer(juce::File worldDirectory, bool useCache, std::optional<juce::File> pngDirectory, int pngLod, std::optional<juce::File> tilesDirectory)
+      : fWorldDirectory(worldDirectory), fUseCache(useCache), fPNGDirectory(pngDirectory), fPNGLod(pngLod), fTilesDirectory(tilesDirectory) {
+    fEdition = worldDirectory.getChildFile("db").exists() ? Edition::Bedrock : Edition::Java;
+  }
+
+  bool run() {
+    if (fEdition == Edition::Bedrock) {
+      if (!BedrockTexturePackThreadPool::OpenDb(fWorldDirectory, fDb, fDbAttachment)) {
+        std::cerr << "Error: cannot open " << fWorldDirectory.getFullPathName() << std::endl;
+        return false;
+      }
+      fLastPlayed = BedrockTexturePackThreadPool::ReadLastPlayedTimestamp(PathFromFile(fWorldDirectory) / "level.dat");
+    } else if (!fWorldDirectory.getChildFile("level.dat").existsAsFile()) {
+      std::cerr << "Error: " << fWorldDirectory.getFullPathName() << " is not a world directory" << std::endl;
+      return false;
+    }
+
+    auto writer = std::make_shared<TileCacheWriter>(TexturePackJob::StoreCache);
+    writer->start();
+
+    double const start = juce::Time::getMillisecondCounterHiRes();
+    int total = 0;
+    for (Dimension dim : {Dimension::Overworld, Dimension::TheNether, Dimension::TheEnd}) {
+      total += render(dim, writer);
+    }
+
+    std::cout << "Flushing cache writes..." << std::endl;
+    writer->flush();
+    writer->close();
+    writer->stopThread(-1);
+
+    double const elapsed = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+    std::cout << "Rendered " << total << " regions in " << juce::String(elapsed, 1) << "s";
+    if (fFailed > 0) {
+      std::cout << " (" << fFailed << " failed)";
+    }
+    std::cout << std::endl;
+
+    bool ok = true;
+    if (fPNGDirectory) {
+      for (auto const &it : fRegions) {
+        ok &= exportPNG(it.first, it.second);
+      }
+    }
+    if (fTilesDirectory) {
+      for (auto const &it : fRegions) {
+        ok &= exportTiles(it.first, it.second);
+      }
+    }
+
+    fDb.reset();
+    fDbAttachment.reset();
+    return ok;
+  }
+
+  void texturePackThreadPoolDidFinishJob(TexturePackThreadPool *pool, std::shared_ptr<TexturePackJob::Result> result) override {
+    if (result->fProvisional) {
+      return;
+    }
+    if (!result->fPixels) {
+      fFailed++;
+    }
+    fFinished++;
+    fProgress.signal();
+  }
+
+private:
+  int render(Dimension dim, std::shared_ptr<TileCacheWriter> writer) {
+    std::unique_ptr<TexturePackThreadPool> pool;
+    std::vector<Region> regions;
+    if (fEdition == Edition::Bedrock) {
+      regions = BedrockRegions(*fDb, dim);
+      pool.reset(new BedrockTexturePackThreadPool(fWorldDirectory, dim, fLastPlayed, fDb, fDbAttachment, writer, this));
+    } else {
+      regions = JavaRegions(fWorldDirectory, dim);
+      pool.reset(new JavaTexturePackThreadPool(fWorldDirectory, dim, writer, this));
+    }
+    juce::String const name = DimensionName(dim);
+    fRegions[dim] = regions;
+    if (regions.empty()) {
+      std::cout << name << ": no regions" << std::endl;
+      return 0;
+    }
+
+    fFinished = 0;
+    for (Region region : regions) {
+      pool->addTexturePackJob(region, fUseCache);
+    }
+
+    int const count = (int)regions.size();
+    double const start = juce::Time::getMillisecondCounterHiRes();
+    while (true) {
+      bool const done = fFinished.load() >= count && pool->getNumJobs() == 0;
+      int const finished = fFinished.load();
+      double const elapsed = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+      double const rate = elapsed > 0 ? finished / elapsed : 0;
+      juce::String line = name + ": " + juce::String(finished) + "/" + juce::String(count) + " regions, " + juce::String(rate, 1) + " regions/s";
+      if (!done && rate > 0) {
+        line += ", eta " + juce::String((int)std::ceil((count - finished) / rate)) + "s";
+      }
+      std::cout << line << std::endl;
+      if (done) {
+        break;
+      }
+      fProgress.wait(1000);
+    }
+    return count;
+  }
+
+  // Widest and tallest image a PNG can hold
+  static int64_t constexpr kMaxPNGSize = 0x7fffffff;
+  // Most memory a strip of rows is allowed, so that the width of a dimension does not decide how much is allocated
+  static int64_t constexpr kMaxStripBytes = int64_t(256) * 1024 * 1024;
+
+  // Draws the cached tiles of a dimension into <png directory>/<dimension>.png, a strip of rows at a time.
+  // Tiles are reduced to fPNGLod before they are drawn, so the time to draw scales with the size of the image.
+  // Each tile is decoded once, and kept while the rows of its region and of the regions next to it are drawn
+  bool exportPNG(Dimension dim, std::vector<Region> const &regions) {
+    if (regions.empty()) {
+      return true;
+    }
+    int minRx = regions[0].first;
+    int maxRx = minRx;
+    int minRz = regions[0].second;
+    int maxRz = minRz;
+    for (Region region : regions) {
+      minRx = (std::min)(minRx, region.first);
+      maxRx = (std::max)(maxRx, region.first);
+      minRz = (std::min)(minRz, region.second);
+      maxRz = (std::max)(maxRz, region.second);
+    }
+    int const lod = fPNGLod;
+    int const size = RegionToTexture::TextureSize(lod);
+    int64_t const imageWidth = ((int64_t)maxRx - minRx + 1) * size;
+    int64_t const imageHeight = ((int64_t)maxRz - minRz + 1) * size;
+
+    juce::File file = fPNGDirectory->getChildFile(DimensionName(dim) + ".png");
+    if (imageWidth > kMaxPNGSize || imageHeight > kMaxPNGSize || imageWidth * 4 > kMaxStripBytes) {
+      std::cerr << "Error: " << file.getFullPathName() << " would be " << imageWidth << "x" << imageHeight << " pixels, too large. Use a larger --scale" << std::endl;
+      return false;
+    }
+    int const width = (int)imageWidth;
+    int const height = (int)imageHeight;
+    // A power of two, so that strips never straddle two rows of regions
+    int const stripHeight = 1 << juce::findHighestSetBit((juce::uint32)std::clamp<int64_t>(kMaxStripBytes / (imageWidth * 4), 1, size));
+
+    if (fPNGDirectory->createDirectory().failed()) {
+      std::cerr << "Error: cannot write " << file.getFullPathName() << std::endl;
+      return false;
+    }
+
+    std::mutex mut;
+    std::map<Region, std::shared_ptr<juce::PixelARGB[]>> tiles;
+    SoftwareRenderer::Options options;
+    options.fDimension = dim;
+    options.fLod = lod;
+    SoftwareRenderer renderer(options, [&mut, &tiles, source = cachedTiles(dim), lod](Region region) {
+      {
+        std::lock_guard<std::mutex> lock(mut);
+        if (auto found = tiles.find(region); found != tiles.end()) {
+          return found->second;
+        }
+      }
+      auto tile = RegionToTexture::Reduce(source(region), 0, lod);
+      std::lock_guard<std::mutex> lock(mut);
+      tiles[region] = tile;
+      return tile;
+    });
+
+    int const numThreads = juce::SystemStats::getNumCpus();
+    double const start = juce::Time::getMillisecondCounterHiRes();
+    // The previous image is kept until the new one is complete
+    juce::TemporaryFile temp(file);
+    {
+      juce::FileOutputStream stream(temp.getFile());
+      if (!stream.openedOk()) {
+        std::cerr << "Error: cannot write " << file.getFullPathName() << std::endl;
+        return false;
+      }
+      ParallelPNGWriter writer(width, height, stream, PNGEncodeOptions::kDefaultCompressionLevel, PNGFilterHeuristic::adaptive, numThreads);
+      std::vector<juce::PixelARGB> strip((size_t)width * stripHeight);
+      for (int z = 0; z < height; z += stripHeight) {
+        int const rows = (std::min)(stripHeight, height - z);
+        int const rz = minRz + z / size;
+        {
+          // Drops regions north of the ones the strip reads
+          std::lock_guard<std::mutex> lock(mut);
+          std::erase_if(tiles, [rz](auto const &it) { return it.first.second < rz - 1; });
+        }
+        renderer.render(minRx * size, minRz * size + z, width, rows, strip.data(), numThreads);
+        writer.writeRows(strip.data(), rows);
+        if ((z + rows) % size == 0) {
+          std::cout << DimensionName(dim) << ".png: " << ((z + rows) / size) << "/" << (height / size) << " rows of regions" << std::endl;
+        }
+      }
+    }
+    if (!temp.overwriteTargetFileWithTemporary()) {
+      std::cerr << "Error: cannot write " << file.getFullPathName() << std::endl;
+      return false;
+    }
+    double const elapsed = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+    std::cout << "Wrote " << file.getFullPathName() << " (" << width << "x" << height << ") in " << juce::String(elapsed, 1) << "s" << std::endl;
+    return true;
+  }
+
+  // Updates the slippy map pyramid in <tiles directory>/<dimension>, redrawing only tiles of changed regions
+  bool exportTiles(Dimension dim, std::vector<Region> const &regions) {
+    std::map<Region, uint64_t> fingerprints;
+    for (Region region : regions) {
+      if (auto fingerprint = TexturePackJob::LoadCacheIndex(fWorldDirectory, dim, region); fingerprint) {
+        fingerprints[region] = *fingerprint;
+      }
+    }
+    juce::String const name = DimensionName(dim);
+    SoftwareRenderer::Options options;
+    options.fDimension = dim;
+    TilePyramid pyramid(fTilesDirectory->getChildFile(name), options, fingerprints, cachedTiles(dim));
+    TilePyramid::Stats stats;
+    double const start = juce::Time::getMillisecondCounterHiRes();
+    bool const ok = pyramid.update(juce::SystemStats::getNumCpus(), stats, [&name](int zoom, int count) {
+      std::cout << name << " tiles: zoom " << zoom << ", " << count << " tiles" << std::endl;
+    });
+    if (!ok) {
+      std::cerr << "Error: cannot write " << fTilesDirectory->getChildFile(name).getFullPathName() << std::endl;
+      return false;
+    }
+    double const elapsed = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+    std::cout << name << " tiles: " << stats.fWritten << " written, " << stats.fRemoved << " removed, " << stats.fUnchanged << " regions unchanged in " << juce::String(elapsed, 1) << "s" << std::endl;
+    return true;
+  }
+
+  // Tiles this run has stored in the cache
+  SoftwareRenderer::TileSource cachedTiles(Dimension dim) const {
+    juce::File const world = fWorldDirectory;
+    return [world, dim](Region region) -> std::shared_ptr<juce::PixelARGB[]> {
+      auto fingerprint = TexturePackJob::LoadCacheIndex(world, dim, region);
+      if (!fingerprint) {
+        return nullptr;
+      }
+      std::shared_ptr<juce::PixelARGB[]> pixels;
+      if (!TexturePackJob::LoadCache(pixels, std::nullopt, TexturePackJob::CacheFile(*fingerprint))) {
+        return nullptr;
+      }
+      return pixels;
+    };
+  }
+
+  static std::vector<Region> JavaRegions(juce::File worldDirectory, Dimension dim) {
+    std::vector<Region> regions;
+    juce::File dir = DimensionDirectory(worldDirectory, dim);
+    if (!dir.isDirectory()) {
+      return regions;
+    }
+    for (juce::DirectoryEntry entry : juce::RangedDirectoryIterator(dir, false, "*.mca")) {
+      if (auto r = mcfile::je::Region::MakeRegion(PathFromFile(entry.getFile())); r) {
+        regions.push_back(MakeRegion(r->fX, r->fZ));
+      }
+    }
+    return regions;
+  }
+
+  static std::vector<Region> BedrockRegions(leveldb::DB &db, Dimension dim) {
+    std::set<Region> found;
+    mcfile::be::Chunk::ForAll(&db, DimensionFromDimension(dim), [&found](int cx, int cz) -> bool {
+      found.insert(MakeRegion(mcfile::Coordinate::RegionFromChunk(cx), mcfile::Coordinate::RegionFromChunk(cz)));
+      return true;
+    });
+    return std::vector<Region>(found.begin(), found.end());
+  }
+
+  static juce::String DimensionName(Dimension dim) {
+    switch (dim) {
+    case Dimension::TheNether:
+      return "the_nether";
+    case Dimension::TheEnd:
+      return "the_end";
+    case Dimension::Overworld:
+    default:
+      return "overworld";
+    }
+  }
+
+private:
+  juce::File const fWorldDirectory;
+  bool const fUseCache;
+  std::optional<juce::File> const fPNGDirectory;
+  int const fPNGLod;
+  std::optional<juce::File> const fTilesDirectory;
+  Edition fEdition;
+  std::shared_ptr<leveldb::DB> fDb;
+  std::shared_ptr<je2be::ReadonlyDb::Closer> fDbAttachment;
+  std::optional<int64_t> fLastPlayed;
+  std::map<Dimension, std::vector<Region>> fRegions;
+  std::atomic<int> fFinished = 0;
+  std::atomic<int> fFailed = 0;
+  juce::WaitableEvent fProgress;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Renderer)
+};
+
+} // namespace mcview
+
+int main(int argc, char *argv[]) {
+  juce::ArgumentList args(argc, argv);
+  bool const force = args.removeOptionIfFound("--force");
+  std::optional<juce::File> png;
+  std::optional<juce::File> tiles;
+  for (auto [option, directory] : {std::make_pair("--png", &png), std::make_pair("--tiles", &tiles)}) {
+    if (!args.containsOption(option)) {
+      continue;
+    }
+    juce::String const dir = args.removeValueForOption(option);
+    if (dir.isEmpty()) {
+      std::cerr << "Error: " << option << " requires a directory" << std::endl;
+      return 1;
+    }
+    *directory = juce::File::getCurrentWorkingDirectory().getChildFile(dir);
+  }
+  int pngLod = 0;
+  if (args.containsOption("--scale")) {
+    int const scale = args.removeValueForOption("--scale").getIntValue();
+    if (!juce::isPowerOfTwo(scale) || scale > (1 << mcview::SoftwareRenderer::kMaxLod)) {
+      std::cerr << "Error: --scale requires a power of two up to " << (1 << mcview::SoftwareRenderer::kMaxLod) << std::endl;
+      return 1;
+    }
+    pngLod = juce::findHighestSetBit((juce::uint32)scale);
+  }
+  if (args.size() != 1) {
+    std::cerr << "Usage: " << args.executableName << " [--force] [--png <directory> [--scale <n>]] [--tiles <directory>] <world directory>" << std::endl;
+    std::cerr << "  --force  Render every region again, ignoring cached tiles" << std::endl;
+    std::cerr << "  --png    Also draw each dimension into <directory>/<dimension>.png on the CPU" << std::endl;
+    std::cerr << "  --scale  Blocks per pixel of --png, a power of two. Default 1" << std::endl;
+    std::cerr << "  --tiles  Also update a slippy map pyramid of 256x256 tiles, <directory>/<dimension>/<z>/<x>/<y>.png." << std::endl;
+    std::cerr << "           Only tiles of regions changed since the last update are drawn again" << std::endl;
+    return 1;
+  }
+  juce::File world = args[0].resolveAsFile();
+  if (!world.isDirectory()) {
+    std::cerr << "Error: " << world.getFullPathName() << " does not exist" << std::endl;
+    return 1;
+  }
+  mcview::Renderer renderer(world, !force, png, pngLod, tiles);
+  return renderer.run() ? 0 : 1;
+}
@@ -14,21 +14,24 @@ public:
   SavePNGProgressWindow(Delegate *delegate,
                         juce::OpenGLContext &openGLContext,
                         juce::File file,
+                        PNGEncodeOptions options,
                         int minRx, int minRz, int maxRx, int maxRz)
-      : juce::ThreadWithProgressWindow(TRANS("Writing image file"), true, false),
+      : juce::ThreadWithProgressWindow(TRANS("Writing image file"), true, true),
         fDelegate(delegate),
         fGLContext(openGLContext),
         fFile(file),
+        fOptions(options),
         fMinRx(minRx), fMinRz(minRz), fMaxRx(maxRx), fMaxRz(maxRz) {
   }
 
+  // Rows rendered per strip. Two strips are alive at once: one being encoded while the next one is rendered.
+  static int constexpr kStripHeight = 512;
+  // Widest framebuffer rendered at once, within the maximum texture size of any GPU we support
+  static int constexpr kMaxTileWidth = 4096;
+
   void run() override {
     using namespace juce;
 
-    if (fMinRx > fMaxRx || fMinRz > fMaxRz) {
-      return;
-    }
-
     int const minBlockX = fMinRx * 512;
     int const minBlockZ = fMinRz * 512;
     int const maxBlockX = fMaxRx * 512 - 1;
@@ -36,59 +39,140 @@ public:
 
     int const width = maxBlockX - minBlockX + 1;
     int const height = maxBlockZ - minBlockZ + 1;
-
-    auto image = std::make_unique<Image>(Image::PixelFormat::ARGB, width, height, true);
-    Image::BitmapData data(*image, Image::BitmapData::readWrite);
-    if (data.lineStride != 4 * width || data.pixelStride != 4) {
+    if (fMinRx > fMaxRx || fMinRz > fMaxRz || width <= 0 || height <= 0) {
+      fDelegate->savePNGProgressWindowDidFinishRendering();
       return;
     }
 
-    std::latch latch(1);
+    // The target is replaced only once the image is complete, so that cancelling or a failure never leaves a truncated file
+    TemporaryFile temp(fFile);
+    bool completed = false;
+    {
+      FileOutputStream stream(temp.getFile());
+      if (stream.openedOk()) {
+        completed = encode(stream, minBlockX, minBlockZ, width, height);
+        stream.flush();
+        completed = completed && !stream.getStatus().failed();
+      }
+    }
 
+    std::latch latch(1);
     fGLContext.executeOnGLThread(
-        [this, &latch, &data, minBlockX, minBlockZ, width, height](OpenGLContext &ctx) {
-          std::unique_ptr<OpenGLFrameBuffer> buffer(new OpenGLFrameBuffer());
-          buffer->initialise(ctx, width, height);
-          buffer->makeCurrentRenderingTarget();
+        [this, &latch](OpenGLContext &) {
+          fFrameBuffer.reset();
+          latch.count_down();
+        },
+        false);
+    latch.wait();
+
+    if (completed) {
+      temp.overwriteTargetFileWithTemporary();
+    }
+    fDelegate->savePNGProgressWindowDidFinishRendering();
+    setProgress(1);
+  }
 
-          LookAt lookAt;
-          lookAt.fX = minBlockX + width / 2.0f;
-          lookAt.fZ = minBlockZ + height / 2.0f;
-          lookAt.fBlocksPerPixel = 1;
-          fDelegate->savePNGProgressWindowRender(width, height, lookAt);
+private:
+  struct Strip {
+    std::vector<juce::PixelARGB> fPixels;
+    int fHeight = 0;
+    juce::WaitableEvent fRendered;
+  };
 
-          buffer->readPixels((PixelARGB *)data.data, juce::Rectangle<int>(0, 0, width, height), OpenGLFrameBuffer::RowOrder::fromBottomUp);
-          buffer->releaseAsRenderingTarget();
+  // Renders and encodes every strip into stream. Returns false when cancelled before the last row
+  bool encode(juce::OutputStream &stream, int minBlockX, int minBlockZ, int width, int height) {
+    using namespace juce;
 
-          buffer->release();
-          buffer.reset();
+    std::unique_ptr<PNGWriter> writer;
+    std::unique_ptr<ParallelPNGWriter> parallelWriter;
+    if (fOptions.fParallel) {
+      parallelWriter = std::make_unique<ParallelPNGWriter>(width, height, stream, fOptions.fCompressionLevel, fOptions.fFilter, SystemStats::getNumCpus());
+    } else {
+      writer = std::make_unique<PNGWriter>(width, height, stream, fOptions.fFilter);
+    }
 
-          latch.count_down();
+    std::array<Strip, 2> strips;
+    for (auto &strip : strips) {
+      strip.fPixels.resize((size_t)width * kStripHeight);
+    }
+    int const numStrips = (height + kStripHeight - 1) / kStripHeight;
+    renderStrip(strips[0], 0, minBlockX, minBlockZ, width, height);
+
+    int y = 0;
+    for (int i = 0; i < numStrips; i++) {
+      Strip &strip = strips[i % 2];
+      strip.fRendered.wait(-1);
+      bool const cancelled = threadShouldExit();
+      if (i + 1 < numStrips && !cancelled) {
+        // Render the next strip on the GL thread while this one is encoded
+        renderStrip(strips[(i + 1) % 2], (i + 1) * kStripHeight, minBlockX, minBlockZ, width, height);
+      }
+      if (cancelled) {
+        return false;
+      }
+      if (parallelWriter) {
+        parallelWriter->writeRows(strip.fPixels.data(), strip.fHeight);
+        y += strip.fHeight;
+        setProgress(y / (double)height);
+        continue;
+      }
+      for (int row = 0; row < strip.fHeight; row++, y++) {
+        writer->writeRow(strip.fPixels.data() + (size_t)row * width);
+        setProgress((y + 1) / (double)height);
+      }
+    }
+    return y == height;
+  }
 
-          fDelegate->savePNGProgressWindowDidFinishRendering();
+  // Renders rows [y, y + kStripHeight) of the image into strip on the GL thread, in tiles no wider than kMaxTileWidth. Signals strip.fRendered when done.
+  void renderStrip(Strip &strip, int y, int minBlockX, int minBlockZ, int width, int height) {
+    using namespace juce;
+    strip.fHeight = (std::min)(kStripHeight, height - y);
+    fGLContext.executeOnGLThread(
+        [this, &strip, y, minBlockX, minBlockZ, width](OpenGLContext &ctx) {
+          int const stripHeight = strip.fHeight;
+          for (int x = 0; x < width; x += kMaxTileWidth) {
+            int const tileWidth = (std::min)(kMaxTileWidth, width - x);
+            if (!fFrameBuffer || fFrameBuffer->getWidth() != tileWidth || fFrameBuffer->getHeight() != stripHeight) {
+              fFrameBuffer = std::make_unique<OpenGLFrameBuffer>();
+              if (!fFrameBuffer->initialise(ctx, tileWidth, stripHeight)) {
+                fFrameBuffer.reset();
+                for (int row = 0; row < stripHeight; row++) {
+                  std::fill_n(strip.fPixels.data() + (size_t)row * width + x, tileWidth, PixelARGB(0, 0, 0, 0));
+                }
+                continue;
+              }
+            }
+            fFrameBuffer->makeCurrentRenderingTarget();
+
+            LookAt lookAt;
+            lookAt.fX = minBlockX + x + tileWidth / 2.0f;
+            lookAt.fZ = minBlockZ + y + stripHeight / 2.0f;
+            lookAt.fBlocksPerPixel = 1;
+            fDelegate->savePNGProgressWindowRender(tileWidth, stripHeight, lookAt);
+
+            fTile.resize((size_t)tileWidth * stripHeight);
+            fFrameBuffer->readPixels(fTile.data(), juce::Rectangle<int>(0, 0, tileWidth, stripHeight), OpenGLFrameBuffer::RowOrder::fromBottomUp);
+            fFrameBuffer->releaseAsRenderingTarget();
+
+            for (int row = 0; row < stripHeight; row++) {
+              std::copy_n(fTile.data() + (size_t)(stripHeight - row - 1) * tileWidth, tileWidth, strip.fPixels.data() + (size_t)row * width + x);
+            }
+          }
+          strip.fRendered.signal();
         },
         false);
-
-    latch.wait();
-    setProgress(0.1);
-
-    FileOutputStream stream(fFile);
-    stream.setPosition(0);
-    stream.truncate();
-    PNGWriter writer(width, height, stream);
-    for (int y = 0; y < height; y++) {
-      writer.writeRow((PixelARGB *)data.getLinePointer(height - y - 1));
-      double p = (y + 1) / (double)height;
-      setProgress(0.1 + p * 0.9);
-    }
-    setProgress(1);
   }
 
 private:
   Delegate *const fDelegate;
   juce::OpenGLContext &fGLContext;
   juce::File fFile;
+  PNGEncodeOptions const fOptions;
   int fMinRx, fMinRz, fMaxRx, fMaxRz;
+  // Used on the GL thread only
+  std::unique_ptr<juce::OpenGLFrameBuffer> fFrameBuffer;
+  std::vector<juce::PixelARGB> fTile;
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SavePNGProgressWindow)
 };
@@ -12,6 +12,10 @@ public:
   static int constexpr kMaxBiomeBlend = 7;
   static int constexpr kMinBiomeBlend = 0;
 
+  static int constexpr kDefaultTextureMemoryBudgetMB = 512;
+  static int constexpr kMaxTextureMemoryBudgetMB = 8192;
+  static int constexpr kMinTextureMemoryBudgetMB = 64;
+
 public:
   Settings()
       : fWaterOpticalDensity(kDefaultWaterOpticalDensity),
@@ -20,7 +24,10 @@ public:
         fBiomeBlend(kDefaultBiomeBlend),
         fShowPin(true),
         fPaletteType(PaletteType::mcview),
-        fLightingType(LightingType::topLeft) {
+        fLightingType(LightingType::topLeft),
+        fTextureMemoryBudgetMB(kDefaultTextureMemoryBudgetMB),
+        fPrecomputeShading(true),
+        fModernRenderer(false) {
   }
 
   std::vector<juce::File> directories() const {
@@ -115,6 +122,15 @@ public:
         fLightingType = LightingType::topLeft;
       }
     }
+    if (auto v = obj.find("texture_memory_budget_mb"); v != obj.end() && v->is_number_integer()) {
+      fTextureMemoryBudgetMB = std::clamp(v->get<int>(), kMinTextureMemoryBudgetMB, kMaxTextureMemoryBudgetMB);
+    }
+    if (auto v = obj.find("precompute_shading"); v != obj.end() && v->is_boolean()) {
+      fPrecomputeShading = v->get<bool>();
+    }
+    if (auto v = obj.find("modern_renderer"); v != obj.end() && v->is_boolean()) {
+      fModernRenderer = v->get<bool>();
+    }
   }
 
   /*
@@ -132,7 +148,10 @@ public:
     "biome_blend": 7,
     "show_pin": true,
     "palette": "java",
-    "lighting_type": "top"
+    "lighting_type": "top",
+    "texture_memory_budget_mb": 512,
+    "precompute_shading": true,
+    "modern_renderer": true
   }
    */
 
@@ -199,6 +218,9 @@ public:
       }
       obj["lighting_type"] = s;
     }
+    obj["texture_memory_budget_mb"] = fTextureMemoryBudgetMB;
+    obj["precompute_shading"] = fPrecomputeShading;
+    obj["modern_renderer"] = fModernRenderer;
     configFile.deleteFile();
     juce::FileOutputStream stream(configFile);
     stream.truncate();
@@ -223,6 +245,9 @@ public:
   bool fShowPin = true;
   PaletteType fPaletteType = PaletteType::mcview;
   LightingType fLightingType = LightingType::topLeft;
+  int fTextureMemoryBudgetMB;
+  bool fPrecomputeShading = true;
+  bool fModernRenderer = false;
 
 private:
   static juce::File ConfigFile() {
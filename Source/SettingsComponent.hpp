@@ -140,6 +140,8 @@ class SettingsComponent : public juce::Component {
     std::function<void(PaletteType type)> onPaletteChanged;
     std::function<void(LightingType type)> onLightingChanged;
     std::function<void(bool)> onShowPinChanged;
+    std::function<void(bool)> onPrecomputeShadingChanged;
+    std::function<void(bool)> onModernRendererChanged;
 
     explicit GroupOther(Settings const &settings) {
       using namespace juce;
@@ -196,7 +198,25 @@ class SettingsComponent : public juce::Component {
         }
       };
       addAndMakeVisible(*fShowPin);
-      setSize(400, 220);
+
+      fPrecomputeShading.reset(new ToggleButton(TRANS("Precompute shading")));
+      fPrecomputeShading->setToggleState(settings.fPrecomputeShading, juce::dontSendNotification);
+      fPrecomputeShading->onStateChange = [this]() {
+        if (onPrecomputeShadingChanged) {
+          onPrecomputeShadingChanged(fPrecomputeShading->getToggleState());
+        }
+      };
+      addAndMakeVisible(*fPrecomputeShading);
+
+      fModernRenderer.reset(new ToggleButton(TRANS("Use modern renderer")));
+      fModernRenderer->setToggleState(settings.fModernRenderer, juce::dontSendNotification);
+      fModernRenderer->onStateChange = [this]() {
+        if (onModernRendererChanged) {
+          onModernRendererChanged(fModernRenderer->getToggleState());
+        }
+      };
+      addAndMakeVisible(*fModernRenderer);
+      setSize(400, 330);
     }
 
     void resized() override {
@@ -211,6 +231,14 @@ class SettingsComponent : public juce::Component {
       fLighting->setBounds(bounds.removeFromTop(kRowHeight));
       bounds.removeFromTop(kRowMargin);
       fShowPin->setBounds(bounds.removeFromTop(kRowHeight));
+      bounds.removeFromTop(kRowMargin);
+      fPrecomputeShading->setBounds(bounds.removeFromTop(kRowHeight));
+      bounds.removeFromTop(kRowMargin);
+      fModernRenderer->setBounds(bounds.removeFromTop(kRowHeight));
+    }
+
+    void setModernRenderer(bool modern) {
+      fModernRenderer->setToggleState(modern, juce::dontSendNotification);
     }
 
   private:
@@ -221,6 +249,8 @@ class SettingsComponent : public juce::Component {
     std::unique_ptr<juce::ComboBox> fLighting;
     std::map<LightingType, juce::String> fLightingItems;
     std::unique_ptr<juce::ToggleButton> fShowPin;
+    std::unique_ptr<juce::ToggleButton> fPrecomputeShading;
+    std::unique_ptr<juce::ToggleButton> fModernRenderer;
   };
 
 public:
@@ -229,6 +259,8 @@ public:
   std::function<void(bool)> onBiomeEnableChanged;
   std::function<void(int)> onBiomeBlendChanged;
   std::function<void(bool)> onShowPinChanged;
+  std::function<void(bool)> onPrecomputeShadingChanged;
+  std::function<void(bool)> onModernRendererChanged;
   std::function<void(PaletteType)> onPaletteChanged;
   std::function<void(LightingType type)> onLightingChanged;
 
@@ -267,6 +299,16 @@ public:
         onShowPinChanged(show);
       }
     };
+    other->onPrecomputeShadingChanged = [this](bool precompute) {
+      if (onPrecomputeShadingChanged) {
+        onPrecomputeShadingChanged(precompute);
+      }
+    };
+    other->onModernRendererChanged = [this](bool modern) {
+      if (onModernRendererChanged) {
+        onModernRendererChanged(modern);
+      }
+    };
     other->onPaletteChanged = [this](PaletteType type) {
       if (onPaletteChanged) {
         onPaletteChanged(type);
@@ -301,6 +343,12 @@ public:
   void paint(juce::Graphics &g) override {
   }
 
+  void setModernRenderer(bool modern) {
+    if (auto other = dynamic_cast<GroupOther *>(fGroupOther.get()); other) {
+      other->setModernRenderer(modern);
+    }
+  }
+
   void resized() override {
     int const margin = 10;
     int const width = getWidth();
@@ -0,0 +1,427 @@
+#pragma once
+
+namespace mcview {
+
+// CPU port of color.frag, for exporting maps on machines without an OpenGL context, and as a reference for the output of the GL path.
+// Renders one pixel per texel with every tile faded in, and gathers neighbours from the packed tiles the way the shader does when no shade texture is bound.
+// Pixels match a capture of the GL path except in the void of the end, whose noise depends on the precision of the GPU's sin.
+class SoftwareRenderer {
+public:
+  struct Options {
+    Dimension fDimension = Dimension::Overworld;
+    PaletteType fPalette = PaletteType::mcview;
+    LightingType fLighting = LightingType::topLeft;
+    float fWaterOpticalDensity = 0.02f;
+    bool fWaterTranslucent = true;
+    bool fBiomeEnabled = true;
+    int fBiomeBlend = 2;
+    // Level of detail of the tiles, see RegionToTexture::TextureSize. Levels beyond RegionToTexture::kMaxLod are allowed
+    int fLod = 0;
+  };
+
+  static int constexpr kMaxLod = 8;
+
+  // Packed texture of a region as made by RegionToTexture, reduced to Options::fLod. nullptr if the region has not been rendered. Called from several threads at once
+  using TileSource = std::function<std::shared_ptr<juce::PixelARGB[]>(Region)>;
+
+  SoftwareRenderer(Options options, TileSource source) : fOptions(options), fSource(source) {
+    using namespace mcfile::blocks;
+    fOptions.fLod = std::clamp(fOptions.fLod, 0, kMaxLod);
+    fSize = RegionToTexture::TextureSize(fOptions.fLod);
+    fOptions.fBiomeBlend = std::clamp(fOptions.fBiomeBlend, 0, fSize - 1);
+
+    // Same texels as the palette texture of MapViewComponent, which holds premultiplied colors
+    std::function<std::optional<juce::Colour>(BlockId)> converter = Palette::ColorFromId;
+    if (options.fPalette == PaletteType::java) {
+      converter = Palette::JavaColorFromId;
+    } else if (options.fPalette == PaletteType::bedrock) {
+      converter = Palette::BedrockColorFromId;
+    }
+    fPaletteColors.assign(minecraft::minecraft_max_block_id, RGBA{0, 0, 0, 0});
+    for (BlockId id = 1; id < minecraft::minecraft_max_block_id; id++) {
+      if (auto color = converter(id); color) {
+        fPaletteColors[id] = FromPixel(color->getPixelARGB());
+      }
+    }
+
+    for (int i = 0; i < 8; i++) {
+      auto water = RegionToTexture::kOceanToColor.find((Biome)i);
+      fWaterColors[i] = FromColour(water == RegionToTexture::kOceanToColor.end() ? juce::Colour(Palette::kDefaultOceanColor) : water->second);
+      auto foliage = RegionToTexture::kFoliageToColor.find((Biome)i);
+      fFoliageColors[i] = FromColour(foliage == RegionToTexture::kFoliageToColor.end() ? RegionToTexture::kDefaultFoliageColor : foliage->second);
+    }
+    fDefaultFoliageColor = FromColour(RegionToTexture::kDefaultFoliageColor);
+
+    // Indexed by the 9 bit altitude field, which is the height + 64
+    colormap::kbinani::Altitude altitude;
+    for (int i = 0; i < 512; i++) {
+      float const height = float(i) - 64.0f;
+      auto grass = altitude.getColor((height - 63.0f) / 384.0f);
+      fGrassColors[i] = RGBA{(float)grass.r, (float)grass.g, (float)grass.b, 1.0f};
+      fNetherrackColors[i] = NetherrackColor((height - 31.0f) / (127.0f - 31.0f));
+    }
+    for (int depth = 0; depth < (int)fWaterIntensity.size(); depth++) {
+      fWaterIntensity[depth] = waterIntensity(depth);
+    }
+  }
+
+  // Renders the texels [minX, minX + width) x [minZ, minZ + height) into width * height premultiplied pixels, north to south.
+  // Texels are blocks at lod 0, and 2^lod x 2^lod blocks otherwise. Each region in the area is a job of its own, run on up to numThreads threads.
+  void render(int minX, int minZ, int width, int height, juce::PixelARGB *pixels, int numThreads) const {
+    if (width <= 0 || height <= 0) {
+      return;
+    }
+    int const size = fSize;
+    int const shift = 9 - fOptions.fLod;
+    int const minRx = minX >> shift;
+    int const minRz = minZ >> shift;
+    int const maxRx = (minX + width - 1) >> shift;
+    int const maxRz = (minZ + height - 1) >> shift;
+    int const columns = maxRx - minRx + 1;
+    int const rows = maxRz - minRz + 1;
+
+    // Regions in the area and the ring of neighbours around them
+    int const stride = columns + 2;
+    std::vector<std::shared_ptr<juce::PixelARGB[]>> tiles(stride * (rows + 2));
+    ParallelFor((int)tiles.size(), numThreads, [&](int i) {
+      tiles[i] = fSource(MakeRegion(minRx - 1 + i % stride, minRz - 1 + i / stride));
+    });
+
+    ParallelFor(columns * rows, numThreads, [&](int i) {
+      int const rx = minRx + i % columns;
+      int const rz = minRz + i / columns;
+      Neighbourhood n;
+      n.fSize = size;
+      for (int dz = -1; dz <= 1; dz++) {
+        for (int dx = -1; dx <= 1; dx++) {
+          n.fTiles[dz + 1][dx + 1] = tiles[(rz - minRz + 1 + dz) * stride + (rx - minRx + 1 + dx)].get();
+        }
+      }
+      int const x0 = (std::max)(minX, rx * size);
+      int const x1 = (std::min)(minX + width, rx * size + size);
+      int const z0 = (std::max)(minZ, rz * size);
+      int const z1 = (std::min)(minZ + height, rz * size + size);
+      Row row(x1 - x0);
+      for (int z = z0; z < z1; z++) {
+        juce::PixelARGB *out = pixels + (size_t)(z - minZ) * width + (x0 - minX);
+        if (!n.fTiles[1][1]) {
+          // Nothing is drawn where the region has no tile
+          std::fill_n(out, x1 - x0, juce::PixelARGB(0, 0, 0, 0));
+          continue;
+        }
+        renderRow(n, x0 - rx * size, z - rz * size, x0 - minX, z - minZ, width, height, row, out);
+      }
+    });
+  }
+
+private:
+  struct RGBA {
+    float r;
+    float g;
+    float b;
+    float a;
+  };
+
+  struct HSV {
+    float h;
+    float s;
+    float v;
+  };
+
+  // A tile and its 8 neighbours, as [dz + 1][dx + 1]
+  struct Neighbourhood {
+    juce::PixelARGB const *fTiles[3][3];
+    int fSize;
+
+    // Packed texel at (x, z) relative to the center tile, at most one tile away from it. Like an unbound sampler, missing tiles read as 0
+    juce::uint32 at(int x, int z) const {
+      int const dx = x < 0 ? -1 : (x < fSize ? 0 : 1);
+      int const dz = z < 0 ? -1 : (z < fSize ? 0 : 1);
+      juce::PixelARGB const *tile = fTiles[dz + 1][dx + 1];
+      if (!tile) {
+        return 0;
+      }
+      return tile[(z - dz * fSize) * fSize + (x - dx * fSize)].getInARGBMaskOrder();
+    }
+  };
+
+  // Scratch space for one row of a tile. Kept as separate arrays so that the integer passes over a row vectorize
+  struct Row {
+    explicit Row(int size) : fPacked(size), fNorth(size), fWest(size), fState(size), fColors(size) {}
+
+    std::vector<juce::uint32> fPacked;
+    std::vector<juce::uint32> fNorth;
+    std::vector<juce::uint32> fWest;
+    // north * 4 + west, see RegionToTexture::Shade
+    std::vector<juce::uint8> fState;
+    std::vector<RGBA> fColors;
+  };
+
+  // (x, z): first texel relative to the tile. (px, py): the same pixel in the output
+  void renderRow(Neighbourhood const &n, int x, int z, int px, int py, int width, int height, Row &row, juce::PixelARGB *out) const {
+    int const count = (int)row.fPacked.size();
+    juce::PixelARGB const *center = n.fTiles[1][1] + z * n.fSize + x;
+    for (int i = 0; i < count; i++) {
+      row.fPacked[i] = center[i].getInARGBMaskOrder();
+    }
+    if (z > 0) {
+      for (int i = 0; i < count; i++) {
+        row.fNorth[i] = center[i - n.fSize].getInARGBMaskOrder();
+      }
+    } else {
+      for (int i = 0; i < count; i++) {
+        row.fNorth[i] = n.at(x + i, z - 1);
+      }
+    }
+    row.fWest[0] = n.at(x - 1, z);
+    for (int i = 1; i < count; i++) {
+      row.fWest[i] = row.fPacked[i - 1];
+    }
+
+    for (int i = 0; i < count; i++) {
+      int const h = Altitude(row.fPacked[i]);
+      int const north = Altitude(row.fNorth[i]);
+      int const west = Altitude(row.fWest[i]);
+      row.fState[i] = (juce::uint8)(NeighbourState(north, h) * 4 + NeighbourState(west, h));
+    }
+
+    for (int i = 0; i < count; i++) {
+      row.fColors[i] = colorAt(n, x + i, z, row.fPacked[i], row.fState[i], px + i, py, width, height);
+    }
+
+    // The GL path draws over a transparent framebuffer with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, which leaves premultiplied 8 bit pixels
+    for (int i = 0; i < count; i++) {
+      RGBA const c = row.fColors[i];
+      float const a = Saturate(c.a);
+      out[i].setARGB(ToByte(a * a), ToByte(Saturate(c.r) * a), ToByte(Saturate(c.g) * a), ToByte(Saturate(c.b) * a));
+    }
+  }
+
+  // main() of color.frag for fade = 1
+  RGBA colorAt(Neighbourhood const &n, int x, int z, juce::uint32 packed, juce::uint8 state, int px, int py, int width, int height) const {
+    using namespace mcfile::blocks::minecraft;
+    int const altitude = (int)(packed >> 23);
+    bool const isBlock = ((packed >> 22) & 0x1) == 0x1;
+    int const blockOrDepth = (int)((packed >> 6) & 0xffff);
+    int const depth = isBlock ? 0 : blockOrDepth;
+    int const blockId = isBlock ? blockOrDepth : (int)water;
+    int const biome = (int)((packed >> 3) & 0x7);
+    int const biomeRadius = (int)(packed & 0x7);
+    bool const isTheEnd = fOptions.fDimension == Dimension::TheEnd;
+    bool isVoid = false;
+
+    RGBA c;
+    if (depth > 0) {
+      RGBA wc;
+      if (fOptions.fBiomeEnabled) {
+        if (biomeRadius >= fOptions.fBiomeBlend) {
+          wc = fWaterColors[biome];
+        } else {
+          wc = blendedWaterColor(n, x, z);
+        }
+      } else {
+        wc = paletteColor(water);
+      }
+      if (fOptions.fWaterTranslucent) {
+        float const intensity = depth < (int)fWaterIntensity.size() ? fWaterIntensity[depth] : waterIntensity(depth);
+        c = RGBA{wc.r * intensity, wc.g * intensity, wc.b * intensity, 1.0f};
+      } else {
+        c = wc;
+      }
+    } else if (blockId == oak_leaves) {
+      RGBA const lc = fOptions.fBiomeEnabled ? fFoliageColors[biome] : fDefaultFoliageColor;
+      c = RGBA{lc.r, lc.g, lc.b, 1.0f};
+    } else if (blockId == grass_block && fOptions.fPalette == PaletteType::mcview) {
+      c = fGrassColors[altitude];
+    } else if (blockId == netherrack) {
+      c = fNetherrackColors[altitude];
+    } else if ((blockId == 0 || blockId == air) && isTheEnd) {
+      c = VoidColor(px, py, x, z, n.fSize, width, height);
+      isVoid = true;
+    } else if (blockId == 0) {
+      c = RGBA{0, 0, 0, 0};
+    } else {
+      RGBA const cc = paletteColor(blockId);
+      if (cc.a == 0.0f) {
+        c = cc;
+      } else {
+        c = RGBA{cc.r, cc.g, cc.b, 1.0f};
+      }
+    }
+
+    if (isVoid || (depth > 0 && !fOptions.fWaterTranslucent)) {
+      return c;
+    }
+    int const northState = state / 4;
+    int const westState = state % 4;
+    if (fOptions.fLighting == LightingType::top) {
+      float coeff = 220.0f / 255.0f;
+      if (northState == 1) {
+        coeff = 180.0f / 255.0f;
+      } else if (northState == 2) {
+        coeff = 1.0f;
+      }
+      return RGBA{c.r * coeff, c.g * coeff, c.b * coeff, c.a};
+    }
+    int score = 0;
+    if (northState == 1) {
+      score--;
+    } else if (northState == 2) {
+      score++;
+    }
+    if (westState == 1) {
+      score--;
+    } else if (westState == 2) {
+      score++;
+    }
+    if (score == 0) {
+      return c;
+    }
+    HSV hsv = RGBToHSV(c);
+    hsv.v *= score > 0 ? 1.2f : 0.8f;
+    RGBA const shaded = HSVToRGB(hsv);
+    return RGBA{shaded.r, shaded.g, shaded.b, c.a};
+  }
+
+  // waterColor() of color.frag
+  RGBA blendedWaterColor(Neighbourhood const &n, int x, int z) const {
+    int const blend = fOptions.fBiomeBlend;
+    RGBA sum{0, 0, 0, 0};
+    for (int dx = -blend; dx <= blend; dx++) {
+      for (int dz = -blend; dz <= blend; dz++) {
+        RGBA const c = fWaterColors[(n.at(x + dx, z + dz) >> 3) & 0x7];
+        sum.r += c.r;
+        sum.g += c.g;
+        sum.b += c.b;
+        sum.a += c.a;
+      }
+    }
+    float const count = float((2 * blend + 1) * (2 * blend + 1));
+    return RGBA{sum.r / count, sum.g / count, sum.b / count, sum.a / count};
+  }
+
+  RGBA paletteColor(int blockId) const {
+    if (blockId <= 0 || blockId >= (int)fPaletteColors.size()) {
+      return RGBA{0, 0, 0, 0};
+    }
+    return fPaletteColors[blockId];
+  }
+
+  float waterIntensity(int depth) const {
+    return std::pow(10.0f, -fOptions.fWaterOpticalDensity * (float(depth) / 127.0f * 255.0f));
+  }
+
+  static int Altitude(juce::uint32 packed) {
+    return (int)(packed >> 23) - 64;
+  }
+
+  // 0: none, 1: neighbour is higher, 2: lower, 3: same
+  static int NeighbourState(int neighbour, int center) {
+    return neighbour <= 0 ? 0 : (neighbour > center ? 1 : (neighbour < center ? 2 : 3));
+  }
+
+  static RGBA NetherrackColor(float x) {
+    float const vmin = 16.0f / 100.0f;
+    float const vmax = 50.0f / 100.0f;
+    RGBA c = HSVToRGB(HSV{1.0f / 360.0f, 64.0f / 100.0f, vmin + (vmax - vmin) * Clamp(1.0f - x, 0.0f, 1.0f)});
+    c.a = 1.0f;
+    return c;
+  }
+
+  // voidColor() of color.frag. gl_FragCoord is taken as the pixel center in the output, textureCoordOut as the texel center in the tile
+  static RGBA VoidColor(int px, int py, int tx, int tz, int size, int width, int height) {
+    auto rand = [](float n) {
+      return Fract(std::sin(n) * 43758.5453123f);
+    };
+    auto noise = [](float x, float y) {
+      return Fract(std::sin(x * 12.9898f + y * 78.233f) * 43758.5453f);
+    };
+    float const s1 = (rand(float(px) + 0.5f) + rand((float(tx) + 0.5f) / float(size))) * 0.5f * float(width);
+    float const s2 = (rand(float(py) + 0.5f) + rand((float(tz) + 0.5f) / float(size))) * 0.5f * float(height);
+    float const x = noise(s1, s2);
+    float const y = noise(s2, s1);
+    float const bm1 = std::sqrt(-2.0f * std::log(x)) * std::cos(2.0f * 3.1415926f * y);
+    float const bm2 = std::sqrt(-2.0f * std::log(y)) * std::sin(2.0f * 3.1415926f * x);
+
+    float const s = Clamp(0.448486f + bm1 * 0.0703466f, 0.0810811f, 0.6f);
+    float const v = Clamp(0.0958848f + bm2 * 0.0170297f, 0.0117647f, 0.145098f);
+    RGBA c = HSVToRGB(HSV{0.733309f, s, v});
+    c.a = 1.0f;
+    return c;
+  }
+
+  // rgb2hsv and hsv2rgb of color.frag, step and mix expanded
+  static HSV RGBToHSV(RGBA c) {
+    float const K[4] = {0.0f, -1.0f / 3.0f, 2.0f / 3.0f, -1.0f};
+    float p[4];
+    if (c.b <= c.g) {
+      p[0] = c.g, p[1] = c.b, p[2] = K[0], p[3] = K[1];
+    } else {
+      p[0] = c.b, p[1] = c.g, p[2] = K[3], p[3] = K[2];
+    }
+    float q[4];
+    if (p[0] <= c.r) {
+      q[0] = c.r, q[1] = p[1], q[2] = p[2], q[3] = p[0];
+    } else {
+      q[0] = p[0], q[1] = p[1], q[2] = p[3], q[3] = c.r;
+    }
+    float const d = q[0] - (std::min)(q[3], q[1]);
+    float const e = 1.0e-10f;
+    return HSV{std::abs(q[2] + (q[3] - q[1]) / (6.0f * d + e)), d / (q[0] + e), q[0]};
+  }
+
+  static RGBA HSVToRGB(HSV c) {
+    float const K[3] = {1.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float rgb[3];
+    for (int i = 0; i < 3; i++) {
+      float const p = std::abs(Fract(c.h + K[i]) * 6.0f - 3.0f);
+      rgb[i] = c.v * (1.0f - c.s + Clamp(p - 1.0f, 0.0f, 1.0f) * c.s);
+    }
+    return RGBA{rgb[0], rgb[1], rgb[2], 1.0f};
+  }
+
+  static RGBA FromPixel(juce::PixelARGB p) {
+    return RGBA{p.getRed() / 255.0f, p.getGreen() / 255.0f, p.getBlue() / 255.0f, p.getAlpha() / 255.0f};
+  }
+
+  static RGBA FromColour(juce::Colour c) {
+    return RGBA{c.getRed() / 255.0f, c.getGreen() / 255.0f, c.getBlue() / 255.0f, 1.0f};
+  }
+
+  static float Fract(float x) {
+    return x - std::floor(x);
+  }
+
+  // min(max()) as in GLSL, so that NaN clamps to the lower bound
+  static float Clamp(float x, float lo, float hi) {
+    return std::fmin(std::fmax(x, lo), hi);
+  }
+
+  static float Saturate(float x) {
+    return Clamp(x, 0.0f, 1.0f);
+  }
+
+  static juce::uint8 ToByte(float x) {
+    return (juce::uint8)(x * 255.0f + 0.5f);
+  }
+
+private:
+  Options fOptions;
+  TileSource const fSource;
+  // Texels per region side
+  int fSize;
+  // Indexed by block id
+  std::vector<RGBA> fPaletteColors;
+  std::array<RGBA, 8> fWaterColors;
+  std::array<RGBA, 8> fFoliageColors;
+  RGBA fDefaultFoliageColor;
+  // Indexed by the altitude field of a texel
+  std::array<RGBA, 512> fGrassColors;
+  std::array<RGBA, 512> fNetherrackColors;
+  // Indexed by the water depth field, which is at most 127
+  std::array<float, 128> fWaterIntensity;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SoftwareRenderer)
+};
+
+} // namespace mcview
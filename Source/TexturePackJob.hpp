@@ -6,12 +6,61 @@ class TexturePackJob : public ThreadPoolJob {
 public:
   class Result {
   public:
-    Result(juce::File worldDirectory, Dimension dimension, Region region) : fWorldDirectory(worldDirectory), fDimension(dimension), fRegion(region) {}
+    Result(juce::File worldDirectory, Dimension dimension, Region region) : fWorldDirectory(worldDirectory), fDimension(dimension), fRegion(region), fProvisional(false), fShadeBiomeBlend(-1) {}
 
     juce::File const fWorldDirectory;
     Dimension const fDimension;
     Region const fRegion;
-    std::unique_ptr<juce::PixelARGB[]> fPixels;
+    std::shared_ptr<juce::PixelARGB[]> fPixels;
+    // fLods[i] is the reduced texture of level i + 1
+    std::vector<std::shared_ptr<juce::PixelARGB[]>> fLods;
+    // Partially rendered while the job is still running. The final result follows.
+    bool fProvisional;
+    // fShades[lod] is RegionToTexture::Shade of pixels(lod), computed with fShadeBiomeBlend. Empty when fShadeBiomeBlend < 0
+    std::vector<std::shared_ptr<juce::PixelARGB[]>> fShades;
+    int fShadeBiomeBlend;
+
+    void buildLods() {
+      Trace::Span span("TexturePackJob::buildLods", fRegion);
+      fLods.clear();
+      if (!fPixels) {
+        return;
+      }
+      juce::PixelARGB const *source = fPixels.get();
+      for (int lod = 1; lod <= RegionToTexture::kMaxLod; lod++) {
+        std::shared_ptr<juce::PixelARGB[]> reduced(RegionToTexture::Downsample(source, RegionToTexture::TextureSize(lod - 1)));
+        fLods.push_back(reduced);
+        source = reduced.get();
+      }
+    }
+
+    void buildShades(int biomeBlend) {
+      Trace::Span span("TexturePackJob::buildShades", fRegion);
+      fShades.clear();
+      fShadeBiomeBlend = -1;
+      if (!fPixels) {
+        return;
+      }
+      for (int lod = 0; lod <= (int)fLods.size(); lod++) {
+        fShades.emplace_back(RegionToTexture::Shade(pixels(lod), RegionToTexture::TextureSize(lod), biomeBlend));
+      }
+      fShadeBiomeBlend = biomeBlend;
+    }
+
+    juce::PixelARGB *shade(int lod) const {
+      if (lod < 0 || (int)fShades.size() <= lod) {
+        return nullptr;
+      }
+      return fShades[lod].get();
+    }
+
+    juce::PixelARGB *pixels(int lod) const {
+      if (lod <= 0) {
+        return fPixels.get();
+      }
+      assert(lod <= (int)fLods.size());
+      return fLods[lod - 1].get();
+    }
   };
 
   class Delegate {
@@ -20,15 +69,35 @@ public:
     virtual void texturePackJobDidFinish(std::shared_ptr<Result> result) = 0;
   };
 
-  TexturePackJob(juce::String name, Region region, Delegate *delegate) : ThreadPoolJob(name), fRegion(region), fDelegate(delegate) {}
+  TexturePackJob(juce::String name, Region region, TileCacheWriter *cacheWriter, Delegate *delegate) : ThreadPoolJob(name), fRegion(region), fCacheWriter(cacheWriter), fDelegate(delegate) {}
   ~TexturePackJob() override = default;
 
   static juce::String CacheDirPrefix() {
-    return juce::String("v7.");
+    return juce::String("v8.");
   }
 
-protected:
-  static bool LoadCache(std::unique_ptr<juce::PixelARGB[]> &pixels, std::optional<int64_t> timestamp, juce::File file) {
+  static void StoreCache(juce::PixelARGB const *pixels, int64_t timestamp, juce::File file) {
+    Trace::Span span("TexturePackJob::StoreCache");
+    file.getParentDirectory().createDirectory();
+    juce::TemporaryFile temp(file);
+    {
+      juce::FileOutputStream out(temp.getFile());
+      if (!out.openedOk()) {
+        return;
+      }
+      juce::GZIPCompressorOutputStream gzip(out, 9);
+      if (!gzip.write(&timestamp, sizeof(timestamp))) {
+        return;
+      }
+      if (!gzip.write(pixels, sizeof(juce::PixelARGB) * 512 * 512)) {
+        return;
+      }
+    }
+    temp.overwriteTargetFileWithTemporary();
+  }
+
+  static bool LoadCache(std::shared_ptr<juce::PixelARGB[]> &pixels, std::optional<int64_t> timestamp, juce::File file) {
+    Trace::Span span("TexturePackJob::LoadCache");
     juce::FileInputStream stream(file);
     if (!stream.openedOk()) {
       return false;
@@ -50,46 +119,66 @@ protected:
     }
   }
 
-  static void StoreCache(juce::PixelARGB const *pixels, int64_t timestamp, juce::File file) {
-    auto out = std::make_unique<juce::FileOutputStream>(file);
-    if (!out->openedOk()) {
-      return;
-    }
-    if (!out->setPosition(0)) {
-      return;
-    }
-    if (auto ret = out->truncate(); ret.failed()) {
-      return;
-    }
-    juce::GZIPCompressorOutputStream gzip(*out, 9);
-    if (!gzip.write(&timestamp, sizeof(timestamp))) {
-      return;
-    }
-    if (!gzip.write(pixels, sizeof(juce::PixelARGB) * 512 * 512)) {
-      return;
-    }
+  // Cached tiles are keyed by a fingerprint of the region's content, so that moved or copied worlds share them.
+  // Tiles no index refers to anymore are removed by DirectoryCleanupThread
+  static juce::File CacheContentDirectory() {
+    return CacheDirectory().getChildFile(CacheDirPrefix() + "content");
   }
 
-  static juce::File CacheFile(juce::File const &worldDirectory, Dimension dim, Region region) {
+  static juce::File CacheFile(uint64_t fingerprint) {
+    return CacheContentDirectory().getChildFile(Fingerprint::ToString(fingerprint) + ".gz");
+  }
+
+  // Path keyed index, which remembers the fingerprint of the tile last rendered for the region.
+  // This is only a hint: the content may have changed since then.
+  static juce::File CacheIndexFile(juce::File const &worldDirectory, Dimension dim, Region region) {
     using namespace juce;
-    File cache = CacheDirectory();
-    if (!cache.exists()) {
-      cache.createDirectory();
-    }
     String hashSource = worldDirectory.getFullPathName();
     hashSource += "\n" + String(static_cast<int>(dim));
     String dirname = CacheDirPrefix() + String(hashSource.hashCode64());
-    File dir = cache.getChildFile(dirname);
-    if (!dir.exists()) {
-      dir.createDirectory();
+    File dir = CacheDirectory().getChildFile(dirname);
+    return dir.getChildFile(String("r.") + String(region.first) + "." + String(region.second) + String(".idx"));
+  }
+
+  static std::optional<uint64_t> LoadCacheIndex(juce::File const &worldDirectory, Dimension dim, Region region) {
+    juce::File index = CacheIndexFile(worldDirectory, dim, region);
+    if (!index.existsAsFile()) {
+      return std::nullopt;
+    }
+    return Fingerprint::FromString(index.loadFileAsString().trim());
+  }
+
+protected:
+  void storeCacheIndex(juce::File const &worldDirectory, Dimension dim, uint64_t fingerprint) const {
+    fCacheWriter->enqueueIndex(CacheIndexFile(worldDirectory, dim, fRegion), Fingerprint::ToString(fingerprint));
+  }
+
+  RegionToTexture::ProgressCallback provisionalDelivery(juce::File worldDirectory, Dimension dim) {
+    return [this, worldDirectory, dim](juce::PixelARGB *pixels) {
+      auto result = std::make_shared<Result>(worldDirectory, dim, fRegion);
+      result->fPixels.reset(pixels);
+      result->fProvisional = true;
+      result->buildLods();
+      fDelegate->texturePackJobDidFinish(result);
+    };
+  }
+
+  bool loadCache(std::shared_ptr<juce::PixelARGB[]> &pixels, std::optional<int64_t> timestamp, juce::File file) const {
+    if (auto pending = fCacheWriter->find(file, timestamp); pending) {
+      pixels = pending;
+      return true;
+    }
+    if (!file.existsAsFile()) {
+      return false;
     }
-    return dir.getChildFile(String("r.") + String(region.first) + "." + String(region.second) + String(".gz"));
+    return LoadCache(pixels, timestamp, file);
   }
 
 public:
   Region const fRegion;
 
 protected:
+  TileCacheWriter *const fCacheWriter;
   Delegate *const fDelegate;
 };
 
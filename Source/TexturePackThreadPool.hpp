@@ -2,25 +2,57 @@
 
 namespace mcview {
 
-class TexturePackThreadPool : public ThreadPool, public TexturePackJob::Delegate {
+class TexturePackThreadPool : public ThreadPool, public TexturePackJob::Delegate, public OverviewJob::Delegate {
 public:
   struct Delegate {
     virtual ~Delegate() = default;
     virtual void texturePackThreadPoolDidFinishJob(TexturePackThreadPool *pool, std::shared_ptr<TexturePackJob::Result> result) = 0;
+    virtual void texturePackThreadPoolDidFinishOverviewJob(TexturePackThreadPool *pool, std::shared_ptr<OverviewJob::Result> result) {}
   };
 
-  explicit TexturePackThreadPool(Delegate *delegate) : ThreadPool((std::max)(1, (int)std::thread::hardware_concurrency() - 1)), fLookAt(LookAt()), fDelegate(delegate) {}
+  TexturePackThreadPool(std::shared_ptr<TileCacheWriter> cacheWriter, Delegate *delegate) : ThreadPool((std::max)(1, (int)std::thread::hardware_concurrency() - 1)), fGeneration(NextGeneration()), fCacheWriter(cacheWriter), fLookAt(LookAt()), fDelegate(delegate) {}
   virtual ~TexturePackThreadPool() {}
 
   virtual void addTexturePackJob(Region region, bool useCache) {}
 
+  // regions: regions in the tile known to exist
+  void addOverviewJob(juce::File worldDirectory, Dimension dim, OverviewTile tile, std::vector<Region> regions) {
+    addJob(new OverviewJob(worldDirectory, dim, tile, regions, fCacheWriter.get(), this), true);
+  }
+
+  // Shades are precomputed for final results while biomeBlend >= 0
+  void setShadeBiomeBlend(int biomeBlend) {
+    fShadeBiomeBlend.store(biomeBlend);
+  }
+
+  // Delivers a copy of a final result with shades for the current biome blend, computed from its pixels without loading the region again
+  void addReshadeJob(std::shared_ptr<TexturePackJob::Result> result) {
+    addJob([this, result]() {
+      auto copy = std::make_shared<TexturePackJob::Result>(result->fWorldDirectory, result->fDimension, result->fRegion);
+      copy->fPixels = result->fPixels;
+      copy->fLods = result->fLods;
+      texturePackJobDidFinish(copy);
+    });
+  }
+
   void texturePackJobDidFinish(std::shared_ptr<TexturePackJob::Result> result) override {
+    // Still on the worker thread here
+    if (int const biomeBlend = fShadeBiomeBlend.load(); biomeBlend >= 0 && !result->fProvisional) {
+      result->buildShades(biomeBlend);
+    }
     std::lock_guard<std::mutex> lock(fMut);
     if (fDelegate) {
       fDelegate->texturePackThreadPoolDidFinishJob(this, result);
     }
   }
 
+  void overviewJobDidFinish(std::shared_ptr<OverviewJob::Result> result) override {
+    std::lock_guard<std::mutex> lock(fMut);
+    if (fDelegate) {
+      fDelegate->texturePackThreadPoolDidFinishOverviewJob(this, result);
+    }
+  }
+
   int compareJobs(ThreadPoolJob *a, ThreadPoolJob *b) override {
     TexturePackJob *jobA = dynamic_cast<TexturePackJob *>(a);
     TexturePackJob *jobB = dynamic_cast<TexturePackJob *>(b);
@@ -58,8 +90,20 @@ public:
     fLookAt.store(la);
   }
 
+  // Unique among the pools of the process. Unlike the address of a pool, it is never reused by the pool created after this one is destroyed
+  uint64_t const fGeneration;
+
+protected:
+  std::shared_ptr<TileCacheWriter> const fCacheWriter;
+
 private:
+  static uint64_t NextGeneration() {
+    static std::atomic<uint64_t> sGeneration(0);
+    return ++sGeneration;
+  }
+
   std::atomic<LookAt> fLookAt;
+  std::atomic<int> fShadeBiomeBlend = -1;
   std::mutex fMut;
   Delegate *fDelegate;
 };
@@ -0,0 +1,166 @@
+#pragma once
+
+namespace mcview {
+
+// Keeps region textures resident while they fit in the budget, and recycles evicted ones.
+// Textures live either in TileTextureArrays (one per level of detail) when enabled, or in individual OpenGLTextures.
+// The budget counts bytes, so reduced textures of a zoomed out view take proportionally less of it.
+// Must be used from the GL thread, except for setBudget.
+class TextureResidency {
+public:
+  static size_t constexpr kMaxRecycledTextures = 32;
+
+  TextureResidency() : fBudget(int64_t(Settings::kDefaultTextureMemoryBudgetMB) * 1024 * 1024), fFrame(0) {}
+
+  void setBudget(int64_t bytes) {
+    fBudget.store(bytes);
+  }
+
+  uint64_t beginFrame() {
+    return ++fFrame;
+  }
+
+  uint64_t frame() const {
+    return fFrame;
+  }
+
+  std::unique_ptr<juce::OpenGLTexture> acquire() {
+    if (fRecycled.empty()) {
+      return std::make_unique<juce::OpenGLTexture>();
+    }
+    auto texture = std::move(fRecycled.back());
+    fRecycled.pop_back();
+    return texture;
+  }
+
+  // integer: layers are GL_RGBA8UI. See TileTextureArray
+  void setTextureArraysEnabled(bool enabled, bool integer = false) {
+    if (!enabled || integer != fArraysInteger) {
+      fArrays.clear();
+    }
+    fArraysEnabled = enabled;
+    fArraysInteger = integer;
+  }
+
+  bool usesTextureArrays() const {
+    return fArraysEnabled;
+  }
+
+  bool usesIntegerTextureArrays() const {
+    return fArraysEnabled && fArraysInteger;
+  }
+
+  // Number of planes of the texture arrays. Changing it drops the arrays, so every cache must be released beforehand.
+  void setTextureArrayPlanes(int planes) {
+    if (fArrayPlanes != planes) {
+      fArrays.clear();
+    }
+    fArrayPlanes = planes;
+  }
+
+  int textureArrayPlanes() const {
+    return fArrayPlanes;
+  }
+
+  // Returns nullptr unless texture arrays are enabled.
+  TileTextureArray *textureArray(int lod) {
+    if (!fArraysEnabled || lod < 0) {
+      return nullptr;
+    }
+    if (fArrays.size() <= (size_t)lod) {
+      fArrays.resize(lod + 1);
+    }
+    if (!fArrays[lod]) {
+      fArrays[lod] = std::make_unique<TileTextureArray>(512 >> lod, fArrayPlanes, fArraysInteger);
+    }
+    return fArrays[lod].get();
+  }
+
+  // Registers a cache that has just been loaded, so that it becomes a candidate for eviction.
+  void track(RegionTextureCache &cache) {
+    if (cache.isResident()) {
+      fResident.insert(&cache);
+    }
+  }
+
+  void release(RegionTextureCache &cache) {
+    fResident.erase(&cache);
+    recycle(std::move(cache.fTexture));
+    recycle(std::move(cache.fShadeTexture));
+    cache.fShadeBiomeBlend = -1;
+    if (cache.fLayer >= 0) {
+      if ((size_t)cache.fLod < fArrays.size() && fArrays[cache.fLod]) {
+        fArrays[cache.fLod]->free(cache.fLayer);
+      }
+      cache.fLayer = -1;
+    }
+  }
+
+  void recycle(std::unique_ptr<juce::OpenGLTexture> texture) {
+    if (!texture) {
+      return;
+    }
+    if (fRecycled.size() >= kMaxRecycledTextures) {
+      return;
+    }
+    fRecycled.push_back(std::move(texture));
+  }
+
+  // Returns the number of evicted textures. Only tracked caches are visited, so the cost doesn't depend on the number of known regions.
+  int evict(int minRx, int minRz, int maxRx, int maxRz, LookAt lookAt) {
+    int64_t resident = 0;
+    std::vector<RegionTextureCache *> candidates;
+    for (RegionTextureCache *cache : fResident) {
+      resident += cache->residentBytes();
+      auto [rx, rz] = cache->fRegion;
+      if (minRx <= rx && rx <= maxRx && minRz <= rz && rz <= maxRz) {
+        continue;
+      }
+      candidates.push_back(cache);
+    }
+    int64_t const budget = fBudget.load();
+    if (resident <= budget) {
+      return 0;
+    }
+    juce::Point<float> center(lookAt.fX, lookAt.fZ);
+    std::sort(candidates.begin(), candidates.end(), [center](RegionTextureCache const *a, RegionTextureCache const *b) {
+      if (a->fLastVisibleFrame != b->fLastVisibleFrame) {
+        return a->fLastVisibleFrame < b->fLastVisibleFrame;
+      }
+      juce::Point<float> posA(a->fRegion.first * 512 + 256, a->fRegion.second * 512 + 256);
+      juce::Point<float> posB(b->fRegion.first * 512 + 256, b->fRegion.second * 512 + 256);
+      return posA.getDistanceSquaredFrom(center) > posB.getDistanceSquaredFrom(center);
+    });
+    int evicted = 0;
+    for (auto cache : candidates) {
+      if (resident <= budget) {
+        break;
+      }
+      resident -= cache->residentBytes();
+      release(*cache);
+      evicted++;
+    }
+    return evicted;
+  }
+
+  void clear() {
+    fResident.clear();
+    fRecycled.clear();
+    fArrays.clear();
+    fArraysEnabled = false;
+    fArraysInteger = false;
+  }
+
+private:
+  std::atomic<int64_t> fBudget;
+  uint64_t fFrame;
+  std::vector<std::unique_ptr<juce::OpenGLTexture>> fRecycled;
+  bool fArraysEnabled = false;
+  bool fArraysInteger = false;
+  int fArrayPlanes = 1;
+  std::vector<std::unique_ptr<TileTextureArray>> fArrays;
+  // Caches holding a texture or a layer. They are owned by the caller, which must release them before deleting
+  std::unordered_set<RegionTextureCache *> fResident;
+};
+
+} // namespace mcview
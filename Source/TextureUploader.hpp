@@ -0,0 +1,86 @@
+#pragma once
+
+namespace mcview {
+
+// Streams texture uploads through a ring of pixel unpack buffers, so that glTexImage/glTexSubImage return without waiting for the driver to copy the pixels.
+// Falls back to plain client memory uploads when pixel buffer objects are not available. Must be used from the GL thread.
+class TextureUploader {
+public:
+  static int constexpr kNumBuffers = 4;
+
+  TextureUploader() : fBuffers(kNumBuffers, 0), fIndex(0) {}
+
+  ~TextureUploader() {
+    release();
+  }
+
+  static bool IsSupported() {
+    using namespace juce::gl;
+    if (glMapBuffer == nullptr || glUnmapBuffer == nullptr || glBufferData == nullptr) {
+      return false;
+    }
+    return juce::OpenGLHelpers::isExtensionSupported("GL_ARB_pixel_buffer_object") || juce::OpenGLHelpers::isExtensionSupported("GL_EXT_pixel_buffer_object");
+  }
+
+  // Calls upload with a pointer to use as the source of a texture upload call: an offset into the bound unpack buffer, or pixels itself.
+  template <class Upload>
+  void upload(juce::PixelARGB const *pixels, int size, Upload &&upload) {
+    using namespace juce::gl;
+    if (!fSupported) {
+      fSupported = IsSupported();
+    }
+    if (!*fSupported || !pixels) {
+      upload(pixels);
+      return;
+    }
+    if (fBuffers[0] == 0) {
+      glGenBuffers(kNumBuffers, fBuffers.data());
+    }
+    GLsizeiptr const bytes = (GLsizeiptr)size * size * sizeof(juce::PixelARGB);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, fBuffers[fIndex]);
+    fIndex = (fIndex + 1) % kNumBuffers;
+    // Orphan the previous storage, which may still be read by a pending upload
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    void *mapped = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    if (!mapped) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      upload(pixels);
+      return;
+    }
+    std::memcpy(mapped, pixels, (size_t)bytes);
+    if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) != GL_TRUE) {
+      // Contents were lost, eg. on a display mode change
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      upload(pixels);
+      return;
+    }
+    upload(static_cast<juce::PixelARGB const *>(nullptr));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+
+  // Filtering is a property of the texture, so it is set once after the upload rather than on each bind.
+  // Applies to the texture bound to GL_TEXTURE_2D of the active unit.
+  static void SetNearestFilter() {
+    using namespace juce::gl;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  }
+
+  void release() {
+    using namespace juce::gl;
+    if (fBuffers[0] != 0) {
+      glDeleteBuffers(kNumBuffers, fBuffers.data());
+    }
+    std::fill(fBuffers.begin(), fBuffers.end(), 0);
+    fSupported = std::nullopt;
+  }
+
+private:
+  std::vector<GLuint> fBuffers;
+  int fIndex;
+  std::optional<bool> fSupported;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TextureUploader)
+};
+
+} // namespace mcview
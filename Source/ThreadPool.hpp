@@ -105,6 +105,8 @@ private:
   juce::String jobName;
   ThreadPool *pool = nullptr;
   std::atomic<bool> shouldStop{false}, isActive{false}, shouldBeDeleted{false};
+  // High resolution ticks when the job was last queued, while tracing
+  juce::int64 queuedTicks = 0;
   juce::ListenerList<juce::Thread::Listener, juce::Array<juce::Thread::Listener *, juce::CriticalSection>> listeners;
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ThreadPoolJob)
@@ -203,6 +205,7 @@ public:
       job->shouldStop = false;
       job->isActive = false;
       job->shouldBeDeleted = deleteJobWhenFinished;
+      job->queuedTicks = Trace::Enabled() ? juce::Time::getHighResolutionTicks() : 0;
 
       {
         const juce::ScopedLock sl(lock);
@@ -449,8 +452,12 @@ private:
     if (auto *job = pickNextJobToRun()) {
       auto result = ThreadPoolJob::jobHasFinished;
       thread.currentJob = job;
+      if (job->queuedTicks != 0) {
+        Trace::Record("ThreadPool::queue", job->queuedTicks, juce::Time::getHighResolutionTicks());
+      }
 
       try {
+        Trace::Span span("ThreadPool::runJob");
         result = job->runJob();
       } catch (...) {
         jassertfalse; // Your runJob() method mustn't throw any exceptions!
@@ -474,6 +481,7 @@ private:
           } else {
             // move the job to the end of the queue if it wants another go
             jobs.move(jobs.indexOf(job), -1);
+            job->queuedTicks = Trace::Enabled() ? juce::Time::getHighResolutionTicks() : 0;
           }
         }
       }
@@ -0,0 +1,172 @@
+#pragma once
+
+namespace mcview {
+
+class TileCacheWriter : public juce::Thread {
+  // A tile when fPixels is set, otherwise the text of a cache index
+  struct Entry {
+    std::shared_ptr<juce::PixelARGB[]> fPixels;
+    int64_t fTimestamp;
+    juce::File fFile;
+    juce::String fIndex;
+  };
+
+public:
+  using StoreFunction = std::function<void(juce::PixelARGB const *pixels, int64_t timestamp, juce::File file)>;
+
+  static size_t constexpr kMaxPendingWrites = 64;
+  static int constexpr kShutdownTimeoutMS = 3000;
+
+  explicit TileCacheWriter(StoreFunction store) : juce::Thread("Tile cache writer"), fStore(store), fUnwritten(0), fClosed(false) {
+  }
+
+  ~TileCacheWriter() override {
+    close();
+    stopThread(-1);
+  }
+
+  void start() {
+    startThread(juce::Thread::Priority::background);
+  }
+
+  void enqueue(std::shared_ptr<juce::PixelARGB[]> pixels, int64_t timestamp, juce::File file) {
+    if (!pixels) {
+      return;
+    }
+    push({pixels, timestamp, file, {}});
+  }
+
+  // Writes text to file unless it already holds it, so that pack threads don't wait for the disk
+  void enqueueIndex(juce::File file, juce::String text) {
+    push({nullptr, 0, file, text});
+  }
+
+  // An unchanged index is touched, its modification time tells DirectoryCleanupThread when the region was last seen
+  static void StoreIndex(juce::File const &file, juce::String const &text) {
+    if (file.existsAsFile() && file.loadFileAsString().trim() == text) {
+      file.setLastModificationTime(juce::Time::getCurrentTime());
+      return;
+    }
+    file.getParentDirectory().createDirectory();
+    file.replaceWithText(text);
+  }
+
+  std::shared_ptr<juce::PixelARGB[]> find(juce::File const &file, std::optional<int64_t> timestamp) {
+    std::lock_guard<std::mutex> lock(fMut);
+    for (auto const *queue : {&fPending, &fWriting}) {
+      for (auto it = queue->rbegin(); it != queue->rend(); it++) {
+        if (it->fFile != file || !it->fPixels) {
+          continue;
+        }
+        if (!timestamp || it->fTimestamp >= *timestamp) {
+          return it->fPixels;
+        }
+        return nullptr;
+      }
+    }
+    return nullptr;
+  }
+
+  // Blocks until every entry enqueued so far has been written.
+  void flush() {
+    std::unique_lock<std::mutex> lock(fMut);
+    fCanEnqueue.wait(lock, [this]() {
+      return fClosed || (fPending.empty() && fWriting.empty());
+    });
+  }
+
+  // Stops accepting new entries. Pending entries are flushed until kShutdownTimeoutMS elapses, then dropped.
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(fMut);
+      fClosed = true;
+    }
+    fCanEnqueue.notify_all();
+    signalThreadShouldExit();
+    notify();
+  }
+
+  void run() override {
+    while (!threadShouldExit()) {
+      if (!writeBatch(std::nullopt)) {
+        wait(-1);
+      }
+    }
+    juce::uint32 const deadline = juce::Time::getMillisecondCounter() + kShutdownTimeoutMS;
+    while (writeBatch(deadline)) {
+    }
+    std::lock_guard<std::mutex> lock(fMut);
+    if (int const dropped = fUnwritten + (int)fPending.size(); dropped > 0) {
+      juce::Logger::writeToLog("Dropped " + juce::String(dropped) + " pending cache writes");
+    }
+    fPending.clear();
+    fClosed = true;
+    fCanEnqueue.notify_all();
+  }
+
+private:
+  void push(Entry entry) {
+    {
+      std::unique_lock<std::mutex> lock(fMut);
+      fCanEnqueue.wait(lock, [this]() {
+        return fClosed || fPending.size() < kMaxPendingWrites;
+      });
+      if (fClosed) {
+        return;
+      }
+      for (auto &it : fPending) {
+        if (it.fFile == entry.fFile) {
+          it = entry;
+          return;
+        }
+      }
+      fPending.push_back(entry);
+    }
+    notify();
+  }
+
+  bool writeBatch(std::optional<juce::uint32> deadline) {
+    {
+      std::lock_guard<std::mutex> lock(fMut);
+      if (fPending.empty()) {
+        return false;
+      }
+      fWriting.swap(fPending);
+    }
+    fCanEnqueue.notify_all();
+
+    size_t written = 0;
+    for (auto const &entry : fWriting) {
+      if (deadline && juce::Time::getMillisecondCounter() > *deadline) {
+        break;
+      }
+      written++;
+      if (entry.fPixels) {
+        fStore(entry.fPixels.get(), entry.fTimestamp, entry.fFile);
+      } else {
+        StoreIndex(entry.fFile, entry.fIndex);
+      }
+    }
+
+    bool const timedOut = written < fWriting.size();
+    {
+      std::lock_guard<std::mutex> lock(fMut);
+      // Entries of the batch left when the deadline passed
+      fUnwritten += (int)(fWriting.size() - written);
+      fWriting.clear();
+    }
+    fCanEnqueue.notify_all();
+    return !timedOut;
+  }
+
+private:
+  StoreFunction const fStore;
+  std::mutex fMut;
+  std::condition_variable fCanEnqueue;
+  std::deque<Entry> fPending;
+  std::deque<Entry> fWriting;
+  int fUnwritten;
+  bool fClosed;
+};
+
+} // namespace mcview
@@ -0,0 +1,348 @@
+#pragma once
+
+namespace mcview {
+
+// Tile of a slippy map pyramid. Tiles of kMaxZoom draw one block per pixel, and each level below halves the one above it.
+// fX grows to the east and fY to the south, counted in tiles from block (0, 0).
+struct PyramidTile {
+  int fZoom;
+  int fX;
+  int fY;
+
+  PyramidTile parent() const {
+    // Arithmetic shift rounds toward negative infinity
+    return {fZoom - 1, fX >> 1, fY >> 1};
+  }
+
+  // 0: north west, 1: north east, 2: south west, 3: south east
+  PyramidTile child(int i) const {
+    return {fZoom + 1, fX * 2 + (i & 1), fY * 2 + (i >> 1)};
+  }
+
+  bool operator<(PyramidTile const &other) const {
+    return std::tie(fZoom, fX, fY) < std::tie(other.fZoom, other.fX, other.fY);
+  }
+};
+
+// Exports a dimension as a pyramid of PNG tiles, <directory>/<z>/<x>/<y>.png, for slippy map viewers such as Leaflet.
+// The most detailed level is drawn by SoftwareRenderer from the tile cache, and every level below is downsampled from the PNGs of its children.
+// The fingerprint of each region is kept in <directory>/manifest.json, so that the next export only redraws tiles whose regions have changed.
+class TilePyramid {
+public:
+  static int constexpr kTileSize = 256;
+  static int constexpr kMinZoom = 0;
+  static int constexpr kMaxZoom = 8;
+  // Bump to redraw every pyramid when SoftwareRenderer changes its output
+  static int constexpr kVersion = 1;
+  // Widest strip of regions drawn at once, 16 MiB of pixels
+  static int constexpr kMaxStripRegions = 16;
+
+  struct Stats {
+    int fWritten = 0;
+    int fRemoved = 0;
+    // Regions whose fingerprint matched the manifest
+    int fUnchanged = 0;
+  };
+
+  // fingerprints: content fingerprint of every region of the dimension, see TexturePackJob::LoadCacheIndex. source: packed tile of a region
+  TilePyramid(juce::File directory, SoftwareRenderer::Options options, std::map<Region, uint64_t> fingerprints, SoftwareRenderer::TileSource source)
+      : fDirectory(directory),
+        fOptions(options),
+        fFingerprints(fingerprints),
+        fRenderer(options, [this, source](Region region) -> std::shared_ptr<juce::PixelARGB[]> {
+          // The cache index outlives deleted regions, so only regions of this export are drawn
+          if (fFingerprints.count(region) == 0) {
+            return nullptr;
+          }
+          return source(region);
+        }) {}
+
+  // progress: called on the calling thread after each level, with the number of tiles drawn for it
+  bool update(int numThreads, Stats &stats, std::function<void(int zoom, int count)> progress = nullptr) {
+    using namespace juce;
+    if (fDirectory.createDirectory().failed()) {
+      return false;
+    }
+    std::map<Region, uint64_t> previous;
+    loadManifest(previous);
+
+    // Changed, added and removed regions. Tiles of their neighbours are drawn again too, for their shading and water color blend reach across region borders
+    std::set<Region> changed;
+    for (auto const &it : fFingerprints) {
+      if (auto found = previous.find(it.first); found != previous.end() && found->second == it.second) {
+        stats.fUnchanged++;
+      } else {
+        changed.insert(it.first);
+      }
+    }
+    for (auto const &it : previous) {
+      if (fFingerprints.count(it.first) == 0) {
+        changed.insert(it.first);
+      }
+    }
+    std::set<Region> neighbours;
+    for (Region region : changed) {
+      for (int dz = -1; dz <= 1; dz++) {
+        for (int dx = -1; dx <= 1; dx++) {
+          neighbours.insert(MakeRegion(region.first + dx, region.second + dz));
+        }
+      }
+    }
+    // North to south, then west to east
+    std::vector<Region> dirty(neighbours.begin(), neighbours.end());
+    std::sort(dirty.begin(), dirty.end(), [](Region const &a, Region const &b) {
+      return std::tie(a.second, a.first) < std::tie(b.second, b.first);
+    });
+
+    // Most detailed level, one run of adjacent dirty regions of a row at a time, cut into strips of at most kMaxStripRegions.
+    // The renderer reads the ring of neighbours around each strip, so the shading across the cuts is the same as for an uncut run
+    std::set<PyramidTile> tiles;
+    std::vector<juce::PixelARGB> strip;
+    for (auto it = dirty.begin(); it != dirty.end();) {
+      int const rz = it->second;
+      int const minRx = it->first;
+      int maxRx = minRx;
+      for (it++; it != dirty.end() && it->second == rz && it->first == maxRx + 1 && maxRx - minRx + 1 < kMaxStripRegions; it++) {
+        maxRx++;
+      }
+      int const width = (maxRx - minRx + 1) * 512;
+      strip.resize((size_t)width * 512);
+      fRenderer.render(minRx * 512, rz * 512, width, 512, strip.data(), numThreads);
+
+      std::vector<PyramidTile> run;
+      for (int x = minRx * 2; x <= maxRx * 2 + 1; x++) {
+        for (int y = rz * 2; y <= rz * 2 + 1; y++) {
+          run.push_back({kMaxZoom, x, y});
+        }
+      }
+      createDirectories(run);
+      std::atomic<int> written = 0;
+      std::atomic<int> removed = 0;
+      ParallelFor((int)run.size(), numThreads, [&](int i) {
+        PyramidTile tile = run[i];
+        std::vector<PixelARGB> pixels(kTileSize * kTileSize);
+        PixelARGB const *src = strip.data() + (size_t)(tile.fY - rz * 2) * kTileSize * width + (tile.fX - minRx * 2) * kTileSize;
+        for (int y = 0; y < kTileSize; y++) {
+          std::copy_n(src + (size_t)y * width, kTileSize, pixels.data() + y * kTileSize);
+        }
+        store(tile, pixels, written, removed);
+      });
+      stats.fWritten += written;
+      stats.fRemoved += removed;
+      tiles.insert(run.begin(), run.end());
+    }
+    if (progress) {
+      progress(kMaxZoom, (int)tiles.size());
+    }
+
+    for (int zoom = kMaxZoom - 1; zoom >= kMinZoom; zoom--) {
+      std::set<PyramidTile> parents;
+      for (PyramidTile const &tile : tiles) {
+        parents.insert(tile.parent());
+      }
+      std::vector<PyramidTile> level(parents.begin(), parents.end());
+      createDirectories(level);
+      std::atomic<int> written = 0;
+      std::atomic<int> removed = 0;
+      ParallelFor((int)level.size(), numThreads, [&](int i) {
+        auto pixels = downsample(level[i]);
+        store(level[i], pixels, written, removed);
+      });
+      stats.fWritten += written;
+      stats.fRemoved += removed;
+      tiles.swap(parents);
+      if (progress) {
+        progress(zoom, (int)level.size());
+      }
+    }
+
+    return saveManifest();
+  }
+
+  juce::File fileOf(PyramidTile tile) const {
+    return fDirectory.getChildFile(juce::String(tile.fZoom)).getChildFile(juce::String(tile.fX)).getChildFile(juce::String(tile.fY) + ".png");
+  }
+
+private:
+  // Writes the tile, or deletes it when every pixel is transparent
+  void store(PyramidTile tile, std::vector<juce::PixelARGB> &pixels, std::atomic<int> &written, std::atomic<int> &removed) const {
+    using namespace juce;
+    File file = fileOf(tile);
+    bool const empty = std::all_of(pixels.begin(), pixels.end(), [](PixelARGB p) { return p.getAlpha() == 0; });
+    if (empty) {
+      if (file.existsAsFile() && file.deleteFile()) {
+        removed++;
+      }
+      return;
+    }
+    TemporaryFile temp(file);
+    {
+      FileOutputStream stream(temp.getFile());
+      if (!stream.openedOk()) {
+        return;
+      }
+      PNGWriter writer(kTileSize, kTileSize, stream, PNGFilterHeuristic::adaptive);
+      for (int y = 0; y < kTileSize; y++) {
+        writer.writeRow(pixels.data() + y * kTileSize);
+      }
+    }
+    if (temp.overwriteTargetFileWithTemporary()) {
+      written++;
+    }
+  }
+
+  // Averages each 2x2 block of the children's premultiplied pixels
+  std::vector<juce::PixelARGB> downsample(PyramidTile tile) const {
+    using namespace juce;
+    int const half = kTileSize / 2;
+    std::vector<PixelARGB> pixels(kTileSize * kTileSize, PixelARGB(0, 0, 0, 0));
+    PNGImageFormat format;
+    for (int i = 0; i < 4; i++) {
+      File file = fileOf(tile.child(i));
+      if (!file.existsAsFile()) {
+        continue;
+      }
+      FileInputStream stream(file);
+      Image image = format.decodeImage(stream);
+      if (!image.isValid() || image.getWidth() != kTileSize || image.getHeight() != kTileSize) {
+        continue;
+      }
+      image = image.convertedToFormat(Image::ARGB);
+      Image::BitmapData bitmap(image, Image::BitmapData::readOnly);
+      int const x0 = (i & 1) * half;
+      int const y0 = (i >> 1) * half;
+      for (int y = 0; y < half; y++) {
+        PixelARGB const *top = reinterpret_cast<PixelARGB const *>(bitmap.getLinePointer(2 * y));
+        PixelARGB const *bottom = reinterpret_cast<PixelARGB const *>(bitmap.getLinePointer(2 * y + 1));
+        for (int x = 0; x < half; x++) {
+          PixelARGB const cell[4] = {top[2 * x], top[2 * x + 1], bottom[2 * x], bottom[2 * x + 1]};
+          int a = 2, r = 2, g = 2, b = 2;
+          for (PixelARGB const &p : cell) {
+            a += p.getAlpha();
+            r += p.getRed();
+            g += p.getGreen();
+            b += p.getBlue();
+          }
+          pixels[(y0 + y) * kTileSize + x0 + x].setARGB((uint8)(a / 4), (uint8)(r / 4), (uint8)(g / 4), (uint8)(b / 4));
+        }
+      }
+    }
+    return pixels;
+  }
+
+  // Parents are created here rather than by the workers, which would race on them
+  void createDirectories(std::vector<PyramidTile> const &tiles) const {
+    std::set<std::pair<int, int>> columns;
+    for (PyramidTile const &tile : tiles) {
+      if (columns.insert(std::make_pair(tile.fZoom, tile.fX)).second) {
+        fileOf(tile).getParentDirectory().createDirectory();
+      }
+    }
+  }
+
+  nlohmann::json optionsJson() const {
+    nlohmann::json obj;
+    obj["version"] = kVersion;
+    obj["dimension"] = static_cast<int>(fOptions.fDimension);
+    obj["palette"] = static_cast<int>(fOptions.fPalette);
+    obj["lighting"] = static_cast<int>(fOptions.fLighting);
+    obj["water_optical_density"] = fOptions.fWaterOpticalDensity;
+    obj["water_translucent"] = fOptions.fWaterTranslucent;
+    obj["biome_enabled"] = fOptions.fBiomeEnabled;
+    obj["biome_blend"] = fOptions.fBiomeBlend;
+    return obj;
+  }
+
+  juce::File manifestFile() const {
+    return fDirectory.getChildFile("manifest.json");
+  }
+
+  // Regions of the last export. Left empty when it was drawn with other options, so that everything is drawn again
+  void loadManifest(std::map<Region, uint64_t> &regions) const {
+    using namespace nlohmann;
+    juce::File file = manifestFile();
+    if (!file.existsAsFile()) {
+      return;
+    }
+    std::string str(file.loadFileAsString().toRawUTF8());
+    json obj = json::parse(str, nullptr, false);
+    if (!obj.is_object()) {
+      return;
+    }
+    std::map<Region, uint64_t> found;
+    if (auto items = obj.find("regions"); items != obj.end() && items->is_array()) {
+      for (auto const &item : *items) {
+        auto x = item.find("x");
+        auto z = item.find("z");
+        auto fingerprint = item.find("fingerprint");
+        if (x == item.end() || !x->is_number_integer() || z == item.end() || !z->is_number_integer() || fingerprint == item.end() || !fingerprint->is_string()) {
+          continue;
+        }
+        if (auto v = Fingerprint::FromString(juce::String(fingerprint->get<std::string>())); v) {
+          found[MakeRegion(x->get<int>(), z->get<int>())] = *v;
+        }
+      }
+    }
+    if (auto r = obj.find("renderer"); r == obj.end() || *r != optionsJson()) {
+      // Tiles of these regions have to be removed or redrawn all the same
+      for (auto &it : found) {
+        it.second = 0;
+      }
+    }
+    regions.swap(found);
+  }
+
+  bool saveManifest() const {
+    using namespace nlohmann;
+    json obj;
+    obj["tile_size"] = kTileSize;
+    obj["min_zoom"] = kMinZoom;
+    obj["max_zoom"] = kMaxZoom;
+    obj["renderer"] = optionsJson();
+    json regions = json::array();
+    int minX = 0, minZ = 0, maxX = 0, maxZ = 0;
+    for (auto const &it : fFingerprints) {
+      Region region = it.first;
+      if (regions.empty()) {
+        minX = maxX = region.first;
+        minZ = maxZ = region.second;
+      } else {
+        minX = (std::min)(minX, region.first);
+        maxX = (std::max)(maxX, region.first);
+        minZ = (std::min)(minZ, region.second);
+        maxZ = (std::max)(maxZ, region.second);
+      }
+      json item;
+      item["x"] = region.first;
+      item["z"] = region.second;
+      item["fingerprint"] = Fingerprint::ToString(it.second).toStdString();
+      regions.push_back(item);
+    }
+    if (!fFingerprints.empty()) {
+      // Blocks covered by the regions, inclusive
+      json bounds;
+      bounds["min_x"] = minX * 512;
+      bounds["min_z"] = minZ * 512;
+      bounds["max_x"] = maxX * 512 + 511;
+      bounds["max_z"] = maxZ * 512 + 511;
+      obj["bounds"] = bounds;
+    }
+    obj["regions"] = regions;
+
+    juce::TemporaryFile temp(manifestFile());
+    if (!temp.getFile().replaceWithText(juce::String::fromUTF8(obj.dump(2).c_str()))) {
+      return false;
+    }
+    return temp.overwriteTargetFileWithTemporary();
+  }
+
+private:
+  juce::File const fDirectory;
+  SoftwareRenderer::Options const fOptions;
+  std::map<Region, uint64_t> const fFingerprints;
+  SoftwareRenderer const fRenderer;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TilePyramid)
+};
+
+} // namespace mcview
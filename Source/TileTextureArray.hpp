@@ -0,0 +1,161 @@
+#pragma once
+
+namespace mcview {
+
+// Region textures stored as layers of a GL_TEXTURE_2D_ARRAY, so that all visible tiles can be drawn with one instanced call.
+// All layers are size x size pixels. The array grows on demand, up to GL_MAX_ARRAY_TEXTURE_LAYERS. Must be used from the GL thread.
+// Each plane is a separate texture sharing the same layer allocation, eg. plane 1 holds the precomputed shade of the tile in plane 0.
+// With integer, plane 0 is GL_RGBA8UI so that shaders can read the packed pixel info with texelFetch. Other planes are always normalized.
+class TileTextureArray {
+public:
+  static int constexpr kInitialLayers = 16;
+
+  explicit TileTextureArray(int size, int planes = 1, bool integer = false) : fSize(size), fTextures(planes, 0), fInteger(integer), fLayers(0), fMaxLayers(0) {}
+
+  ~TileTextureArray() {
+    release();
+  }
+
+  static bool IsSupported() {
+    using namespace juce::gl;
+    if (glTexImage3D == nullptr || glTexSubImage3D == nullptr || glCopyTexSubImage3D == nullptr || glFramebufferTextureLayer == nullptr) {
+      return false;
+    }
+    if (glDrawElementsInstanced == nullptr || glVertexAttribDivisor == nullptr) {
+      return false;
+    }
+    return juce::OpenGLHelpers::isExtensionSupported("GL_EXT_texture_array");
+  }
+
+  static bool IsIntegerSupported() {
+    if (!IsSupported()) {
+      return false;
+    }
+    return juce::OpenGLHelpers::isExtensionSupported("GL_EXT_texture_integer") && juce::OpenGLHelpers::isExtensionSupported("GL_EXT_gpu_shader4");
+  }
+
+  // Returns -1 when the array cannot grow any further.
+  int allocate() {
+    if (fFree.empty() && !grow()) {
+      return -1;
+    }
+    int layer = fFree.back();
+    fFree.pop_back();
+    return layer;
+  }
+
+  void free(int layer) {
+    if (0 <= layer && layer < fLayers) {
+      fFree.push_back(layer);
+    }
+  }
+
+  void upload(int layer, juce::PixelARGB const *pixels, int plane = 0) {
+    using namespace juce::gl;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, fTextures[plane]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, fSize, fSize, 1, isInteger(plane) ? GL_BGRA_INTEGER : GL_BGRA, GL_UNSIGNED_BYTE, pixels);
+  }
+
+  int size() const {
+    return fSize;
+  }
+
+  int planes() const {
+    return (int)fTextures.size();
+  }
+
+  bool isInteger(int plane) const {
+    return fInteger && plane == 0;
+  }
+
+  GLuint textureID(int plane = 0) const {
+    return fTextures[plane];
+  }
+
+  void release() {
+    using namespace juce::gl;
+    for (GLuint &texture : fTextures) {
+      if (texture != 0) {
+        glDeleteTextures(1, &texture);
+      }
+      texture = 0;
+    }
+    fLayers = 0;
+    fFree.clear();
+  }
+
+private:
+  bool grow() {
+    using namespace juce::gl;
+    if (fMaxLayers == 0) {
+      GLint max = 0;
+      glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max);
+      fMaxLayers = max;
+    }
+    int const layers = fLayers == 0 ? (std::min)(kInitialLayers, fMaxLayers) : (std::min)(fLayers * 2, fMaxLayers);
+    if (layers <= fLayers) {
+      return false;
+    }
+
+    while (glGetError() != GL_NO_ERROR) {
+    }
+    std::vector<GLuint> textures(fTextures.size(), 0);
+    glGenTextures((GLsizei)textures.size(), textures.data());
+    for (size_t plane = 0; plane < textures.size(); plane++) {
+      glBindTexture(GL_TEXTURE_2D_ARRAY, textures[plane]);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      if (isInteger((int)plane)) {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8UI, fSize, fSize, layers, 0, GL_BGRA_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+      } else {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, fSize, fSize, layers, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+      }
+    }
+    if (glGetError() != GL_NO_ERROR) {
+      glDeleteTextures((GLsizei)textures.size(), textures.data());
+      fMaxLayers = fLayers;
+      return false;
+    }
+
+    if (fLayers > 0) {
+      // Copy existing layers through a framebuffer, since the pixels are not kept on the CPU side
+      GLint previous = 0;
+      glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+      GLuint fbo = 0;
+      glGenFramebuffers(1, &fbo);
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      for (size_t plane = 0; plane < fTextures.size(); plane++) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textures[plane]);
+        for (int i = 0; i < fLayers; i++) {
+          glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, fTextures[plane], 0, i);
+          glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, 0, 0, fSize, fSize);
+        }
+      }
+      glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previous);
+      glDeleteFramebuffers(1, &fbo);
+      glDeleteTextures((GLsizei)fTextures.size(), fTextures.data());
+    }
+
+    for (int i = layers - 1; i >= fLayers; i--) {
+      fFree.push_back(i);
+    }
+    fTextures = textures;
+    fLayers = layers;
+    return true;
+  }
+
+private:
+  int const fSize;
+  std::vector<GLuint> fTextures;
+  bool const fInteger;
+  int fLayers;
+  int fMaxLayers;
+  std::vector<int> fFree;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TileTextureArray)
+};
+
+} // namespace mcview
@@ -0,0 +1,187 @@
+#pragma once
+
+namespace mcview {
+
+// Spans of the tile pipeline, saved as a Chrome trace event file that chrome://tracing and Perfetto open.
+// Each thread records into a ring buffer of its own, so the oldest spans are dropped rather than memory growing while tracing is left on.
+// When tracing is off a span costs a relaxed atomic load.
+class Trace {
+public:
+  static int constexpr kCapacity = 1 << 16;
+
+  struct Event {
+    char const *fName;
+    juce::int64 fBegin;
+    juce::int64 fEnd;
+    // Region the span worked on, if fHasRegion
+    int fRx;
+    int fRz;
+    bool fHasRegion;
+  };
+
+  class Span {
+  public:
+    explicit Span(char const *name) : fName(Enabled() ? name : nullptr), fBegin(fName ? juce::Time::getHighResolutionTicks() : 0) {
+    }
+
+    Span(char const *name, std::pair<int, int> region) : Span(name) {
+      fRegion = region;
+    }
+
+    ~Span() {
+      if (fName) {
+        Record(fName, fBegin, juce::Time::getHighResolutionTicks(), fRegion);
+      }
+    }
+
+  private:
+    char const *const fName;
+    juce::int64 const fBegin;
+    std::optional<std::pair<int, int>> fRegion;
+
+    JUCE_DECLARE_NON_COPYABLE(Span)
+  };
+
+  static bool Enabled() {
+    return Flag().load(std::memory_order_relaxed);
+  }
+
+  // Starting drops the spans recorded before
+  static void SetEnabled(bool enabled) {
+    if (enabled && !Enabled()) {
+      Clear();
+    }
+    Flag().store(enabled, std::memory_order_relaxed);
+  }
+
+  // name must be a string literal, it is kept until the trace is saved. begin and end are in high resolution ticks
+  static void Record(char const *name, juce::int64 begin, juce::int64 end, std::optional<std::pair<int, int>> region = std::nullopt) {
+    if (!Enabled()) {
+      return;
+    }
+    Event e{name, begin, end, 0, 0, false};
+    if (region) {
+      e.fRx = region->first;
+      e.fRz = region->second;
+      e.fHasRegion = true;
+    }
+    auto &buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock(buffer->fMut);
+    if (buffer->fEvents.size() < kCapacity) {
+      buffer->fEvents.push_back(e);
+    } else {
+      buffer->fEvents[buffer->fCount % kCapacity] = e;
+    }
+    buffer->fCount++;
+  }
+
+  static bool Save(juce::File file) {
+    using namespace juce;
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    {
+      std::lock_guard<std::mutex> lock(GetRegistry().fMut);
+      buffers = GetRegistry().fBuffers;
+    }
+    std::vector<std::pair<int, Event>> events;
+    String threads;
+    for (auto const &buffer : buffers) {
+      std::lock_guard<std::mutex> lock(buffer->fMut);
+      if (buffer->fEvents.empty()) {
+        continue;
+      }
+      // Oldest first
+      size_t const first = buffer->fCount > kCapacity ? buffer->fCount % kCapacity : 0;
+      for (size_t i = 0; i < buffer->fEvents.size(); i++) {
+        events.emplace_back(buffer->fTid, buffer->fEvents[(first + i) % buffer->fEvents.size()]);
+      }
+      threads << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->fTid << ",\"args\":{\"name\":" << JSON::toString(var(buffer->fName)) << "}},\n";
+    }
+    juce::int64 origin = std::numeric_limits<juce::int64>::max();
+    for (auto const &it : events) {
+      origin = (std::min)(origin, it.second.fBegin);
+    }
+    double const usPerTick = 1e6 / (double)Time::getHighResolutionTicksPerSecond();
+
+    TemporaryFile temp(file);
+    {
+      FileOutputStream stream(temp.getFile());
+      if (!stream.openedOk()) {
+        return false;
+      }
+      stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+             << threads;
+      for (auto const &[tid, e] : events) {
+        stream << "{\"name\":\"" << e.fName << "\",\"cat\":\"mcview\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+               << ",\"ts\":" << String((e.fBegin - origin) * usPerTick, 3) << ",\"dur\":" << String((e.fEnd - e.fBegin) * usPerTick, 3);
+        if (e.fHasRegion) {
+          stream << ",\"args\":{\"rx\":" << e.fRx << ",\"rz\":" << e.fRz << "}";
+        }
+        stream << "},\n";
+      }
+      // Trailing comma is not allowed in JSON
+      stream << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"mcview\"}}\n]}\n";
+      if (stream.getStatus().failed()) {
+        return false;
+      }
+    }
+    return temp.overwriteTargetFileWithTemporary();
+  }
+
+private:
+  struct Buffer {
+    Buffer(int tid, juce::String name) : fTid(tid), fName(name) {}
+
+    std::mutex fMut;
+    std::vector<Event> fEvents;
+    // Total events recorded, including the ones overwritten
+    size_t fCount = 0;
+    int const fTid;
+    juce::String const fName;
+  };
+
+  struct Registry {
+    std::mutex fMut;
+    std::vector<std::shared_ptr<Buffer>> fBuffers;
+    int fNextTid = 1;
+  };
+
+  static std::atomic<bool> &Flag() {
+    static std::atomic<bool> sEnabled(false);
+    return sEnabled;
+  }
+
+  static Registry &GetRegistry() {
+    static Registry sRegistry;
+    return sRegistry;
+  }
+
+  static std::shared_ptr<Buffer> &LocalBuffer() {
+    thread_local std::shared_ptr<Buffer> tBuffer;
+    if (!tBuffer) {
+      auto &registry = GetRegistry();
+      std::lock_guard<std::mutex> lock(registry.fMut);
+      int const tid = registry.fNextTid++;
+      juce::String name = "Thread " + juce::String(tid);
+      if (auto thread = juce::Thread::getCurrentThread(); thread) {
+        name = thread->getThreadName() + " " + juce::String(tid);
+      }
+      tBuffer = std::make_shared<Buffer>(tid, name);
+      registry.fBuffers.push_back(tBuffer);
+    }
+    return tBuffer;
+  }
+
+  // Drops recorded spans, and buffers of threads that have exited
+  static void Clear() {
+    auto &registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.fMut);
+    std::erase_if(registry.fBuffers, [](std::shared_ptr<Buffer> const &buffer) { return buffer.use_count() == 1; });
+    for (auto const &buffer : registry.fBuffers) {
+      std::lock_guard<std::mutex> l(buffer->fMut);
+      buffer->fEvents.clear();
+      buffer->fCount = 0;
+    }
+  }
+};
+
+} // namespace mcview